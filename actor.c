@@ -2,17 +2,34 @@
 
 #include <stdlib.h>
 
+#include "fiber.h"
 #include "utils.h"
 
-void actor_init(actor_t *actor, const role_t *role) {
-    int err;
-
+/*
+ * Funkcja ustawia stan nowego aktora (skrzynka i blokada są już zainicjowane).
+ */
+static void actor_reset(actor_t *actor, const role_t *role) {
     actor->is_active = true;
     actor->role = role;
     actor->state = IDLING;
+    actor->data = NULL;
+    actor->id = -1;
+    actor->is_live = false;
+    actor->live_prev = NULL;
+    actor->live_next = NULL;
+    actor->arena = NULL;
+    actor->coalesce_buckets = NULL;
+    actor->fiber = NULL;
+    actor->hibernated = 0;
+    actor->active_at = 0;
+}
+
+void actor_init(actor_t *actor, const role_t *role) {
+    int err;
+
     queue_message_init(&actor->msg_queue, ACTOR_QUEUE_LIMIT);
     mutex_init(&actor->lock);
-    actor->data = NULL;
+    actor_reset(actor, role);
 }
 
 void actor_destroy(actor_t *actor) {
@@ -20,16 +37,90 @@ void actor_destroy(actor_t *actor) {
 
     queue_message_destroy(&actor->msg_queue);
     mutex_destroy(&actor->lock);
+    actor_release(actor);
+}
+
+void actor_release(actor_t *actor) {
+    arena_release(&actor->arena);
+
+    if (actor->fiber != NULL) {
+        fiber_free(actor->fiber);
+        actor->fiber = NULL;
+    }
+
+    if (actor->coalesce_buckets != NULL) {
+        for (size_t i = 0; i < COALESCE_BUCKETS; ++i) {
+            while (actor->coalesce_buckets[i] != NULL) {
+                coalesce_slot_t *slot = actor->coalesce_buckets[i];
+                actor->coalesce_buckets[i] = slot->next;
+                message_free(slot);
+            }
+        }
+        free(actor->coalesce_buckets);
+        actor->coalesce_buckets = NULL;
+    }
 }
 
 void actor_godie(actor_t *actor) {
     queue_message_godie(&actor->msg_queue);
+    arena_release(&actor->arena);
+}
+
+static size_t coalesce_bucket(message_type_t type, long key) {
+    unsigned long hash = (unsigned long) key * 0x9E3779B97F4A7C15ul ^ (unsigned long) type;
+    return (hash ^ hash >> 32) % COALESCE_BUCKETS;
+}
+
+coalesce_slot_t *actor_coalesce_find(actor_t *actor, message_type_t type, long key) {
+    if (actor->coalesce_buckets == NULL) {
+        return NULL;
+    }
+
+    coalesce_slot_t *slot = actor->coalesce_buckets[coalesce_bucket(type, key)];
+    while (slot != NULL && (slot->key != key || slot->message.message_type != type)) {
+        slot = slot->next;
+    }
+
+    return slot;
+}
+
+coalesce_slot_t *actor_coalesce_insert(actor_t *actor, message_t message, long key) {
+    if (actor->coalesce_buckets == NULL) {
+        actor->coalesce_buckets = calloc(COALESCE_BUCKETS, sizeof(coalesce_slot_t *));
+        if (actor->coalesce_buckets == NULL) {
+            syserr(-1, "calloc failed");
+        }
+    }
+
+    coalesce_slot_t **bucket = &actor->coalesce_buckets[coalesce_bucket(message.message_type, key)];
+
+    coalesce_slot_t *slot = message_alloc(sizeof(coalesce_slot_t));
+    slot->key = key;
+    slot->message = message;
+    slot->next = *bucket;
+    *bucket = slot;
+
+    return slot;
+}
+
+message_t actor_coalesce_take(actor_t *actor, coalesce_slot_t *slot) {
+    coalesce_slot_t **link = &actor->coalesce_buckets[coalesce_bucket(slot->message.message_type, slot->key)];
+    while (*link != slot) {
+        link = &(*link)->next;
+    }
+    *link = slot->next;
+
+    message_t message = slot->message;
+    message_free(slot);
+
+    return message;
 }
 
 void actors_array_init(actors_array_t *array) {
     int err;
 
     array->nactors = 0;
+    array->nallocated = 0;
     array->max_actors = STARTING_ACTORS_COUNT;
     malloc_and_check(array->actors, STARTING_ACTORS_COUNT * sizeof(actor_t));
     rwlock_init(&array->rwlock);
@@ -40,7 +131,7 @@ void actors_array_destroy(actors_array_t *array) {
 
     rwlock_destroy(&array->rwlock);
 
-    for (unsigned int i = 0; i < array->nactors && array->actors[i] != NULL; ++i) {
+    for (unsigned int i = 0; i < array->nallocated && array->actors[i] != NULL; ++i) {
         actor_destroy(array->actors[i]);
         free(array->actors[i]);
     }
@@ -48,24 +139,53 @@ void actors_array_destroy(actors_array_t *array) {
     free(array->actors);
 }
 
+void actors_array_recycle(actors_array_t *array) {
+    for (unsigned int i = 0; i < array->nactors; ++i) {
+        actor_release(array->actors[i]);
+        queue_message_reset(&array->actors[i]->msg_queue);
+    }
+
+    array->nactors = 0;
+}
+
 actor_id_t actors_array_new_actor(actors_array_t *array, const role_t *role) {
-    if (array->nactors == array->max_actors) {
-        if (array->max_actors * 2 <= CAST_LIMIT) {
+    return actors_array_new_actors(array, role, 1);
+}
+
+actor_id_t actors_array_new_actors(actors_array_t *array, const role_t *role, size_t count) {
+    if (count == 0 || count > CAST_LIMIT - array->nactors) {
+        return -1;
+    }
+
+    if (array->nactors + count > array->max_actors) {
+        while (array->nactors + count > array->max_actors) {
             array->max_actors *= 2;
-        } else {
-            return -1;
         }
 
-        realloc_and_check(array->actors, array->max_actors * sizeof(actor_t));
+        realloc_and_check(array->actors, array->max_actors * sizeof(actor_t *));
     }
 
-    ++array->nactors;
+    actor_id_t first = array->nactors + 1;
 
-    malloc_and_check(array->actors[array->nactors - 1], sizeof(actor_t));
-    actor_init(array->actors[array->nactors - 1], role);
-    actor_id_t output = array->nactors;
+    for (size_t i = 0; i < count; ++i) {
+        actor_t *actor;
 
-    return output;
+        if (array->nactors < array->nallocated) {
+            // Aktor z poprzedniego systemu (actors_array_recycle).
+            actor = array->actors[array->nactors];
+            actor_reset(actor, role);
+        }
+        else {
+            malloc_and_check(actor, sizeof(actor_t));
+            actor_init(actor, role);
+            array->nallocated++;
+        }
+
+        array->actors[array->nactors++] = actor;
+        actor->id = array->nactors;
+    }
+
+    return first;
 }
 
 actor_t *actors_array_get_actor(actors_array_t *array, actor_id_t actor_id) {
@@ -76,8 +196,36 @@ actor_t *actors_array_get_actor(actors_array_t *array, actor_id_t actor_id) {
     return array->actors[actor_id - 1];
 }
 
-void actors_array_godie(actors_array_t *array) {
-    for (unsigned int i = 0; i < array->nactors && array->actors[i] != NULL; ++i) {
-        actor_godie(array->actors[i]);
+void actors_list_push(actor_t **head, actor_t *actor) {
+    actor->is_live = true;
+    actor->live_prev = NULL;
+    actor->live_next = *head;
+
+    if (*head != NULL) {
+        (*head)->live_prev = actor;
     }
+
+    *head = actor;
+}
+
+bool actors_list_remove(actor_t **head, actor_t *actor) {
+    if (!actor->is_live) {
+        return false;
+    }
+
+    if (actor->live_prev != NULL) {
+        actor->live_prev->live_next = actor->live_next;
+    } else {
+        *head = actor->live_next;
+    }
+
+    if (actor->live_next != NULL) {
+        actor->live_next->live_prev = actor->live_prev;
+    }
+
+    actor->is_live = false;
+    actor->live_prev = NULL;
+    actor->live_next = NULL;
+
+    return true;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 
 #include "cacti.h"
+#include "pool.h"
 #include "queue_message.h"
 
 #ifndef ACTOR_QUEUE_LIMIT
@@ -12,17 +13,41 @@
 
 #define STARTING_ACTORS_COUNT 4
 
+/*
+ * Typ komunikatu w skrzynce zastępującego komunikat wysłany z kluczem
+ * (send_message_coalesced). Dane wskazują na coalesce_slot_t z właściwym komunikatem.
+ */
+#define MSG_COALESCED (message_type_t)0xC0A1E5CE
+
+#define COALESCE_BUCKETS 16
+
+/*
+ * Oczekujący komunikat wysłany z kluczem. Nowszy komunikat o tym samym typie
+ * i kluczu zastępuje go w miejscu.
+ */
+typedef struct coalesce_slot {
+    long key;
+    message_t message;
+    struct coalesce_slot *next;
+} coalesce_slot_t;
+
 /*
  * Enumerator informacji o stanie aktora.
  */
 typedef enum state {
     WORKING,
     WAITING,
-    IDLING
+    IDLING,
+    SUSPENDED
 } state_t;
 
 /*
  * Struktura przechowująca informacje o aktorze.
+ * Aktor w stanie SUSPENDED ma wstrzymane włókno fiber i jest umieszczany
+ * w kolejce oczekujących dopiero po nadejściu oczekiwanego komunikatu.
+ * Stan zahibernowanego aktora jest w magazynie hibernacji pod uchwytem
+ * hibernated (0, gdy stan jest w pamięci); active_at to czas ostatniej obsługi
+ * komunikatu według zegara hibernacji.
  */
 typedef struct actor {
     const role_t *role;
@@ -31,6 +56,14 @@ typedef struct actor {
     queue_message_t msg_queue;
     bool is_active;
     pthread_mutex_t lock;
+    actor_id_t id;
+    bool is_live;
+    struct actor *live_prev, *live_next;
+    arena_chunk_t *arena;
+    coalesce_slot_t **coalesce_buckets;
+    struct fiber *fiber;
+    size_t hibernated;
+    unsigned long active_at;
 } actor_t;
 
 /*
@@ -39,10 +72,12 @@ typedef struct actor {
 typedef long actor_id_t;
 
 /*
- * Struktura przechowująca tablicę aktorów.
+ * Struktura przechowująca tablicę aktorów. Pozycje od nactors do nallocated
+ * zajmują aktorzy zwolnieni przez actors_array_recycle, gotowi do ponownego użycia.
  */
 typedef struct actors_array {
     unsigned int nactors;
+    unsigned int nallocated;
     unsigned int max_actors;
     actor_t **actors;
     pthread_rwlock_t rwlock;
@@ -59,10 +94,32 @@ void actor_init(actor_t *actor, const role_t *role);
 void actor_destroy(actor_t *actor);
 
 /*
- * Funkcja powoduje przejście aktora w stan martwy.
+ * Funkcja zwalnia zasoby aktora związane z jego działaniem (arenę, oczekujące
+ * komunikaty z kluczem i wstrzymane włókno), zachowując skrzynkę i blokadę.
+ */
+void actor_release(actor_t *actor);
+
+/*
+ * Funkcja powoduje przejście aktora w stan martwy i zwalnia jego arenę.
  */
 void actor_godie(actor_t *actor);
 
+/*
+ * Funkcja zwraca oczekujący komunikat aktora o danym typie i kluczu (NULL gdy brak).
+ * Funkcje obsługujące komunikaty z kluczem wymagają blokady skrzynki aktora.
+ */
+coalesce_slot_t *actor_coalesce_find(actor_t *actor, message_type_t type, long key);
+
+/*
+ * Funkcja zapamiętuje oczekujący komunikat z kluczem.
+ */
+coalesce_slot_t *actor_coalesce_insert(actor_t *actor, message_t message, long key);
+
+/*
+ * Funkcja usuwa oczekujący komunikat z kluczem i zwraca go.
+ */
+message_t actor_coalesce_take(actor_t *actor, coalesce_slot_t *slot);
+
 /*
  * Funkcja inicjuje tablicę aktorów.
  */
@@ -73,12 +130,25 @@ void actors_array_init(actors_array_t *array);
  */
 void actors_array_destroy(actors_array_t *array);
 
+/*
+ * Funkcja usuwa wszystkich aktorów z tablicy, zachowując ich pamięć (wraz z buforami
+ * skrzynek) dla aktorów tworzonych później.
+ */
+void actors_array_recycle(actors_array_t *array);
+
 /*
  * Funkcja tworzy nowego aktora o podanej roli, dodaje do tablicy i zwraca jego id.
  * Funkcja powinna mieć ochronę pisarza.
  */
 actor_id_t actors_array_new_actor(actors_array_t *array, const role_t *role);
 
+/*
+ * Funkcja tworzy count aktorów o kolejnych id i zwraca id pierwszego z nich
+ * (-1 gdy count jest równe 0 lub przekroczono by CAST_LIMIT).
+ * Funkcja powinna mieć ochronę pisarza.
+ */
+actor_id_t actors_array_new_actors(actors_array_t *array, const role_t *role, size_t count);
+
 /*
  * Funkcja zwraca wskaźnik na aktora o podanym id (NULL jeśli nie istnieje).
  * Funkcja powinna mieć ochronę czytelnika.
@@ -86,8 +156,14 @@ actor_id_t actors_array_new_actor(actors_array_t *array, const role_t *role);
 actor_t *actors_array_get_actor(actors_array_t *array, actor_id_t actor_id);
 
 /*
- * Funkcja powoduje przejście wszystkich aktorów w stan martwy.
+ * Funkcja dołącza aktora do listy żywych aktorów.
+ */
+void actors_list_push(actor_t **head, actor_t *actor);
+
+/*
+ * Funkcja odłącza aktora od listy żywych aktorów.
+ * Zwraca false, jeśli aktora nie było na liście.
  */
-void actors_array_godie(actors_array_t *array);
+bool actors_list_remove(actor_t **head, actor_t *actor);
 
 #endif //ACTOR_H
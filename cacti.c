@@ -1,27 +1,50 @@
+#define _GNU_SOURCE
+
 #include "cacti.h"
 
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "actor.h"
+#include "fiber.h"
+#include "gateway.h"
+#include "hibernate.h"
+#include "io.h"
 #include "queue_actor_id.h"
+#include "queue_message.h"
+#include "rcu.h"
+#include "snapshot.h"
+#include "system.h"
+#include "transport.h"
 #include "utils.h"
+#include "watchdog.h"
 
 /*
- * Struktura przechowująca informacje o systemie aktorów.
+ * Maksymalna liczba kolejnych komunikatów obsłużonych przez wątek z pominięciem
+ * globalnej kolejki (slot runnext). Po jej przekroczeniu aktor z runnext trafia
+ * na koniec kolejki oczekujących, aby para wymieniających się komunikatami
+ * aktorów nie zmonopolizowała wątku. Wartość 0 wyłącza mechanizm.
  */
-typedef struct actors_system {
-    actors_array_t actors_array;
-    pthread_mutex_t lock;
-    unsigned int nthreads;
-    pthread_t *threads;
-    queue_actor_id_t waiting_actors;
-    unsigned long active_actors;
-    unsigned long messages;
-    bool is_active;
-    bool is_interrupted;
-    struct sigaction previous_sigset;
-} actors_system_t;
+#ifndef RUNNEXT_LIMIT
+#define RUNNEXT_LIMIT 8
+#endif
+
+#define NO_ACTOR (actor_id_t)-1
+
+/*
+ * W trybie jednowątkowym liczba komunikatów obsługiwanych między kolejnymi
+ * sprawdzeniami sygnałów, bramki i dziennika komunikatów.
+ */
+#ifndef SINGLE_THREADED_POLL_INTERVAL
+#define SINGLE_THREADED_POLL_INTERVAL 4096
+#endif
 
 /*
  * Obecnie działający system aktorów.
@@ -29,9 +52,41 @@ typedef struct actors_system {
 actors_system_t *current_actors_system;
 
 /*
- * Funkcja powoduje przejście systemu aktorów w stan martwy.
+ * Deskryptor control_fd działającego systemu (-1 bez systemu) i znacznik SIGINT
+ * odebranego przez procedurę sygnałową, dla wątku kontrolnego.
+ */
+static atomic_int sigint_fd = -1;
+static atomic_bool is_sigint_forwarded = false;
+
+/*
+ * Zasoby zachowywane między kolejnymi systemami aktorów (actor_system_retain).
+ * Wątki z threads po zakończeniu pracy dla systemu czekają na wake, aż
+ * generation się zmieni; index POOL_SIZE to wątek kontrolny. nparked to liczba
+ * wątków, które zakończyły pracę dla obecnej generacji. system to pamięć
+ * ostatniego systemu aktorów (wraz z aktorami i ich skrzynkami).
  */
-static void godie(actors_system_t *actors_system) {
+typedef struct retained {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t parked;
+    int flags;
+    unsigned long generation;
+    unsigned int nparked;
+    unsigned int nthreads;
+    pthread_t threads[POOL_SIZE + 1];
+    bool is_closing;
+    actors_system_t *system;
+} retained_t;
+
+static retained_t retained_storage = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .wake = PTHREAD_COND_INITIALIZER,
+        .parked = PTHREAD_COND_INITIALIZER
+};
+
+static retained_t *const retained = &retained_storage;
+
+void actor_system_godie(actors_system_t *actors_system) {
     int err;
 
     if (actors_system == NULL) {
@@ -41,61 +96,250 @@ static void godie(actors_system_t *actors_system) {
     actors_system->is_active = false;
 
     queue_actor_id_t *actors_queue = &actors_system->waiting_actors;
-    actors_array_t *actors_array = &actors_system->actors_array;
 
     entity_lock(actors_queue);
     queue_actor_id_godie(actors_queue);
     entity_unlock(actors_queue);
 
-    entity_writer_lock(actors_array);
-    actors_array_godie(actors_array);
-    entity_rw_unlock(actors_array);
+    cond_broadcast(&actors_system->finished);
+}
+
+void actor_system_enlist(actors_system_t *actors_system, actor_t *actor) {
+    actors_list_push(&actors_system->live_actors, actor);
+    actors_system->active_actors++;
 }
 
 /*
- * Funkcja obsługuje sygnał SIGINT
+ * Funkcja zapisuje nowo utworzonych aktorów jako żywych, o ile system nie został
+ * przerwany - sprawdzenie i zapis są pod jedną blokadą systemu, więc interrupt
+ * obejmuje każdego przyjętego aktora. Aktorzy nieprzyjęci przechodzą w stan
+ * martwy, zanim otrzymają jakikolwiek komunikat. Zwraca, czy aktorzy zostali przyjęci.
+ * (Blokada tablicy aktorów nie może być brana pod blokadą systemu, bo migawka
+ * blokuje aktorów pod blokadą tablicy, a obsługa komunikatu - system pod blokadą aktora.)
  */
-static void interrupted() {
+static bool actor_system_admit(actors_system_t *actors_system, actor_t **actors, size_t count) {
     int err;
 
-    entity_lock(current_actors_system);
-    current_actors_system->is_interrupted = true;
+    entity_lock(actors_system);
+    bool is_admitted = !actors_system->is_interrupted;
+    for (size_t i = 0; is_admitted && i < count; ++i) {
+        actor_system_enlist(actors_system, actors[i]);
+    }
+    entity_unlock(actors_system);
+
+    for (size_t i = 0; !is_admitted && i < count; ++i) {
+        entity_lock(actors[i]);
+        actors[i]->is_active = false;
+        actors[i]->state = IDLING;
+        actor_godie(actors[i]);
+        entity_unlock(actors[i]);
+    }
 
-    if (current_actors_system->messages == 0) {
-        // Wszyscy aktorzy czekają na wiadomości
-        godie(current_actors_system);
-        entity_unlock(current_actors_system);
-    } else {
-        // Niektórzy aktorzy czekają na wiadomości
-        entity_unlock(current_actors_system);
+    return is_admitted;
+}
 
-        actors_array_t *actors_array = &current_actors_system->actors_array;
+/*
+ * Funkcja usuwa martwego aktora z listy żywych aktorów systemu.
+ * Gdy nie pozostał żaden żywy aktor, system przechodzi w stan martwy.
+ * Funkcja powinna być wywoływana pod blokadą systemu aktorów.
+ */
+static void retire_actor(actors_system_t *actors_system, actor_t *actor) {
+    if (!actors_list_remove(&actors_system->live_actors, actor)) {
+        // Aktor został już wcześniej usunięty.
+        return;
+    }
 
-        entity_reader_lock(actors_array);
-        int counter = 0;
-        for (actor_id_t actor_id = 1; actor_id <= actors_array->nactors; ++actor_id) {
-            actor_t *actor = actors_array_get_actor(actors_array, actor_id);
-            queue_message_t *messages_queue = &actor->msg_queue;
+    actors_system->active_actors--;
 
-            entity_lock(actor);
-            entity_lock(messages_queue);
-            if (actor->is_active && queue_message_is_empty(messages_queue)) {
-                actor->is_active = false;
-                ++counter;
-            }
-            entity_unlock(messages_queue);
-            entity_unlock(actor);
+    if (actors_system->active_actors == 0) {
+        actor_system_godie(actors_system);
+    }
+}
+
+/*
+ * Funkcja blokuje przyjmowanie nowych komunikatów i aktorów, a następnie
+ * uśmierca bezczynnych aktorów z pustymi kolejkami. Pozostali aktorzy umierają
+ * po obsłużeniu zaległych komunikatów. Koszt jest proporcjonalny do liczby
+ * żywych aktorów.
+ */
+static void interrupt(actors_system_t *actors_system) {
+    int err;
+
+    entity_lock(actors_system);
+    if (actors_system->is_interrupted || !actors_system->is_active) {
+        entity_unlock(actors_system);
+        return;
+    }
+    actors_system->is_interrupted = true;
+
+    // Kopia listy, aby nie blokować aktorów pod blokadą systemu.
+    actor_t **live;
+    size_t nlive = 0;
+    malloc_and_check(live, (actors_system->active_actors + 1) * sizeof(actor_t *));
+    for (actor_t *actor = actors_system->live_actors; actor != NULL; actor = actor->live_next) {
+        live[nlive++] = actor;
+    }
+    entity_unlock(actors_system);
+
+    for (size_t i = 0; i < nlive; ++i) {
+        actor_t *actor = live[i];
+        queue_message_t *messages_queue = &actor->msg_queue;
+
+        entity_lock(actor);
+        bool is_held = false;
+        if (actor->state == SUSPENDED) {
+            // Oczekiwany komunikat już nie nadejdzie - wstrzymana obsługa jest porzucana.
+            fiber_free(actor->fiber);
+            actor->fiber = NULL;
+            actor->state = IDLING;
+            is_held = true;
         }
-        entity_rw_unlock(actors_array);
 
-        entity_lock(current_actors_system);
-        current_actors_system->active_actors -= counter;
-        entity_unlock(current_actors_system);
+        entity_lock(messages_queue);
+        bool is_idle = actor->state == IDLING && queue_message_is_empty(messages_queue);
+        entity_unlock(messages_queue);
+
+        if (is_idle) {
+            actor->is_active = false;
+            actor_godie(actor);
+        }
+        else if (is_held) {
+            // Aktor obsłuży komunikaty wstrzymane w skrzynce.
+            actor->state = WAITING;
+        }
+        entity_unlock(actor);
+
+        if (is_held && !is_idle) {
+            actor_system_schedule(actor->id);
+        }
+
+        if (is_idle) {
+            entity_lock(actors_system);
+            retire_actor(actors_system, actor);
+            entity_unlock(actors_system);
+        }
+    }
+
+    free(live);
+}
+
+/*
+ * Funkcja wykonuje jeden krok pracy wątku kontrolnego. Obsługuje sygnał SIGINT
+ * odbierany przez signalfd, dzięki czemu obsługa nie wykonuje się w kontekście
+ * procedury sygnałowej. Dostarcza komunikaty z kolejki wejściowej bramki
+ * i okresowo zatwierdza dziennik komunikatów oraz sprawdza czas obsługi
+ * komunikatów (jeśli są włączone).
+ * Bez is_blocking tylko sprawdza gotowość deskryptorów.
+ * Zwraca false, gdy system aktorów jest kończony.
+ */
+static bool control_step(actors_system_t *actors_system, bool is_blocking, bool *is_pending) {
+    int err;
+
+    struct pollfd fds[3] = {
+            {.fd = actors_system->signal_fd, .events = POLLIN},
+            {.fd = actors_system->control_fd, .events = POLLIN},
+            {.fd = actors_system->gateway->ingress_fd, .events = POLLIN}
+    };
+
+    entity_lock(actors_system);
+    struct persistence *persistence = actors_system->persistence;
+    entity_unlock(actors_system);
+
+    watchdog_t *watchdog = atomic_load_explicit(&actors_system->watchdog, memory_order_acquire);
+    hibernation_t *hibernation = atomic_load_explicit(&actors_system->hibernation, memory_order_acquire);
+
+    int timeout = !is_blocking ? 0
+                  : *is_pending ? GATEWAY_RETRY_INTERVAL
+                  : persistence != NULL ? LOG_COMMIT_INTERVAL : -1;
+    if (watchdog != NULL && (timeout < 0 || timeout > WATCHDOG_INTERVAL)) {
+        timeout = WATCHDOG_INTERVAL;
+    }
+    if (hibernation != NULL && (timeout < 0 || timeout > HIBERNATE_INTERVAL)) {
+        timeout = HIBERNATE_INTERVAL;
+    }
+    if (rcu_is_pending() && (timeout < 0 || timeout > RCU_INTERVAL)) {
+        timeout = RCU_INTERVAL;
+    }
+
+    int ready = poll(fds, 3, timeout);
+
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        syserr(errno, "poll failed");
+    }
+
+    if (watchdog != NULL) {
+        watchdog_check(watchdog);
+    }
+
+    if (hibernation != NULL) {
+        hibernation_step(hibernation);
+    }
+
+    if (rcu_is_pending()) {
+        rcu_reclaim(false);
+    }
+
+    if (ready == 0) {
+        if (*is_pending) {
+            *is_pending = gateway_drain(actors_system->gateway);
+        }
+        if (persistence != NULL) {
+            persistence_commit(persistence);
+        }
+        return true;
+    }
+
+    if (fds[2].revents & POLLIN) {
+        *is_pending = gateway_drain(actors_system->gateway);
+    }
+
+    if (fds[1].revents & POLLIN) {
+        uint64_t value;
+        if (read(actors_system->control_fd, &value, sizeof(value)) != sizeof(value))
+            syserr(errno, "eventfd read failed");
+
+        if (atomic_exchange(&is_sigint_forwarded, false)) {
+            interrupt(actors_system);
+        }
+
+        entity_lock(actors_system);
+        bool is_joining = actors_system->is_joining;
+        entity_unlock(actors_system);
+
+        if (is_joining) {
+            // Zakończenie działania systemu aktorów.
+            return false;
+        }
+    }
+
+    if (fds[0].revents & POLLIN) {
+        struct signalfd_siginfo info;
+        if (read(actors_system->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            interrupt(actors_system);
+        }
     }
 
-    actor_system_join(1);
+    return true;
+}
+
+#ifndef SINGLE_THREADED
+
+/*
+ * Funkcja wątku kontrolnego.
+ */
+static void *control_func(void *data) {
+    bool is_pending = false;
+
+    while (control_step(data, true, &is_pending)) {}
+
+    return 0;
 }
 
+#endif
+
 /*
  * Funkcja wywołuje wiadomość na aktorze.
  */
@@ -108,6 +352,14 @@ static void execute_message(actor_id_t actor_id, message_t message) {
     actor_t *actor = actors_array_get_actor(actors_array, actor_id);
     entity_rw_unlock(actors_array);
 
+    if (actor->fiber != NULL && message.message_type != MSG_SPAWN) {
+        // Komunikat, na który czekała wstrzymana obsługa.
+        if (fiber_resume(actor->fiber, message)) {
+            actor->fiber = NULL;
+        }
+        return;
+    }
+
     switch (message.message_type) {
         case MSG_SPAWN: {
             entity_lock(current_actors_system);
@@ -122,13 +374,12 @@ static void execute_message(actor_id_t actor_id, message_t message) {
 
             entity_writer_lock(actors_array);
             actor_id_t new_actor = actors_array_new_actor(actors_array, message.data);
+            actor_t *new_actor_struct = actors_array_get_actor(actors_array, new_actor);
             entity_rw_unlock(actors_array);
 
-            entity_lock(current_actors_system);
-            if (new_actor != -1) {
-                current_actors_system->active_actors++;
+            if (new_actor_struct != NULL && !actor_system_admit(current_actors_system, &new_actor_struct, 1)) {
+                return;
             }
-            entity_unlock(current_actors_system);
 
             send_message(new_actor, message_hello);
             break;
@@ -140,8 +391,17 @@ static void execute_message(actor_id_t actor_id, message_t message) {
             break;
         }
         default: {
-            actor->role->prompts[message.message_type]
-                    (&actor->data, message.nbytes, message.data);
+            act_t prompt = actor->role->prompts[message.message_type];
+
+            if (!actor->role->is_suspendable) {
+                prompt(&actor->data, message.nbytes, message.data);
+                break;
+            }
+
+            fiber_t *fiber = fiber_new(prompt, &actor->data);
+            if (!fiber_resume(fiber, message)) {
+                actor->fiber = fiber;
+            }
             break;
         }
     }
@@ -150,273 +410,1055 @@ static void execute_message(actor_id_t actor_id, message_t message) {
 _Thread_local actor_id_t current_actor = -1;
 
 /*
- * Funkcja obsługująca działanie wątków
+ * Slot runnext wątku roboczego: aktor ostatnio wybudzony przez obsługiwany
+ * komunikat zostanie obsłużony jako następny przez ten sam wątek.
  */
-static void *thread_func(UNUSED void *data) {
-    int err;
-
-    sigset_t mask;
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGINT);
+_Thread_local bool is_worker = false;
+_Thread_local unsigned int worker_index = 0;
+static _Thread_local actor_id_t runnext = NO_ACTOR;
+static _Thread_local unsigned int runnext_streak = 0;
 
-    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+void actor_system_schedule(actor_id_t actor_id) {
+    int err;
 
     queue_actor_id_t *actors_queue = &current_actors_system->waiting_actors;
-    actors_array_t *actors_array = &current_actors_system->actors_array;
 
-    while (true) {
-        entity_lock(actors_queue);
-        // Oczekiwanie na aktora z komunikatem.
-        actor_id_t actor_id = queue_actor_id_pop(actors_queue);
-        entity_unlock(actors_queue);
+    entity_lock(actors_queue);
+    queue_actor_id_push(actors_queue, actor_id);
+    entity_unlock(actors_queue);
+}
 
-        entity_lock(current_actors_system);
-        if (!current_actors_system->is_active) {
-            // Został wybudzony po przejściu systemu w stan martwy.
-            entity_unlock(current_actors_system);
-            break;
-        }
-        entity_unlock(current_actors_system);
+size_t actor_system_mailbox_length(actor_id_t actor_id) {
+    int err;
 
-        entity_reader_lock(actors_array);
-        actor_t *actor = actors_array_get_actor(actors_array, actor_id);
-        entity_rw_unlock(actors_array);
+    actors_array_t *actors_array = &current_actors_system->actors_array;
 
-        entity_lock(actor);
-        actor->state = WORKING;
-        entity_unlock(actor);
+    entity_reader_lock(actors_array);
+    actor_t *actor = actors_array_get_actor(actors_array, actor_id);
+    entity_rw_unlock(actors_array);
 
-        queue_message_t *messages_queue = &actor->msg_queue;
+    if (actor == NULL) {
+        return 0;
+    }
 
+    queue_message_t *messages_queue = &actor->msg_queue;
+    size_t length = 0;
+
+    entity_lock(actor);
+    if (actor->is_active) {
+        // Skrzynka martwego aktora może już być wyłączona (queue_message_godie).
         entity_lock(messages_queue);
-        message_t message = queue_message_pop(messages_queue);
+        length = queue_message_length(messages_queue);
         entity_unlock(messages_queue);
+    }
+    entity_unlock(actor);
 
-        entity_lock(actor);
-        if (!actor->is_active) {
-            // Został wybudzony po przejściu aktora w stan martwy.
-            entity_unlock(actor);
-            continue;
-        }
-        entity_unlock(actor);
+    return length;
+}
+
+/*
+ * Funkcja umieszcza wybudzonego aktora w slocie runnext wątku roboczego.
+ * Poprzedni aktor ze slotu trafia do kolejki aktorów oczekujących.
+ * Gdy inne wątki czekają na aktorów (licznik idle_workers, odczytywany bez
+ * blokady kolejki), wybudzony aktor trafia do kolejki, aby nie czekał
+ * na zakończenie bieżącej obsługi.
+ */
+static void schedule_actor_next(actor_id_t actor_id) {
+    if (!is_worker || RUNNEXT_LIMIT == 0
+        || atomic_load_explicit(&current_actors_system->idle_workers, memory_order_relaxed) > 0) {
+        actor_system_schedule(actor_id);
+        return;
+    }
+
+    actor_id_t previous = runnext;
+    runnext = actor_id;
 
-        current_actor = actor_id;
+    if (previous != NO_ACTOR) {
+        actor_system_schedule(previous);
+    }
+}
 
-        execute_message(actor_id, message);
+/*
+ * Funkcja zwraca aktora, którego komunikat wątek obsłuży jako następny.
+ * W przypadku gdy slot runnext jest pusty, wątek czeka na aktora z kolejki.
+ */
+static actor_id_t next_actor(queue_actor_id_t *actors_queue) {
+    int err;
 
-        current_actor = -1;
+    if (runnext != NO_ACTOR) {
+        actor_id_t actor_id = runnext;
+        runnext = NO_ACTOR;
 
-        entity_lock(current_actors_system);
-        current_actors_system->messages--;
-        entity_unlock(current_actors_system);
+        if (runnext_streak < RUNNEXT_LIMIT) {
+            runnext_streak++;
+            return actor_id;
+        }
 
-        entity_lock(actor);
-        entity_lock(messages_queue);
-        if (!queue_message_is_empty(messages_queue)) {
-            entity_unlock(messages_queue);
-            actor->state = WAITING;
-            entity_unlock(actor);
+        // Wyczerpany limit - aktor ustępuje miejsca pozostałym.
+        actor_system_schedule(actor_id);
+    }
 
-            entity_lock(actors_queue);
-            queue_actor_id_push(actors_queue, actor_id);
-            entity_unlock(actors_queue);
-        } else {
-            entity_unlock(messages_queue);
-            actor->state = IDLING;
+    runnext_streak = 0;
 
-            entity_lock(current_actors_system);
-            if (!actor->is_active || current_actors_system->is_interrupted) {
-                // Aktor przeszedł w stan martwy lub proces został przerwany
-                entity_unlock(current_actors_system);
-                actor_godie(actor);
-                entity_unlock(actor);
+    atomic_fetch_add_explicit(&current_actors_system->idle_workers, 1, memory_order_relaxed);
 
-                entity_lock(current_actors_system);
-                current_actors_system->active_actors--;
+    entity_lock(actors_queue);
+    // Oczekiwanie na aktora z komunikatem.
+    actor_id_t actor_id = queue_actor_id_pop(actors_queue);
+    entity_unlock(actors_queue);
 
-                if (current_actors_system->active_actors == 0) {
-                    godie(current_actors_system);
-                }
-            } else {
-                entity_unlock(actor);
-            }
-            entity_unlock(current_actors_system);
-        }
-    }
+    atomic_fetch_sub_explicit(&current_actors_system->idle_workers, 1, memory_order_relaxed);
 
-    return 0;
+    return actor_id;
 }
 
 /*
- * Funkcja inicjalizuje system aktorów.
+ * Funkcja sprawdza, czy komunikat może zostać obsłużony przez aktora
+ * z wstrzymanym włóknem: jest to komunikat, na który czeka włókno, lub MSG_SPAWN
+ * (który nie korzysta ze stanu aktora).
  */
-static void actor_system_init(actors_system_t *actors_system) {
-    int err;
-
-    actors_system->is_active = true;
-    actors_system->is_interrupted = false;
-    actors_system->active_actors = 0;
-    actors_system->nthreads = POOL_SIZE;
-    malloc_and_check(actors_system->threads, POOL_SIZE * sizeof(pthread_t));
-    queue_actor_id_init(&actors_system->waiting_actors, 0);
-    actors_array_init(&actors_system->actors_array);
-    mutex_init(&actors_system->lock);
+static bool is_resumable(actor_t *actor, message_type_t type) {
+    return type == MSG_SPAWN || type == fiber_awaited(actor->fiber);
 }
 
 /*
- * Funkcja niszczy system aktorów.
+ * Funkcja zwraca pozycję pierwszego komunikatu w skrzynce aktora z wstrzymanym
+ * włóknem, który może zostać obsłużony (liczbę komunikatów w skrzynce, gdy go nie ma).
+ * Funkcja wymaga blokady skrzynki aktora.
  */
-static void actor_system_destroy(actors_system_t *actors_system) {
-    int err;
+static size_t find_resumable(actor_t *actor) {
+    queue_message_t *messages_queue = &actor->msg_queue;
+    size_t length = queue_message_length(messages_queue);
+
+    for (size_t i = 0; i < length; ++i) {
+        message_t message = queue_message_peek(messages_queue, i);
+        if (message.message_type == MSG_COALESCED) {
+            message = ((coalesce_slot_t *) message.data)->message;
+        }
 
-    free(actors_system->threads);
-    queue_actor_id_destroy(&actors_system->waiting_actors);
-    actors_array_destroy(&actors_system->actors_array);
-    mutex_destroy(&actors_system->lock);
-}
+        if (is_resumable(actor, message.message_type)) {
+            return i;
+        }
+    }
 
-actor_id_t actor_id_self() {
-    return current_actor;
+    return length;
 }
 
-int actor_system_create(actor_id_t *actor, role_t *const role) {
-    if (current_actors_system != NULL) {
-        return -1;
-    }
-
+/*
+ * Funkcja obsługuje pierwszy komunikat z kolejki aktora, a gdy aktor ma
+ * wstrzymane włókno - pierwszy komunikat, który może obsłużyć (find_resumable).
+ */
+static void handle_message(actor_id_t actor_id) {
     int err;
 
-    malloc_and_check(current_actors_system, sizeof(actors_system_t));
-    actor_system_init(current_actors_system);
-
-    sigset_t sigset;
-    sigemptyset(&sigset);
-
-    struct sigaction action;
-    action.sa_handler = interrupted;
-    action.sa_mask = sigset;
-    action.sa_flags = 0;
-    if ((err = sigaction(SIGINT, &action, &current_actors_system->previous_sigset)) != 0)
-        syserr(err, "sigaction failed");
-
-    pthread_attr_t attr;
-
     actors_array_t *actors_array = &current_actors_system->actors_array;
 
-    entity_writer_lock(actors_array);
-    *actor = actors_array_new_actor(actors_array, role);
-    entity_rw_unlock(actors_array);
+    // Przy włączonym utrwalaniu obsługa komunikatu blokuje migawkę systemu.
+    bool is_persistent = atomic_load(&current_actors_system->is_persistent);
+    if (is_persistent) {
+        entity_reader_lock(current_actors_system);
+    }
 
-    entity_lock(current_actors_system);
-    current_actors_system->active_actors = 1;
-    entity_unlock(current_actors_system);
+    entity_reader_lock(actors_array);
+    actor_t *actor = actors_array_get_actor(actors_array, actor_id);
+    entity_rw_unlock(actors_array);
 
-    // Niejawne wysłanie MSG_HELLO do pierwszego aktora
-    current_actor = *actor;
+    hibernation_t *hibernation = atomic_load_explicit(&current_actors_system->hibernation, memory_order_acquire);
 
-    execute_message(*actor, (message_t) {
-            .message_type = MSG_HELLO,
-            .nbytes = sizeof(actor_id_t),
-            .data = (void *) -1
-    });
+    entity_lock(actor);
+    actor->state = WORKING;
+    if (actor->hibernated != 0) {
+        hibernation_wake(hibernation, actor);
+    }
+    entity_unlock(actor);
 
-    current_actor = -1;
+    queue_message_t *messages_queue = &actor->msg_queue;
 
+    entity_lock(messages_queue);
+    message_t message = actor->fiber != NULL
+                        ? queue_message_remove(messages_queue, find_resumable(actor))
+                        : queue_message_pop(messages_queue);
+    if (message.message_type == MSG_COALESCED) {
+        // Najnowszy komunikat wysłany z danym kluczem.
+        message = actor_coalesce_take(actor, message.data);
+    }
+    entity_unlock(messages_queue);
 
-    thread_attr_init(PTHREAD_CREATE_JOINABLE);
+    // Martwy aktor wciąż obsługuje komunikaty wysłane przed MSG_GODIE.
+    current_actor = actor_id;
 
-    for (unsigned int i = 0; i < current_actors_system->nthreads; ++i) {
-        thread_create(current_actors_system->threads + i, thread_func);
+    watchdog_t *watchdog = atomic_load_explicit(&current_actors_system->watchdog, memory_order_acquire);
+    if (watchdog != NULL) {
+        watchdog_begin(watchdog, actor_id, message.message_type);
     }
 
-    thread_attr_destroy;
-
-    return 0;
-}
+    execute_message(actor_id, message);
 
-void actor_system_join(actor_id_t actor) {
-    if (actor > current_actors_system->actors_array.nactors) {
-        return;
+    if (watchdog != NULL) {
+        watchdog_end(watchdog);
     }
 
-    int err;
-    void *retval;
+    current_actor = -1;
 
-    for (unsigned int i = 0; i < current_actors_system->nthreads; ++i) {
-        thread_join(current_actors_system->threads[i]);
+    entity_lock(actor);
+    if (hibernation != NULL) {
+        actor->active_at = atomic_load_explicit(&hibernation->clock, memory_order_relaxed);
     }
 
-    if ((err = sigaction(SIGINT, &current_actors_system->previous_sigset, NULL)) != 0)
-        syserr(err, "sigaction failed");
-
-    actor_system_destroy(current_actors_system);
-    free(current_actors_system);
-    current_actors_system = NULL;
-}
-
-int send_message(actor_id_t actor, message_t message) {
-    int err;
-
-    entity_lock(current_actors_system);
-    if (current_actors_system->is_interrupted) {
-        // System aktorów nie przyjmuje już komunikatów.
+    if (actor->fiber != NULL) {
+        entity_lock(current_actors_system);
+        if (current_actors_system->is_interrupted) {
+            // Oczekiwany komunikat już nie nadejdzie - wstrzymana obsługa jest porzucana.
+            fiber_free(actor->fiber);
+            actor->fiber = NULL;
+        }
         entity_unlock(current_actors_system);
-        return -5;
     }
-    current_actors_system->messages++;
-    entity_unlock(current_actors_system);
 
+    entity_lock(messages_queue);
+    if (actor->fiber != NULL) {
+        // Obsługa czeka na komunikat; pozostałe komunikaty zostają w skrzynce.
+        bool is_ready = find_resumable(actor) < queue_message_length(messages_queue);
+        entity_unlock(messages_queue);
+        actor->state = is_ready ? WAITING : SUSPENDED;
+        entity_unlock(actor);
 
-    actors_array_t *actors_array = &current_actors_system->actors_array;
+        if (is_ready) {
+            actor_system_schedule(actor_id);
+        }
+    } else if (!queue_message_is_empty(messages_queue)) {
+        entity_unlock(messages_queue);
+        actor->state = WAITING;
+        entity_unlock(actor);
 
-    entity_reader_lock(actors_array);
-    if (actor > current_actors_system->actors_array.nactors) {
-        // Brak aktora o podanym id.
-        entity_rw_unlock(actors_array);
+        actor_system_schedule(actor_id);
+    } else {
+        entity_unlock(messages_queue);
+        actor->state = IDLING;
 
         entity_lock(current_actors_system);
-        current_actors_system->messages--;
+        if (!actor->is_active || current_actors_system->is_interrupted) {
+            // Aktor przeszedł w stan martwy lub proces został przerwany
+            entity_unlock(current_actors_system);
+            actor->is_active = false;
+            actor_godie(actor);
+            entity_unlock(actor);
+
+            entity_lock(current_actors_system);
+            retire_actor(current_actors_system, actor);
+        } else {
+            entity_unlock(actor);
+        }
         entity_unlock(current_actors_system);
-        return -2;
     }
 
-    actor_t *actor_struct = actors_array_get_actor(actors_array, actor);
-    entity_rw_unlock(actors_array);
+    if (is_persistent) {
+        entity_rw_unlock(current_actors_system);
+    }
+}
 
-    entity_lock(actor_struct);
-    if (!actor_struct->is_active) {
-        entity_unlock(actor_struct);
+#ifndef SINGLE_THREADED
+
+/*
+ * Funkcja obsługująca działanie wątków
+ */
+static void *thread_func(void *data) {
+    int err;
+
+    // SIGINT jest zablokowany (maska odziedziczona po wątku tworzącym system).
+    is_worker = true;
+    worker_index = (unsigned int) (uintptr_t) data;
+    runnext = NO_ACTOR;
+    runnext_streak = 0;
+
+    queue_actor_id_t *actors_queue = &current_actors_system->waiting_actors;
+
+    while (true) {
+        // Między komunikatami wątek nie korzysta z danych współdzielonych (rcu.h).
+        rcu_offline();
+        actor_id_t actor_id = next_actor(actors_queue);
+        rcu_online();
 
         entity_lock(current_actors_system);
-        current_actors_system->messages--;
+        if (!current_actors_system->is_active) {
+            // Został wybudzony po przejściu systemu w stan martwy.
+            entity_unlock(current_actors_system);
+            break;
+        }
         entity_unlock(current_actors_system);
+
+        handle_message(actor_id);
+    }
+
+    rcu_offline();
+
+    return 0;
+}
+
+/*
+ * Funkcja zgłasza zakończenie pracy wątku dla obecnego systemu i czeka na kolejny.
+ * Zwraca false, gdy wątek ma się zakończyć (wątki nie są zachowywane).
+ */
+static bool park(unsigned long *generation) {
+    int err;
+
+    entity_lock(retained);
+
+    if (!(retained->flags & RETAIN_THREADS)) {
+        entity_unlock(retained);
+        return false;
+    }
+
+    retained->nparked++;
+    cond_broadcast(&retained->parked);
+
+    while (retained->generation == *generation && !retained->is_closing) {
+        cond_wait(&retained->wake, &retained->lock);
+    }
+
+    bool is_closing = retained->is_closing;
+    *generation = retained->generation;
+
+    entity_unlock(retained);
+
+    return !is_closing;
+}
+
+/*
+ * Funkcja wątku systemu aktorów: wątku roboczego o numerze index lub, dla
+ * index == POOL_SIZE, wątku kontrolnego. Zachowany wątek obsługuje kolejne systemy.
+ */
+static void *thread_main(void *data) {
+    unsigned int index = (unsigned int) (uintptr_t) data;
+    unsigned long generation = retained->generation;
+
+    do {
+        if (index == POOL_SIZE) {
+            control_func(current_actors_system);
+        }
+        else {
+            thread_func(data);
+        }
+    } while (park(&generation));
+
+    return 0;
+}
+
+/*
+ * Funkcja czeka, aż count zachowanych wątków zakończy pracę dla obecnego systemu.
+ */
+static void wait_parked(unsigned int count) {
+    int err;
+
+    entity_lock(retained);
+    while (retained->nparked < count) {
+        cond_wait(&retained->parked, &retained->lock);
+    }
+    entity_unlock(retained);
+}
+
+#else
+
+/*
+ * Funkcja sprawdza, czy minął czas bezwzględny deadline (CLOCK_REALTIME).
+ */
+static bool is_expired(const struct timespec *deadline) {
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0)
+        syserr(errno, "clock_gettime failed");
+
+    return now.tv_sec > deadline->tv_sec
+           || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/*
+ * Funkcja obsługuje komunikaty na wątku wywołującym, dopóki system aktorów nie
+ * przejdzie w stan martwy. Gdy żaden aktor nie ma komunikatów, czeka na pracę
+ * wątku kontrolnego (bramka, SIGINT); co SINGLE_THREADED_POLL_INTERVAL komunikatów
+ * wykonuje ją bez czekania. Po upływie deadline (NULL oznacza brak limitu)
+ * porzuca nieobsłużone komunikaty i zwraca false.
+ */
+static bool dispatch(const struct timespec *deadline) {
+    queue_actor_id_t *actors_queue = &current_actors_system->waiting_actors;
+    bool is_pending = false;
+    bool is_finished = true;
+    unsigned long handled = 0;
+
+    is_worker = true;
+    runnext = NO_ACTOR;
+    runnext_streak = 0;
+
+    while (current_actors_system->is_active) {
+        if (deadline != NULL && is_expired(deadline)) {
+            actor_system_godie(current_actors_system);
+            is_finished = false;
+            break;
+        }
+
+        if (runnext == NO_ACTOR && queue_actor_id_is_empty(actors_queue)) {
+            // Żywi aktorzy czekają na komunikaty spoza systemu. Z limitem czasu
+            // wątek nie czeka, aby sprawdzać deadline.
+            rcu_offline();
+            control_step(current_actors_system, deadline == NULL, &is_pending);
+            continue;
+        }
+
+        rcu_offline();
+        actor_id_t actor_id = next_actor(actors_queue);
+        rcu_online();
+
+        if (!current_actors_system->is_active) {
+            break;
+        }
+
+        handle_message(actor_id);
+
+        if (++handled % SINGLE_THREADED_POLL_INTERVAL == 0) {
+            control_step(current_actors_system, false, &is_pending);
+        }
+    }
+
+    rcu_offline();
+    is_worker = false;
+
+    return is_finished;
+}
+
+#endif
+
+/*
+ * Funkcja ustawia stan nowego systemu aktorów (bez aktorów).
+ */
+static void actor_system_reset(actors_system_t *actors_system) {
+    actors_system->is_active = true;
+    actors_system->is_interrupted = false;
+    actors_system->is_joining = false;
+    actors_system->persistence = NULL;
+    atomic_init(&actors_system->is_persistent, false);
+    atomic_init(&actors_system->idle_workers, 0);
+    actors_system->transport = NULL;
+    actors_system->io = NULL;
+    atomic_init(&actors_system->watchdog, NULL);
+    atomic_init(&actors_system->hibernation, NULL);
+    actors_system->active_actors = 0;
+    actors_system->live_actors = NULL;
+#ifndef SINGLE_THREADED
+    actors_system->nthreads = POOL_SIZE;
+#else
+    actors_system->nthreads = 0;
+#endif
+}
+
+/*
+ * Funkcja inicjalizuje system aktorów.
+ */
+static void actor_system_init(actors_system_t *actors_system) {
+    int err;
+
+    actor_system_reset(actors_system);
+    malloc_and_check(actors_system->threads, POOL_SIZE * sizeof(pthread_t));
+    queue_actor_id_init(&actors_system->waiting_actors, 0);
+    actors_array_init(&actors_system->actors_array);
+    mutex_init(&actors_system->lock);
+    cond_init(&actors_system->finished);
+
+    // Pisarz ma pierwszeństwo, aby stale obsługiwane komunikaty go nie zagłodziły.
+    pthread_rwlockattr_t attr;
+    check_if_error(pthread_rwlockattr_init(&attr), "rwlockattr init failed");
+    check_if_error(pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP),
+                   "rwlockattr setkind failed");
+    check_if_error(pthread_rwlock_init(&actors_system->rwlock, &attr), "rwlock init failed");
+    check_if_error(pthread_rwlockattr_destroy(&attr), "rwlockattr destroy failed");
+}
+
+/*
+ * Funkcja niszczy system aktorów.
+ */
+static void actor_system_destroy(actors_system_t *actors_system) {
+    int err;
+
+    free(actors_system->threads);
+    queue_actor_id_destroy(&actors_system->waiting_actors);
+    actors_array_destroy(&actors_system->actors_array);
+    mutex_destroy(&actors_system->lock);
+    cond_destroy(&actors_system->finished);
+    rwlock_destroy(&actors_system->rwlock);
+}
+
+/*
+ * Funkcja usuwa aktorów i komunikaty zakończonego systemu aktorów,
+ * zachowując jego pamięć i obiekty synchronizacji dla kolejnego systemu.
+ */
+static void actor_system_recycle(actors_system_t *actors_system) {
+    queue_actor_id_reset(&actors_system->waiting_actors);
+    actors_array_recycle(&actors_system->actors_array);
+}
+
+actor_id_t actor_id_self() {
+    return current_actor;
+}
+
+/*
+ * Procedura sygnałowa SIGINT dla wątków, które nie blokują sygnału (utworzonych
+ * przed systemem aktorów). Przekazuje go wątkowi kontrolnemu przez control_fd,
+ * zamiast domyślnie kończyć proces.
+ */
+static void forward_sigint(UNUSED int signum) {
+    int saved_errno = errno;
+    uint64_t value = 1;
+
+    atomic_store(&is_sigint_forwarded, true);
+    if (write(atomic_load(&sigint_fd), &value, sizeof(value)) != sizeof(value)) {
+        // Wątek kontrolny i tak zostanie obudzony przez wcześniejszy zapis.
+    }
+
+    errno = saved_errno;
+}
+
+int actor_system_open(void) {
+    if (current_actors_system != NULL) {
         return -1;
     }
-    entity_unlock(actor_struct);
+
+    int err;
+
+    if (retained->system != NULL) {
+        current_actors_system = retained->system;
+        retained->system = NULL;
+        actor_system_reset(current_actors_system);
+    }
+    else {
+        malloc_and_check(current_actors_system, sizeof(actors_system_t));
+        actor_system_init(current_actors_system);
+    }
+
+    // SIGINT jest blokowany we wszystkich wątkach systemu i odbierany przez signalfd.
+    sigset_t sigset;
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGINT);
+
+    check_if_error(pthread_sigmask(SIG_BLOCK, &sigset, &current_actors_system->previous_sigmask),
+                   "pthread sigmask failed");
+    current_actors_system->creator = pthread_self();
+
+    if ((current_actors_system->signal_fd = signalfd(-1, &sigset, SFD_CLOEXEC)) < 0)
+        syserr(errno, "signalfd failed");
+
+    if ((current_actors_system->control_fd = eventfd(0, EFD_CLOEXEC)) < 0)
+        syserr(errno, "eventfd failed");
+
+    // Wątki utworzone wcześniej nie mają zablokowanego SIGINT: domyślną obsługę,
+    // która zakończyłaby proces, zastępuje przekazanie sygnału wątkowi kontrolnemu.
+    atomic_store(&is_sigint_forwarded, false);
+    atomic_store(&sigint_fd, current_actors_system->control_fd);
+
+    struct sigaction action = {.sa_handler = forward_sigint, .sa_flags = SA_RESTART};
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGINT, NULL, &current_actors_system->previous_sigaction) != 0)
+        syserr(errno, "sigaction failed");
+
+    if (current_actors_system->previous_sigaction.sa_handler == SIG_DFL
+        && !(current_actors_system->previous_sigaction.sa_flags & SA_SIGINFO)
+        && sigaction(SIGINT, &action, NULL) != 0)
+        syserr(errno, "sigaction failed");
+
+    current_actors_system->gateway = gateway_open();
+
+    return 0;
+}
+
+void actor_system_start(void) {
+#ifndef SINGLE_THREADED
+    int err;
+    pthread_attr_t attr;
+
+    entity_lock(retained);
+
+    if (retained->nthreads > 0) {
+        // Zachowane wątki czekają na kolejny system.
+        retained->generation++;
+        retained->nparked = 0;
+        cond_broadcast(&retained->wake);
+    }
+    else {
+        thread_attr_init(PTHREAD_CREATE_JOINABLE);
+
+        for (unsigned int i = 0; i <= POOL_SIZE; ++i) {
+            check_if_error(pthread_create(retained->threads + i, &attr,
+                                          thread_main, (void *) (uintptr_t) i),
+                           "pthread create failed");
+        }
+
+        thread_attr_destroy;
+
+        retained->nparked = 0;
+        if (retained->flags & RETAIN_THREADS) {
+            retained->nthreads = POOL_SIZE + 1;
+        }
+    }
+
+    for (unsigned int i = 0; i < current_actors_system->nthreads; ++i) {
+        current_actors_system->threads[i] = retained->threads[i];
+    }
+    current_actors_system->control_thread = retained->threads[POOL_SIZE];
+
+    entity_unlock(retained);
+#endif
+}
+
+int actor_system_retain(int flags) {
+    if (current_actors_system != NULL) {
+        return -1;
+    }
+
+    int err;
+
+    entity_lock(retained);
+
+    retained->flags = flags;
+    if (!(flags & RETAIN_THREADS) && retained->nthreads > 0) {
+        retained->is_closing = true;
+        cond_broadcast(&retained->wake);
+    }
+
+    unsigned int nthreads = retained->is_closing ? retained->nthreads : 0;
+
+    actors_system_t *system = retained->system;
+    if (!(flags & RETAIN_MEMORY)) {
+        retained->system = NULL;
+    }
+
+    entity_unlock(retained);
+
+#ifndef SINGLE_THREADED
+    void *retval;
+
+    for (unsigned int i = 0; i < nthreads; ++i) {
+        thread_join(retained->threads[i]);
+    }
+#endif
+
+    if (nthreads > 0) {
+        entity_lock(retained);
+        retained->nthreads = 0;
+        retained->is_closing = false;
+        entity_unlock(retained);
+    }
+
+    if (!(flags & RETAIN_MEMORY) && system != NULL) {
+        actor_system_destroy(system);
+        free(system);
+    }
+
+    return 0;
+}
+
+void actor_system_notify(actors_system_t *actors_system) {
+    uint64_t value = 1;
+    if (write(actors_system->control_fd, &value, sizeof(value)) != sizeof(value))
+        syserr(errno, "eventfd write failed");
+}
+
+int actor_system_create(actor_id_t *actor, role_t *const role) {
+    if (actor_system_open() != 0) {
+        return -1;
+    }
+
+    int err;
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    entity_writer_lock(actors_array);
+    *actor = actors_array_new_actor(actors_array, role);
+    actor_t *first_actor = actors_array_get_actor(actors_array, *actor);
+    entity_rw_unlock(actors_array);
+
+    entity_lock(current_actors_system);
+    actor_system_enlist(current_actors_system, first_actor);
+    entity_unlock(current_actors_system);
+
+    // Niejawne wysłanie MSG_HELLO do pierwszego aktora
+    current_actor = *actor;
+
+    execute_message(*actor, (message_t) {
+            .message_type = MSG_HELLO,
+            .nbytes = sizeof(actor_id_t),
+            .data = (void *) -1
+    });
+
+    current_actor = -1;
+
+    actor_system_start();
+
+    return 0;
+}
+
+void actor_system_join(actor_id_t actor) {
+    if (actor > current_actors_system->actors_array.nactors) {
+        return;
+    }
+
+    int err;
+
+    // Maskę sygnałów można przywrócić tylko w wątku, który ją zmienił. Inny wątek
+    // blokuje SIGINT jedynie na czas oczekiwania (i obsługi komunikatów).
+    bool is_creator = pthread_equal(pthread_self(), current_actors_system->creator);
+    sigset_t join_sigmask;
+
+    if (!is_creator) {
+        sigset_t sigset;
+        sigemptyset(&sigset);
+        sigaddset(&sigset, SIGINT);
+
+        check_if_error(pthread_sigmask(SIG_BLOCK, &sigset, &join_sigmask), "pthread sigmask failed");
+    }
+
+#ifndef SINGLE_THREADED
+    void *retval;
+    bool is_pooled = retained->flags & RETAIN_THREADS;
+
+    if (is_pooled) {
+        wait_parked(current_actors_system->nthreads);
+    }
+    else {
+        for (unsigned int i = 0; i < current_actors_system->nthreads; ++i) {
+            thread_join(current_actors_system->threads[i]);
+        }
+    }
+
+    entity_lock(current_actors_system);
+    current_actors_system->is_joining = true;
+    entity_unlock(current_actors_system);
+
+    actor_system_notify(current_actors_system);
+
+    if (is_pooled) {
+        wait_parked(current_actors_system->nthreads + 1);
+    }
+    else {
+        thread_join(current_actors_system->control_thread);
+    }
+#else
+    // Wątek wywołujący obsługuje komunikaty do przejścia systemu w stan martwy.
+    dispatch(NULL);
+#endif
+
+    if (current_actors_system->persistence != NULL) {
+        persistence_destroy(current_actors_system->persistence);
+    }
+
+    if (current_actors_system->transport != NULL) {
+        transport_close(current_actors_system->transport);
+    }
+
+    if (current_actors_system->io != NULL) {
+        io_close(current_actors_system->io);
+    }
+
+    if (current_actors_system->watchdog != NULL) {
+        watchdog_close(current_actors_system->watchdog);
+    }
+
+    if (current_actors_system->hibernation != NULL) {
+        hibernation_close(current_actors_system->hibernation);
+    }
+
+    // Żaden wątek roboczy nie korzysta już z zastąpionych wersji danych współdzielonych.
+    rcu_reclaim(true);
+
+    gateway_close(current_actors_system->gateway);
+
+    if (sigaction(SIGINT, &current_actors_system->previous_sigaction, NULL) != 0)
+        syserr(errno, "sigaction failed");
+    atomic_store(&sigint_fd, -1);
+
+    close(current_actors_system->signal_fd);
+    close(current_actors_system->control_fd);
+
+    check_if_error(pthread_sigmask(SIG_SETMASK,
+                                   is_creator ? &current_actors_system->previous_sigmask : &join_sigmask,
+                                   NULL),
+                   "pthread sigmask failed");
+
+    if (retained->flags & RETAIN_MEMORY) {
+        actor_system_recycle(current_actors_system);
+        retained->system = current_actors_system;
+    }
+    else {
+        actor_system_destroy(current_actors_system);
+        free(current_actors_system);
+    }
+
+    current_actors_system = NULL;
+
+#if defined(LOCK_PROFILE) && !defined(SINGLE_THREADED)
+    lock_profile_report(stderr);
+#endif
+
+#ifdef SEGMENTED_MAILBOX
+    if (!(retained->flags & RETAIN_MEMORY)) {
+        queue_message_pool_clear();
+    }
+#endif
+
+    fiber_pool_clear();
+}
+
+/*
+ * Funkcja umieszcza komunikat w skrzynce aktora actor_struct i zapisuje go
+ * w dzienniku persistence (gdy nie jest NULL).
+ */
+static int enqueue(actor_t *actor_struct, actor_id_t actor, message_t message, const long *key,
+                   message_t *replaced, struct persistence *persistence) {
+    int err;
 
     queue_message_t *actor_messages = &actor_struct->msg_queue;
 
+    if (persistence != NULL) {
+        entity_lock(persistence);
+    }
+
+    // Blokada aktora obejmuje też sprawdzenie stanu: inaczej wątek roboczy mógłby
+    // obsłużyć komunikat przed zaplanowaniem aktora z już pustą skrzynką.
+    entity_lock(actor_struct);
     entity_lock(actor_messages);
-    if ((err = queue_message_push(actor_messages, message)) != 0) {
+    coalesce_slot_t *slot = key != NULL
+                            ? actor_coalesce_find(actor_struct, message.message_type, *key)
+                            : NULL;
+
+    if (slot != NULL) {
+        // Aktor ma już zaplanowaną obsługę oczekującego komunikatu.
+        message_t previous = slot->message;
+        slot->message = message;
         entity_unlock(actor_messages);
+        entity_unlock(actor_struct);
+
+        if (persistence != NULL) {
+            persistence_append(persistence, actor_struct, message, key, true);
+            entity_unlock(persistence);
+        }
+
+        if (replaced != NULL) {
+            *replaced = previous;
+        }
+        return 1;
+    }
+
+    message_t pushed = message;
+    if (key != NULL) {
+        slot = actor_coalesce_insert(actor_struct, message, *key);
+        pushed = (message_t) {MSG_COALESCED, sizeof(coalesce_slot_t), slot};
+    }
+
+    if ((err = queue_message_push(actor_messages, pushed)) != 0) {
+        if (slot != NULL) {
+            actor_coalesce_take(actor_struct, slot);
+        }
+        entity_unlock(actor_messages);
+        entity_unlock(actor_struct);
+
+        if (persistence != NULL) {
+            entity_unlock(persistence);
+        }
         return -3;
     }
     entity_unlock(actor_messages);
 
-    entity_lock(actor_struct);
-    if (actor_struct->state == IDLING) {
-        // Aktor nie miał żadnych komunikatów, więc teraz przechodzi w stan oczekiwania.
+    if (persistence != NULL) {
+        persistence_append(persistence, actor_struct, message, key, false);
+        entity_unlock(persistence);
+    }
+
+    if (actor_struct->state == IDLING
+        || (actor_struct->state == SUSPENDED && is_resumable(actor_struct, message.message_type))) {
+        // Aktor nie miał żadnych komunikatów (lub nadszedł komunikat, który może
+        // obsłużyć mimo wstrzymanej obsługi), więc teraz przechodzi w stan oczekiwania.
         actor_struct->state = WAITING;
         entity_unlock(actor_struct);
 
-        queue_actor_id_t *actors_queue = &current_actors_system->waiting_actors;
-
-        entity_lock(actors_queue);
-        queue_actor_id_push(actors_queue, actor);
-        entity_unlock(actors_queue);
+        schedule_actor_next(actor);
     } else {
         entity_unlock(actor_struct);
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * Funkcja umieszcza komunikat w skrzynce aktora. Gdy podano klucz, a aktor ma
+ * oczekujący komunikat o tym samym typie i kluczu, zastępuje go i zwraca 1.
+ */
+static int deliver(actor_id_t actor, message_t message, const long *key, message_t *replaced) {
+    int err;
+
+    if (actor >= TRANSPORT_NODE_BASE) {
+        // Aktor z innego procesu.
+        return transport_send(actor, message);
+    }
+
+    if (actor == ACTOR_OUTSIDE) {
+        // Skrzynka odbierana przez wątek spoza systemu.
+        return gateway_deliver(current_actors_system->gateway, message);
+    }
+
+    entity_lock(current_actors_system);
+    if (current_actors_system->is_interrupted) {
+        // System aktorów nie przyjmuje już komunikatów.
+        entity_unlock(current_actors_system);
+        return -5;
+    }
+    entity_unlock(current_actors_system);
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    entity_reader_lock(actors_array);
+    actor_t *actor_struct = actors_array_get_actor(actors_array, actor);
+    entity_rw_unlock(actors_array);
+
+    if (actor_struct == NULL) {
+        // Brak aktora o podanym id.
+        return -2;
+    }
+
+    entity_lock(actor_struct);
+    if (!actor_struct->is_active) {
+        entity_unlock(actor_struct);
+        return -1;
+    }
+    entity_unlock(actor_struct);
+
+    if (current_actor != -1) {
+        return enqueue(actor_struct, actor, message, key, replaced, NULL);
+    }
+
+    // Komunikaty spoza systemu trafiają do dziennika (jeśli jest włączony).
+    // Blokada systemu wyklucza migawkę między odczytem persistence a umieszczeniem
+    // komunikatu w skrzynce, więc komunikat trafia do migawki albo do dziennika.
+    entity_reader_lock(current_actors_system);
+    int result = enqueue(actor_struct, actor, message, key, replaced, current_actors_system->persistence);
+    entity_rw_unlock(current_actors_system);
+
+    return result;
+}
+
+int send_message(actor_id_t actor, message_t message) {
+    return deliver(actor, message, NULL, NULL);
+}
+
+int send_message_coalesced(actor_id_t actor, message_t message, long key, message_t *replaced) {
+    if (actor >= TRANSPORT_NODE_BASE || actor == ACTOR_OUTSIDE) {
+        // Poza skrzynkami aktorów tego procesu komunikaty nie są scalane.
+        return send_message(actor, message);
+    }
+
+    return deliver(actor, message, &key, replaced);
+}
+
+actor_id_t spawn_many(role_t *const role, size_t count, void *init_data) {
+    if (current_actors_system == NULL) {
+        return -2;
+    }
+
+    if (count == 0) {
+        return -1;
+    }
+
+    int err;
+
+    entity_lock(current_actors_system);
+    if (current_actors_system->is_interrupted) {
+        // System aktorów nie przyjmuje nowych aktorów.
+        entity_unlock(current_actors_system);
+        return -5;
+    }
+    entity_unlock(current_actors_system);
+
+    actor_t **actors;
+    malloc_and_check(actors, count * sizeof(actor_t *));
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+    message_t message_hello = {MSG_HELLO, sizeof(actor_id_t), (void *) actor_id_self()};
+
+    entity_writer_lock(actors_array);
+    actor_id_t first = actors_array_new_actors(actors_array, role, count);
+
+    for (size_t i = 0; first > 0 && i < count; ++i) {
+        actor_t *actor = actors_array_get_actor(actors_array, first + (actor_id_t) i);
+
+        // Pod blokadą pisarza żaden inny wątek nie ma dostępu do nowych aktorów.
+        actor->data = init_data;
+        actor->state = WAITING;
+        queue_message_push(&actor->msg_queue, message_hello);
+        actors[i] = actor;
+    }
+    entity_rw_unlock(actors_array);
+
+    if (first < 0) {
+        free(actors);
+        return -1;
+    }
+
+    bool is_admitted = actor_system_admit(current_actors_system, actors, count);
+    free(actors);
+
+    if (!is_admitted) {
+        return -5;
+    }
+
+    // Obsługa MSG_HELLO nowych aktorów jest rozdzielana między wątki robocze.
+    queue_actor_id_t *actors_queue = &current_actors_system->waiting_actors;
+
+    entity_lock(actors_queue);
+    for (size_t i = 0; i < count; ++i) {
+        queue_actor_id_push(actors_queue, first + (actor_id_t) i);
+    }
+    entity_unlock(actors_queue);
+
+    return first;
+}
+
+int actor_system_shutdown(const struct timespec *deadline) {
+    if (current_actors_system == NULL) {
+        return -2;
+    }
+
+    int err;
+
+    interrupt(current_actors_system);
+
+    if (is_worker) {
+        // Wątek roboczy nie może czekać na opróżnienie kolejek.
+        return 0;
+    }
+
+#ifdef SINGLE_THREADED
+    (void) err;
+
+    // Przerwany system obsługuje pozostałe komunikaty bez czekania na inne wątki.
+    return dispatch(deadline) ? 0 : -1;
+#else
+    int result = 0;
+
+    entity_lock(current_actors_system);
+    while (current_actors_system->is_active) {
+        if (deadline == NULL) {
+            cond_wait(&current_actors_system->finished, &current_actors_system->lock);
+            continue;
+        }
+
+        err = pthread_cond_timedwait(&current_actors_system->finished,
+                                     &current_actors_system->lock, deadline);
+        if (err == ETIMEDOUT) {
+            // Nieobsłużone komunikaty zostają porzucone.
+            actor_system_godie(current_actors_system);
+            result = -1;
+        } else if (err != 0) {
+            syserr(err, "cond timedwait failed");
+        }
+    }
+    entity_unlock(current_actors_system);
+
+    return result;
+#endif
+}
@@ -1,7 +1,13 @@
 #ifndef CACTI_H
 #define CACTI_H
 
+#include <stdbool.h>
 #include <stdlib.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef long message_type_t;
 
@@ -13,6 +19,15 @@ typedef long message_type_t;
 
 #define POOL_SIZE 3
 
+/*
+ * Zbudowany z makrem SINGLE_THREADED system aktorów nie tworzy wątków:
+ * komunikaty obsługuje wątek wywołujący actor_system_join (do przejścia systemu
+ * w stan martwy, czekając w razie potrzeby na komunikaty z bramki) lub
+ * actor_system_shutdown, a blokady i zmienne warunkowe są pomijane. Wyjątkiem
+ * są struktury dostępne dla wątków spoza systemu: skrzynka ACTOR_OUTSIDE
+ * (actor_system_receive) i wersje danych współdzielonych (rcu_publish).
+ */
+
 typedef struct message {
     message_type_t message_type;
     size_t nbytes;
@@ -23,17 +38,123 @@ typedef long actor_id_t;
 
 typedef void (*const act_t)(void **stateptr, size_t nbytes, void *data);
 
+/*
+ * Typ komunikatu przekazywany funkcjom serializacji przy zapisie stanu aktora.
+ */
+#define MSG_STATE (message_type_t)0x57A7E000
+
+/*
+ * Wynik serializacji oznaczający, że obiekt nie jest zapisywany.
+ */
+#define SERIALIZE_SKIP (size_t)-1
+
+/*
+ * Funkcja zapisuje obiekt (stan aktora dla MSG_STATE lub dane komunikatu
+ * o danym typie) do bufora o rozmiarze size. Zwraca liczbę bajtów zapisu;
+ * jeśli jest większa od size, zostanie wywołana ponownie z większym buforem.
+ */
+typedef size_t (*serialize_t)(message_type_t type, void *object, size_t nbytes,
+                              void *buffer, size_t size);
+
+/*
+ * Funkcja odtwarza obiekt zapisany przez serialize_t.
+ */
+typedef void *(*deserialize_t)(message_type_t type, const void *buffer, size_t size);
+
+/*
+ * Funkcja zwalnia stan aktora po jego zapisaniu przez serialize_t
+ * (przy hibernacji bezczynnego aktora, actor_system_hibernate).
+ */
+typedef void (*release_t)(void *state);
+
+/*
+ * Komunikaty aktorów roli z is_suspendable są obsługiwane we włóknach
+ * (z wyjątkiem MSG_SPAWN i MSG_GODIE), więc obsługa może czekać w actor_await.
+ */
 typedef struct role {
     size_t nprompts;
     act_t *prompts;
+    serialize_t serialize;
+    deserialize_t deserialize;
+    bool is_suspendable;
+    release_t release;
 } role_t;
 
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
+/*
+ * Funkcja czeka na zakończenie systemu aktorów i go zwalnia. SIGINT jest
+ * zablokowany w wątku tworzącym system od actor_system_create; maska sygnałów
+ * tego wątku jest przywracana, gdy to on wywołuje actor_system_join. Wątki
+ * utworzone wcześniej, które nie blokują SIGINT, przekazują go systemowi (o ile
+ * obsługa SIGINT była domyślna); poprzednia obsługa jest przywracana w actor_system_join.
+ */
 void actor_system_join(actor_id_t actor);
 
 int send_message(actor_id_t actor, message_t message);
 
+/*
+ * Funkcja wysyła komunikat z kluczem scalania. Jeśli w skrzynce aktora czeka
+ * nieobsłużony komunikat o tym samym typie i kluczu, nowy komunikat zajmuje jego
+ * miejsce, a zastąpiony jest zapisywany w *replaced (gdy replaced != NULL), aby
+ * nadawca mógł zwolnić jego dane. Zwraca 1 po zastąpieniu, 0 po dołączeniu
+ * komunikatu do skrzynki i kody błędów send_message w pozostałych przypadkach.
+ * Do aktorów z innych procesów i skrzynki zewnętrznej komunikat jest wysyłany
+ * bez scalania.
+ */
+int send_message_coalesced(actor_id_t actor, message_t message, long key, message_t *replaced);
+
 actor_id_t actor_id_self();
 
+/*
+ * Funkcja tworzy count aktorów o roli role w jednej operacji na tablicy aktorów
+ * i zwraca id pierwszego z nich; pozostali mają kolejne id. Stan każdego z nowych
+ * aktorów jest ustawiany na init_data, po czym otrzymuje on MSG_HELLO z id aktora
+ * wywołującego (-1 poza obsługą komunikatu), obsługiwany równolegle przez wątki
+ * robocze. Zwraca -1 gdy count jest równe 0 lub przekroczono by CAST_LIMIT,
+ * -2 gdy nie działa żaden system aktorów, -5 gdy system nie przyjmuje aktorów.
+ */
+actor_id_t spawn_many(role_t *const role, size_t count, void *init_data);
+
+/*
+ * Funkcja wstrzymuje obsługę komunikatu do nadejścia komunikatu o typie type,
+ * zwalniając wątek roboczy, i zapisuje jego rozmiar i dane w *nbytes i *data
+ * (komunikat nie jest przekazywany do prompts). Do tego czasu pozostałe
+ * komunikaty aktora czekają w jego skrzynce, z wyjątkiem MSG_SPAWN, który jest
+ * obsługiwany od razu. Zwraca 0 po wznowieniu, -1 gdy
+ * obsługa komunikatu nie jest wykonywana we włóknie. Wstrzymana obsługa nie jest
+ * zapisywana w migawce, a przerwanie systemu ją porzuca.
+ */
+int actor_await(message_type_t type, size_t *nbytes, void **data);
+
+/*
+ * Funkcja blokuje przyjmowanie komunikatów i tworzenie aktorów (jak SIGINT),
+ * a następnie czeka, aż aktorzy obsłużą zaległe komunikaty. Po upływie
+ * deadline (czas bezwzględny CLOCK_REALTIME, NULL oznacza brak limitu)
+ * pozostałe komunikaty zostają porzucone. Wywołana z obsługi komunikatu
+ * jedynie inicjuje zamknięcie. Zwraca 0, gdy kolejki zostały opróżnione,
+ * -1 po upływie deadline, -2 gdy nie działa żaden system aktorów.
+ * Po jej wywołaniu należy wywołać actor_system_join.
+ */
+int actor_system_shutdown(const struct timespec *deadline);
+
+/*
+ * Flagi actor_system_retain: RETAIN_THREADS zachowuje wątki systemu (robocze
+ * i kontrolny), które obsłużą kolejny system aktorów bez ponownego tworzenia;
+ * RETAIN_MEMORY zachowuje pamięć systemu, tablicy aktorów i ich skrzynek.
+ */
+#define RETAIN_THREADS 0x1
+#define RETAIN_MEMORY 0x2
+
+/*
+ * Funkcja ustawia zasoby zachowywane przez actor_system_join dla kolejnych
+ * systemów aktorów. Wywołanie z flagami 0 zwalnia zachowane zasoby (np. przed
+ * zakończeniem programu). Zwraca -1, gdy działa system aktorów.
+ */
+int actor_system_retain(int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,267 @@
+#ifndef CACTI_HPP
+#define CACTI_HPP
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "cacti.h"
+
+/*
+ * Nakładka C++17 na cacti.h. Klasa aktora deklaruje typy swoich komunikatów:
+ *
+ *     struct counter {
+ *         using messages = cacti::messages<add, report>;
+ *
+ *         void on_hello(actor_id_t parent);   // opcjonalna
+ *         void on(add &&message);
+ *         void on(report &&message);
+ *     };
+ *
+ * a tablica rozdzielcza role_t jest generowana w czasie kompilacji: typ komunikatu
+ * to 1 + pozycja typu na liście (0 to MSG_HELLO). Stan aktora (obiekt klasy)
+ * jest tworzony przy obsłudze MSG_HELLO i usuwany po cacti::ref::stop.
+ *
+ * Komunikat jest przenoszony do skrzynki: obiekty trywialnie kopiowalne
+ * nie większe niż wskaźnik są zapisywane w polu data, pozostałe są tworzone
+ * w bloku z puli message_alloc i niszczone po obsłudze (lub po nieudanym wysłaniu).
+ */
+
+extern "C" {
+
+/*
+ * Funkcje puli danych komunikatów (pool.h korzysta z konstrukcji C11
+ * niedostępnych w C++).
+ */
+void *message_alloc(size_t size);
+
+void message_free(void *data);
+
+}
+
+namespace cacti {
+
+/*
+ * Lista typów komunikatów aktora.
+ */
+template <typename... Messages>
+struct messages {};
+
+namespace detail {
+
+template <typename M, typename... Ms>
+struct index_of;
+
+template <typename M, typename... Ms>
+struct index_of<M, M, Ms...> : std::integral_constant<message_type_t, 0> {};
+
+template <typename M, typename N, typename... Ms>
+struct index_of<M, N, Ms...> : std::integral_constant<message_type_t, 1 + index_of<M, Ms...>::value> {};
+
+template <typename M, typename List>
+struct list_index;
+
+template <typename M, typename... Ms>
+struct list_index<M, messages<Ms...>> {
+    static_assert((std::is_same_v<M, Ms> || ...), "message type is not handled by the actor");
+
+    static constexpr message_type_t value = 1 + index_of<M, Ms...>::value;
+};
+
+template <typename M>
+inline constexpr bool is_inline = std::is_trivially_copyable_v<M>
+                                  && sizeof(M) <= sizeof(void *)
+                                  && alignof(M) <= alignof(void *);
+
+template <typename A, typename = void>
+struct has_on_hello : std::false_type {};
+
+template <typename A>
+struct has_on_hello<A, std::void_t<decltype(std::declval<A &>().on_hello(actor_id_t()))>> : std::true_type {};
+
+/*
+ * Funkcja przenosi obiekt do komunikatu o typie type.
+ */
+template <typename M>
+message_t pack(message_type_t type, M &&object) {
+    using T = std::decay_t<M>;
+
+    message_t message = {type, sizeof(T), nullptr};
+
+    if constexpr (is_inline<T>) {
+        std::memcpy(&message.data, &object, sizeof(T));
+    }
+    else {
+        message.data = new(message_alloc(sizeof(T))) T(std::forward<M>(object));
+    }
+
+    return message;
+}
+
+/*
+ * Funkcja przenosi obiekt z danych komunikatu i zwalnia jego blok.
+ */
+template <typename T>
+T unpack(void *data) {
+    if constexpr (is_inline<T>) {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::memcpy(storage, &data, sizeof(T));
+        return *std::launder(reinterpret_cast<T *>(storage));
+    }
+    else {
+        T *stored = static_cast<T *>(data);
+        T object(std::move(*stored));
+        stored->~T();
+        message_free(stored);
+        return object;
+    }
+}
+
+/*
+ * Funkcja niszczy nieobsłużony obiekt z danych komunikatu.
+ */
+template <typename T>
+void discard(void *data) {
+    if constexpr (!is_inline<T>) {
+        T *stored = static_cast<T *>(data);
+        stored->~T();
+        message_free(stored);
+    }
+}
+
+} // namespace detail
+
+/*
+ * Rola aktora klasy Actor (tablica rozdzielcza wygenerowana z Actor::messages).
+ * Ostatni typ komunikatu (stop_type) usuwa stan aktora i wysyła mu MSG_GODIE;
+ * komunikaty obsługiwane później są niszczone bez obsługi.
+ */
+template <typename Actor, typename List = typename Actor::messages>
+struct role_of;
+
+template <typename Actor, typename... Ms>
+struct role_of<Actor, messages<Ms...>> {
+    static constexpr message_type_t stop_type = sizeof...(Ms) + 1;
+
+    static void hello(void **stateptr, size_t, void *data) {
+        if (*stateptr == nullptr) {
+            *stateptr = new Actor();
+        }
+
+        if constexpr (detail::has_on_hello<Actor>::value) {
+            static_cast<Actor *>(*stateptr)->on_hello(reinterpret_cast<actor_id_t>(data));
+        }
+    }
+
+    template <typename M>
+    static void receive(void **stateptr, size_t, void *data) {
+        if (*stateptr == nullptr) {
+            // Aktor został już zatrzymany.
+            detail::discard<M>(data);
+            return;
+        }
+
+        static_cast<Actor *>(*stateptr)->on(detail::unpack<M>(data));
+    }
+
+    static void stop(void **stateptr, size_t, void *) {
+        delete static_cast<Actor *>(*stateptr);
+        *stateptr = nullptr;
+
+        send_message(actor_id_self(), message_t{MSG_GODIE, 0, nullptr});
+    }
+
+    inline static act_t prompts[] = {hello, receive<Ms>..., stop};
+
+    inline static role_t role = {sizeof...(Ms) + 2, prompts, nullptr, nullptr, false, nullptr};
+};
+
+/*
+ * Typowany identyfikator aktora klasy Actor.
+ */
+template <typename Actor>
+class ref {
+public:
+    explicit ref(actor_id_t id = -1) : id_(id) {}
+
+    actor_id_t id() const {
+        return id_;
+    }
+
+    /*
+     * Funkcja przenosi komunikat do skrzynki aktora.
+     * Zwraca wynik send_message; komunikat niewysłany jest niszczony.
+     */
+    template <typename M>
+    int send(M &&message) const {
+        using T = std::decay_t<M>;
+
+        message_t packed = detail::pack(detail::list_index<T, typename Actor::messages>::value,
+                                        std::forward<M>(message));
+
+        int err = send_message(id_, packed);
+        if (err < 0) {
+            detail::discard<T>(packed.data);
+        }
+
+        return err;
+    }
+
+    /*
+     * Funkcja zatrzymuje aktora po obsłużeniu komunikatów wysłanych wcześniej.
+     */
+    int stop() const {
+        return send_message(id_, message_t{role_of<Actor>::stop_type, 0, nullptr});
+    }
+
+private:
+    actor_id_t id_;
+};
+
+/*
+ * Funkcja zwraca identyfikator aktora, którego komunikat jest obsługiwany.
+ */
+template <typename Actor>
+ref<Actor> self() {
+    return ref<Actor>(actor_id_self());
+}
+
+/*
+ * Funkcja tworzy system aktorów z pierwszym aktorem klasy Actor (jak actor_system_create).
+ */
+template <typename Actor>
+int create(ref<Actor> *first) {
+    actor_id_t id;
+    int err = actor_system_create(&id, &role_of<Actor>::role);
+    *first = ref<Actor>(id);
+    return err;
+}
+
+template <typename Actor>
+void join(ref<Actor> actor) {
+    actor_system_join(actor.id());
+}
+
+/*
+ * Funkcja tworzy aktora klasy Actor (MSG_SPAWN wysłany do aktora wywołującego);
+ * nowy aktor otrzymuje id rodzica w on_hello.
+ */
+template <typename Actor>
+int spawn() {
+    return send_message(actor_id_self(), message_t{MSG_SPAWN, sizeof(role_t), &role_of<Actor>::role});
+}
+
+/*
+ * Funkcja tworzy count aktorów klasy Actor o kolejnych id (jak spawn_many)
+ * i zwraca pierwszego z nich (id jest ujemnym kodem błędu spawn_many w przypadku
+ * niepowodzenia).
+ */
+template <typename Actor>
+ref<Actor> spawn_many(size_t count) {
+    return ref<Actor>(::spawn_many(&role_of<Actor>::role, count, nullptr));
+}
+
+} // namespace cacti
+
+#endif //CACTI_HPP
@@ -0,0 +1,189 @@
+#include "fiber.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "err.h"
+#include "utils.h"
+
+/*
+ * Włókno ze stosem zaalokowanym przez mmap; najniższa strona stosu jest
+ * stroną ochronną, więc przepełnienie stosu kończy się błędem ochrony pamięci.
+ * caller to kontekst wątku, który ostatnio wznowił włókno.
+ */
+struct fiber {
+    ucontext_t context;
+    ucontext_t caller;
+    void *stack;
+    size_t stack_size;
+    void (*prompt)(void **stateptr, size_t nbytes, void *data);
+    void **stateptr;
+    message_t message;
+    message_type_t awaited;
+    bool is_finished;
+    struct fiber *next;
+};
+
+/*
+ * Włókno wykonywane przez wątek (NULL poza włóknem).
+ */
+static _Thread_local fiber_t *current_fiber = NULL;
+
+/*
+ * Pula wolnych włókien wątku. Klucz wątku służy jedynie do zwolnienia puli
+ * przy zakończeniu wątku.
+ */
+static _Thread_local fiber_t *pool = NULL;
+static _Thread_local size_t pool_size = 0;
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+void fiber_free(fiber_t *fiber) {
+    if (munmap(fiber->stack, fiber->stack_size) != 0) {
+        syserr(errno, "munmap failed");
+    }
+
+    free(fiber);
+}
+
+void fiber_pool_clear(void) {
+    while (pool != NULL) {
+        fiber_t *fiber = pool;
+        pool = fiber->next;
+        fiber_free(fiber);
+    }
+
+    pool_size = 0;
+}
+
+static void pool_destructor(UNUSED void *data) {
+    fiber_pool_clear();
+}
+
+static void pool_key_create(void) {
+    int err;
+
+    check_if_error(pthread_key_create(&pool_key, pool_destructor), "pthread key create failed");
+}
+
+/*
+ * Funkcja oddaje włókno do puli wątku (lub zwalnia je, gdy pula jest pełna).
+ */
+static void fiber_put(fiber_t *fiber) {
+    int err;
+
+    if (pool_size >= FIBER_POOL_LIMIT) {
+        fiber_free(fiber);
+        return;
+    }
+
+    if (pool == NULL) {
+        // Rejestracja zwolnienia puli przy zakończeniu wątku.
+        check_if_error(pthread_once(&pool_once, pool_key_create), "pthread once failed");
+        check_if_error(pthread_setspecific(pool_key, &pool), "pthread setspecific failed");
+    }
+
+    fiber->next = pool;
+    pool = fiber;
+    pool_size++;
+}
+
+/*
+ * Funkcja początkowa włókna. Po zakończeniu obsługi komunikatu wraca
+ * do wątku, który wznowił włókno jako ostatni.
+ */
+static void fiber_main(void) {
+    fiber_t *fiber = current_fiber;
+
+    fiber->prompt(fiber->stateptr, fiber->message.nbytes, fiber->message.data);
+
+    fiber->is_finished = true;
+    setcontext(&fiber->caller);
+}
+
+fiber_t *fiber_new(act_t prompt, void **stateptr) {
+    fiber_t *fiber = pool;
+
+    if (fiber != NULL) {
+        pool = fiber->next;
+        pool_size--;
+    }
+    else {
+        malloc_and_check(fiber, sizeof(fiber_t));
+
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        fiber->stack_size = (FIBER_STACK_SIZE + page - 1) / page * page + page;
+        fiber->stack = mmap(NULL, fiber->stack_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (fiber->stack == MAP_FAILED) {
+            syserr(errno, "mmap failed");
+        }
+        if (mprotect(fiber->stack, page, PROT_NONE) != 0) {
+            syserr(errno, "mprotect failed");
+        }
+    }
+
+    if (getcontext(&fiber->context) != 0) {
+        syserr(errno, "getcontext failed");
+    }
+
+    fiber->context.uc_stack.ss_sp = fiber->stack;
+    fiber->context.uc_stack.ss_size = fiber->stack_size;
+    fiber->context.uc_link = NULL;
+    makecontext(&fiber->context, fiber_main, 0);
+
+    fiber->prompt = prompt;
+    fiber->stateptr = stateptr;
+    fiber->awaited = MSG_HELLO;
+    fiber->is_finished = false;
+    fiber->next = NULL;
+
+    return fiber;
+}
+
+bool fiber_resume(fiber_t *fiber, message_t message) {
+    fiber->message = message;
+    current_fiber = fiber;
+
+    if (swapcontext(&fiber->caller, &fiber->context) != 0) {
+        syserr(errno, "swapcontext failed");
+    }
+
+    current_fiber = NULL;
+
+    if (!fiber->is_finished) {
+        return false;
+    }
+
+    fiber_put(fiber);
+    return true;
+}
+
+message_type_t fiber_awaited(const fiber_t *fiber) {
+    return fiber->awaited;
+}
+
+int actor_await(message_type_t type, size_t *nbytes, void **data) {
+    fiber_t *fiber = current_fiber;
+
+    if (fiber == NULL) {
+        // Obsługa komunikatu nie jest wykonywana we włóknie.
+        return -1;
+    }
+
+    fiber->awaited = type;
+
+    // Włókno może zostać wznowione przez inny wątek, więc po powrocie
+    // korzysta tylko ze swoich pól.
+    if (swapcontext(&fiber->context, &fiber->caller) != 0) {
+        syserr(errno, "swapcontext failed");
+    }
+
+    *nbytes = fiber->message.nbytes;
+    *data = fiber->message.data;
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <stdbool.h>
+
+#include "cacti.h"
+
+/*
+ * Rozmiar stosu włókna (bez strony ochronnej).
+ */
+#ifndef FIBER_STACK_SIZE
+#define FIBER_STACK_SIZE (64 * 1024)
+#endif
+
+/*
+ * Maksymalna liczba wolnych włókien w puli jednego wątku.
+ */
+#ifndef FIBER_POOL_LIMIT
+#define FIBER_POOL_LIMIT 16
+#endif
+
+/*
+ * Włókno wykonujące obsługę komunikatu aktora o roli z is_suspendable.
+ * Wstrzymane włókno może zostać wznowione przez dowolny wątek roboczy.
+ */
+typedef struct fiber fiber_t;
+
+/*
+ * Funkcja pobiera włókno z puli wątku (lub tworzy nowe), które przy pierwszym
+ * wznowieniu wywoła prompt ze stanem stateptr i komunikatem wznowienia.
+ */
+fiber_t *fiber_new(act_t prompt, void **stateptr);
+
+/*
+ * Funkcja wykonuje włókno do zakończenia obsługi komunikatu lub do wstrzymania
+ * w actor_await, które otrzyma message. Zakończone włókno wraca do puli wątku.
+ * Zwraca true, gdy obsługa komunikatu została zakończona.
+ */
+bool fiber_resume(fiber_t *fiber, message_t message);
+
+/*
+ * Funkcja zwraca typ komunikatu, na który czeka wstrzymane włókno.
+ */
+message_type_t fiber_awaited(const fiber_t *fiber);
+
+/*
+ * Funkcja zwalnia wstrzymane włókno bez dokończenia obsługi komunikatu.
+ */
+void fiber_free(fiber_t *fiber);
+
+/*
+ * Funkcja zwalnia wolne włókna z puli wywołującego wątku.
+ * Pule wątków roboczych są zwalniane automatycznie przy ich zakończeniu.
+ */
+void fiber_pool_clear(void);
+
+#endif //FIBER_H
@@ -0,0 +1,65 @@
+#include "future.h"
+
+#include "utils.h"
+
+void future_init(future_t *future, actor_id_t actor, message_type_t reply) {
+    int err;
+
+    future->is_ready = false;
+    future->value = NULL;
+    future->actor = actor;
+    future->reply = reply;
+    mutex_init(&future->lock);
+    cond_init(&future->ready);
+}
+
+void future_destroy(future_t *future) {
+    int err;
+
+    mutex_destroy(&future->lock);
+    cond_destroy(&future->ready);
+}
+
+void future_complete(future_t *future, void *value) {
+    int err;
+
+    // Po zwolnieniu blokady future może zostać zniszczona przez czekający wątek,
+    // więc aktor otrzymuje samą wartość.
+    actor_id_t actor = future->actor;
+    message_type_t reply = future->reply;
+
+    entity_lock(future);
+    future->value = value;
+    future->is_ready = true;
+    cond_broadcast(&future->ready);
+    entity_unlock(future);
+
+    if (actor != -1) {
+        send_message(actor, (message_t) {reply, sizeof(void *), value});
+    }
+}
+
+bool future_is_ready(future_t *future) {
+    int err;
+
+    entity_lock(future);
+    bool is_ready = future->is_ready;
+    entity_unlock(future);
+
+    return is_ready;
+}
+
+void *future_wait(future_t *future) {
+    int err;
+
+    entity_lock(future);
+#ifndef SINGLE_THREADED
+    while (!future->is_ready) {
+        cond_wait(&future->ready, &future->lock);
+    }
+#endif
+    void *value = future->is_ready ? future->value : NULL;
+    entity_unlock(future);
+
+    return value;
+}
@@ -0,0 +1,51 @@
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "cacti.h"
+
+/*
+ * Wynik obliczenia, które zakończy się w przyszłości. Po jego spełnieniu aktor
+ * actor (o ile jest różny od -1) otrzymuje komunikat typu reply z jej wartością
+ * jako danymi (future może już wtedy nie istnieć), a wątki czekające
+ * w future_wait są budzone.
+ */
+typedef struct future {
+    bool is_ready;
+    void *value;
+    actor_id_t actor;
+    message_type_t reply;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} future_t;
+
+/*
+ * Funkcja inicjuje niespełnioną future.
+ */
+void future_init(future_t *future, actor_id_t actor, message_type_t reply);
+
+/*
+ * Funkcja zwalnia zasoby future.
+ */
+void future_destroy(future_t *future);
+
+/*
+ * Funkcja spełnia future wartością value.
+ */
+void future_complete(future_t *future, void *value);
+
+/*
+ * Funkcja sprawdza, czy future została spełniona.
+ */
+bool future_is_ready(future_t *future);
+
+/*
+ * Funkcja czeka na spełnienie future i zwraca jej wartość. Nie może być
+ * wywoływana z obsługi komunikatu. W trybie jednowątkowym (SINGLE_THREADED)
+ * nie czeka i zwraca NULL dla niespełnionej future.
+ */
+void *future_wait(future_t *future);
+
+#endif //FUTURE_H
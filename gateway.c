@@ -0,0 +1,199 @@
+#include "gateway.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "utils.h"
+
+/*
+ * Funkcja zgłasza gotowość deskryptora eventfd.
+ */
+static void signal_fd(int fd) {
+    uint64_t value = 1;
+    if (write(fd, &value, sizeof(value)) != sizeof(value))
+        syserr(errno, "eventfd write failed");
+}
+
+/*
+ * Funkcja zeruje licznik deskryptora eventfd.
+ */
+static void clear_fd(int fd) {
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) != sizeof(value) && errno != EAGAIN)
+        syserr(errno, "eventfd read failed");
+}
+
+int actor_system_post(const actor_id_t *actors, const message_t *messages, size_t count) {
+    actors_system_t *actors_system = current_actors_system;
+
+    if (actors_system == NULL) {
+        return -1;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    gateway_t *gateway = actors_system->gateway;
+
+    // Paczka jest wiązana od końca, by po odwróceniu stosu zachować kolejność.
+    ingress_t *batch;
+    malloc_and_check(batch, count * sizeof(ingress_t));
+
+    for (size_t i = 0; i < count; ++i) {
+        batch[i] = (ingress_t) {
+                .actor = actors[i],
+                .message = messages[i],
+                .batch = batch,
+                .is_last = i + 1 == count,
+                .next = i > 0 ? &batch[i - 1] : NULL
+        };
+    }
+
+    ingress_t *head = atomic_load_explicit(&gateway->ingress, memory_order_relaxed);
+    do {
+        batch[0].next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&gateway->ingress, &head, &batch[count - 1],
+                                                    memory_order_release, memory_order_relaxed));
+
+    // Wątek kontrolny budzi tylko pierwsza paczka od ostatniego opróżnienia kolejki.
+    if (head == NULL) {
+        signal_fd(gateway->ingress_fd);
+    }
+
+    return 0;
+}
+
+int actor_system_fd(void) {
+    if (current_actors_system == NULL) {
+        return -1;
+    }
+
+    return current_actors_system->gateway->outside_fd;
+}
+
+ssize_t actor_system_receive(message_t *messages, size_t count) {
+    if (current_actors_system == NULL) {
+        return -1;
+    }
+
+    int err;
+
+    gateway_t *gateway = current_actors_system->gateway;
+    queue_message_t *outside = &gateway->outside;
+    size_t received = 0;
+
+    entity_shared_lock(outside);
+    while (received < count && !queue_message_is_empty(outside)) {
+        messages[received++] = queue_message_pop(outside);
+    }
+
+    if (received > 0 && queue_message_is_empty(outside)) {
+        clear_fd(gateway->outside_fd);
+    }
+    entity_shared_unlock(outside);
+
+    return (ssize_t) received;
+}
+
+gateway_t *gateway_open(void) {
+    gateway_t *gateway;
+    malloc_and_check(gateway, sizeof(gateway_t));
+
+    atomic_init(&gateway->ingress, NULL);
+    gateway->pending = NULL;
+    queue_message_init(&gateway->outside, GATEWAY_OUTSIDE_LIMIT);
+
+    if ((gateway->ingress_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        syserr(errno, "eventfd failed");
+
+    if ((gateway->outside_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        syserr(errno, "eventfd failed");
+
+    return gateway;
+}
+
+/*
+ * Funkcja przenosi komunikaty z kolejki wejściowej na koniec listy oczekujących.
+ */
+static void take_ingress(gateway_t *gateway) {
+    ingress_t *stack = atomic_exchange_explicit(&gateway->ingress, NULL, memory_order_acquire);
+
+    // Odwrócenie stosu daje komunikaty w kolejności przekazania.
+    ingress_t *list = NULL;
+    while (stack != NULL) {
+        ingress_t *next = stack->next;
+        stack->next = list;
+        list = stack;
+        stack = next;
+    }
+
+    ingress_t **tail = &gateway->pending;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = list;
+}
+
+bool gateway_drain(gateway_t *gateway) {
+    clear_fd(gateway->ingress_fd);
+    take_ingress(gateway);
+
+    while (gateway->pending != NULL) {
+        ingress_t *ingress = gateway->pending;
+
+        if (send_message(ingress->actor, ingress->message) == -3) {
+            // Skrzynka adresata jest pełna - kolejne komunikaty czekają na swoją kolej.
+            return true;
+        }
+
+        gateway->pending = ingress->next;
+        if (ingress->is_last) {
+            free(ingress->batch);
+        }
+    }
+
+    return false;
+}
+
+int gateway_deliver(gateway_t *gateway, message_t message) {
+    int err;
+
+    queue_message_t *outside = &gateway->outside;
+
+    entity_shared_lock(outside);
+    bool is_empty = queue_message_is_empty(outside);
+    if (queue_message_push(outside, message) != 0) {
+        // Wątek spoza systemu nie nadąża z odbieraniem komunikatów.
+        entity_shared_unlock(outside);
+        return -3;
+    }
+
+    if (is_empty) {
+        signal_fd(gateway->outside_fd);
+    }
+    entity_shared_unlock(outside);
+
+    return 0;
+}
+
+void gateway_close(gateway_t *gateway) {
+    take_ingress(gateway);
+
+    // Niedostarczone komunikaty są porzucane.
+    while (gateway->pending != NULL) {
+        ingress_t *ingress = gateway->pending;
+        gateway->pending = ingress->next;
+        if (ingress->is_last) {
+            free(ingress->batch);
+        }
+    }
+
+    queue_message_destroy(&gateway->outside);
+    close(gateway->ingress_fd);
+    close(gateway->outside_fd);
+    free(gateway);
+}
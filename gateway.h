@@ -0,0 +1,103 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "cacti.h"
+#include "queue_message.h"
+
+/*
+ * Identyfikator skrzynki "na zewnątrz" systemu aktorów. Komunikaty wysłane
+ * do niej odbiera wątek spoza systemu funkcją actor_system_receive.
+ * Identyfikator jest ujemny, więc nigdy nie był identyfikatorem aktora.
+ */
+#define ACTOR_OUTSIDE ((actor_id_t) -0x00751DE)
+
+/*
+ * Maksymalna liczba nieodebranych komunikatów w skrzynce ACTOR_OUTSIDE.
+ */
+#ifndef GATEWAY_OUTSIDE_LIMIT
+#define GATEWAY_OUTSIDE_LIMIT 1024
+#endif
+
+/*
+ * Czas (w ms), po którym wątek kontrolny ponawia dostarczenie komunikatów
+ * z kolejki wejściowej, gdy skrzynka adresata była pełna.
+ */
+#ifndef GATEWAY_RETRY_INTERVAL
+#define GATEWAY_RETRY_INTERVAL 1
+#endif
+
+/*
+ * Komunikat w kolejce wejściowej. Komunikaty jednej paczki leżą w jednym
+ * bloku pamięci, zwalnianym po dostarczeniu ostatniego z nich.
+ */
+typedef struct ingress {
+    actor_id_t actor;
+    message_t message;
+    struct ingress *batch;
+    bool is_last;
+    struct ingress *next;
+} ingress_t;
+
+/*
+ * Struktura łącząca system aktorów z zewnętrzną pętlą zdarzeń.
+ * Kolejka wejściowa jest stosem bez blokad, opróżnianym przez wątek kontrolny;
+ * skrzynka zewnętrzna jest sygnalizowana deskryptorem outside_fd.
+ */
+typedef struct gateway {
+    _Atomic(ingress_t *) ingress;
+    int ingress_fd;
+    ingress_t *pending;
+    queue_message_t outside;
+    int outside_fd;
+} gateway_t;
+
+/*
+ * Funkcja przekazuje do systemu aktorów count komunikatów (messages[i] do
+ * aktora actors[i]) bez zajmowania blokad aktorów. Komunikaty są dostarczane
+ * przez wątek kontrolny w kolejności przekazania.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów.
+ */
+int actor_system_post(const actor_id_t *actors, const message_t *messages, size_t count);
+
+/*
+ * Funkcja zwraca deskryptor, który jest gotowy do odczytu, gdy w skrzynce
+ * ACTOR_OUTSIDE są komunikaty (-1 gdy nie działa żaden system aktorów).
+ * Deskryptor jest zamykany przez actor_system_join.
+ */
+int actor_system_fd(void);
+
+/*
+ * Funkcja zdejmuje ze skrzynki ACTOR_OUTSIDE co najwyżej count komunikatów.
+ * Zwraca liczbę odebranych komunikatów (0 gdy skrzynka jest pusta) lub -1
+ * gdy nie działa żaden system aktorów.
+ */
+ssize_t actor_system_receive(message_t *messages, size_t count);
+
+/*
+ * Funkcja tworzy bramkę systemu aktorów.
+ */
+gateway_t *gateway_open(void);
+
+/*
+ * Funkcja dostarcza komunikaty z kolejki wejściowej. Zwraca true, jeśli część
+ * z nich czeka na miejsce w skrzynce adresata.
+ */
+bool gateway_drain(gateway_t *gateway);
+
+/*
+ * Funkcja umieszcza komunikat w skrzynce ACTOR_OUTSIDE.
+ * Zwraca 0 w przypadku powodzenia, -3 gdy skrzynka jest pełna.
+ */
+int gateway_deliver(gateway_t *gateway, message_t message);
+
+/*
+ * Funkcja zamyka bramkę, porzucając niedostarczone komunikaty.
+ */
+void gateway_close(gateway_t *gateway);
+
+#endif //GATEWAY_H
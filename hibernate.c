@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+
+#include "hibernate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "err.h"
+#include "system.h"
+#include "utils.h"
+
+#define SCRATCH_STARTING_SIZE 4096
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+#define LZ_HASH_BITS 12
+
+/*
+ * Nagłówek bloku magazynu. Po nim następuje size bajtów zapisu stanu
+ * (skompresowanego, gdy is_compressed). W wolnym bloku size to kolejny
+ * element listy wolnych bloków.
+ */
+typedef struct record {
+    uint32_t block_class;
+    uint32_t is_compressed;
+    uint64_t size;
+    uint64_t state_size;
+} record_t;
+
+static unsigned long now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Funkcja dopisuje długość przekraczającą 15 (pole tokenu) w bajtach po 255.
+ */
+static size_t lz_put_length(unsigned char *output, size_t length) {
+    size_t written = 0;
+
+    for (; length >= 255; length -= 255) {
+        output[written++] = 255;
+    }
+    output[written++] = (unsigned char) length;
+
+    return written;
+}
+
+/*
+ * Funkcja dopisuje sekwencję: literals bajtów bez zmian i (gdy length > 0)
+ * powtórzenie length bajtów sprzed offset bajtów.
+ */
+static size_t lz_put_sequence(unsigned char *output, const unsigned char *literals, size_t nliterals,
+                              size_t offset, size_t length) {
+    size_t written = 1;
+    size_t match = length > 0 ? length - LZ_MIN_MATCH : 0;
+
+    output[0] = (unsigned char) ((nliterals < 15 ? nliterals : 15) << 4 | (match < 15 ? match : 15));
+
+    if (nliterals >= 15) {
+        written += lz_put_length(output + written, nliterals - 15);
+    }
+
+    memcpy(output + written, literals, nliterals);
+    written += nliterals;
+
+    if (length > 0) {
+        output[written++] = (unsigned char) offset;
+        output[written++] = (unsigned char) (offset >> 8);
+
+        if (match >= 15) {
+            written += lz_put_length(output + written, match - 15);
+        }
+    }
+
+    return written;
+}
+
+/*
+ * Funkcja kompresuje size bajtów (LZ77 z tokenami w stylu LZ4) do bufora output
+ * o rozmiarze co najmniej size + size / 255 + 16. Zwraca rozmiar wyniku.
+ */
+static size_t lz_compress(const unsigned char *input, size_t size, unsigned char *output) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t written = 0, anchor = 0, i = 0;
+
+    while (i + LZ_MIN_MATCH <= size) {
+        uint32_t sequence;
+        memcpy(&sequence, input + i, sizeof(sequence));
+
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t) i + 1;
+
+        if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET
+            || memcmp(input + candidate - 1, input + i, LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < size && input[match + length] == input[i + length]) {
+            length++;
+        }
+
+        written += lz_put_sequence(output + written, input + anchor, i - anchor, i - match, length);
+        i += length;
+        anchor = i;
+    }
+
+    written += lz_put_sequence(output + written, input + anchor, size - anchor, 0, 0);
+
+    return written;
+}
+
+/*
+ * Funkcja odczytuje długość zapisaną przez lz_put_length.
+ */
+static bool lz_get_length(const unsigned char *input, size_t size, size_t *position, size_t *length) {
+    unsigned char byte;
+
+    do {
+        if (*position >= size) {
+            return false;
+        }
+        byte = input[(*position)++];
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/*
+ * Funkcja rozpakowuje wynik lz_compress do bufora output o rozmiarze
+ * dokładnie output_size. Zwraca false dla uszkodzonego zapisu.
+ */
+static bool lz_decompress(const unsigned char *input, size_t size, unsigned char *output, size_t output_size) {
+    size_t position = 0, written = 0;
+
+    while (position < size) {
+        unsigned char token = input[position++];
+
+        size_t nliterals = token >> 4;
+        if (nliterals == 15 && !lz_get_length(input, size, &position, &nliterals)) {
+            return false;
+        }
+
+        if (nliterals > size - position || nliterals > output_size - written) {
+            return false;
+        }
+
+        memcpy(output + written, input + position, nliterals);
+        position += nliterals;
+        written += nliterals;
+
+        if (position == size) {
+            // Ostatnia sekwencja zawiera tylko literały.
+            break;
+        }
+
+        if (size - position < 2) {
+            return false;
+        }
+
+        size_t offset = input[position] | (size_t) input[position + 1] << 8;
+        position += 2;
+
+        size_t length = token & 15;
+        if (length == 15 && !lz_get_length(input, size, &position, &length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > written || length > output_size - written) {
+            return false;
+        }
+
+        // Powtórzenie może nachodzić na kopiowane bajty.
+        for (size_t i = 0; i < length; ++i, ++written) {
+            output[written] = output[written - offset];
+        }
+    }
+
+    return written == output_size;
+}
+
+/*
+ * Funkcja zapewnia miejsce na n kolejnych bajtów magazynu.
+ * Funkcja powinna być wywoływana pod blokadą hibernacji.
+ */
+static void store_reserve(hibernation_t *hibernation, size_t n) {
+    if (hibernation->size + n <= hibernation->capacity) {
+        return;
+    }
+
+    size_t capacity = hibernation->capacity == 0 ? SCRATCH_STARTING_SIZE : hibernation->capacity;
+    while (capacity < hibernation->size + n) {
+        capacity *= 2;
+    }
+
+    if (hibernation->fd >= 0 && ftruncate(hibernation->fd, capacity) != 0)
+        syserr(errno, "ftruncate failed");
+
+    void *data;
+    if (hibernation->data != NULL) {
+        data = mremap(hibernation->data, hibernation->capacity, capacity, MREMAP_MAYMOVE);
+    }
+    else if (hibernation->fd >= 0) {
+        data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, hibernation->fd, 0);
+    }
+    else {
+        data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (data == MAP_FAILED)
+        syserr(errno, "mmap failed");
+
+    hibernation->data = data;
+    hibernation->capacity = capacity;
+}
+
+/*
+ * Funkcja zapisuje stan w wolnym bloku magazynu (lub na jego końcu).
+ * Zwraca uchwyt zapisu, 0 gdy stan jest za duży.
+ */
+static size_t store_put(hibernation_t *hibernation, const void *data, size_t size,
+                        size_t state_size, bool is_compressed) {
+    int err;
+
+    size_t total = sizeof(record_t) + size;
+    unsigned int block_class = 0;
+    while (block_class < HIBERNATE_CLASSES && ((size_t) HIBERNATE_BLOCK << block_class) < total) {
+        block_class++;
+    }
+
+    if (block_class == HIBERNATE_CLASSES) {
+        return 0;
+    }
+
+    entity_lock(hibernation);
+
+    size_t offset;
+    if (hibernation->free[block_class] != 0) {
+        offset = hibernation->free[block_class] - 1;
+
+        record_t record;
+        memcpy(&record, hibernation->data + offset, sizeof(record_t));
+        hibernation->free[block_class] = record.size;
+    }
+    else {
+        size_t block = (size_t) HIBERNATE_BLOCK << block_class;
+        store_reserve(hibernation, block);
+        offset = hibernation->size;
+        hibernation->size += block;
+    }
+
+    record_t record = {
+            .block_class = block_class,
+            .is_compressed = is_compressed,
+            .size = size,
+            .state_size = state_size
+    };
+    memcpy(hibernation->data + offset, &record, sizeof(record_t));
+    memcpy(hibernation->data + offset + sizeof(record_t), data, size);
+
+    entity_unlock(hibernation);
+
+    return offset + 1;
+}
+
+/*
+ * Funkcja zapisuje stan aktora w magazynie. Zwraca false, jeśli stanu nie da się zapisać.
+ * Funkcja powinna być wywoływana przez wątek kontrolny pod blokadą aktora.
+ */
+static bool pack(hibernation_t *hibernation, actor_t *actor) {
+    serialize_t serialize = actor->role->serialize;
+
+    size_t size = serialize(MSG_STATE, actor->data, 0, hibernation->scratch, hibernation->scratch_size);
+    if (size == SERIALIZE_SKIP) {
+        return false;
+    }
+
+    if (size > hibernation->scratch_size) {
+        hibernation->scratch_size = size;
+        realloc_and_check(hibernation->scratch, size);
+
+        size = serialize(MSG_STATE, actor->data, 0, hibernation->scratch, hibernation->scratch_size);
+        if (size == SERIALIZE_SKIP || size > hibernation->scratch_size) {
+            return false;
+        }
+    }
+
+    size_t bound = size + size / 255 + 16;
+    if (bound > hibernation->packed_size) {
+        hibernation->packed_size = bound;
+        realloc_and_check(hibernation->packed, bound);
+    }
+
+    size_t packed = lz_compress(hibernation->scratch, size, hibernation->packed);
+    bool is_compressed = packed < size;
+
+    size_t handle = is_compressed
+                    ? store_put(hibernation, hibernation->packed, packed, size, true)
+                    : store_put(hibernation, hibernation->scratch, size, size, false);
+    if (handle == 0) {
+        return false;
+    }
+
+    actor->hibernated = handle;
+    return true;
+}
+
+/*
+ * Funkcja hibernuje aktora bezczynnego od co najmniej idle milisekund.
+ */
+static void freeze(hibernation_t *hibernation, actor_t *actor, unsigned long time) {
+    int err;
+
+    entity_lock(actor);
+
+    // Czas bezczynności jest liczony najwcześniej od włączenia hibernacji.
+    unsigned long active_at = actor->active_at > hibernation->since ? actor->active_at : hibernation->since;
+
+    const role_t *role = actor->role;
+    bool is_idle = actor->is_active && actor->state == IDLING && actor->fiber == NULL
+                   && actor->hibernated == 0 && actor->data != NULL
+                   && role->serialize != NULL && role->deserialize != NULL && role->release != NULL
+                   && time - active_at >= hibernation->idle;
+
+    queue_message_t *messages_queue = &actor->msg_queue;
+
+    if (is_idle) {
+        entity_lock(messages_queue);
+        is_idle = queue_message_is_empty(messages_queue);
+        entity_unlock(messages_queue);
+    }
+
+    // Komunikat wysłany w trakcie zapisu czeka na odblokowanie aktora.
+    if (is_idle && pack(hibernation, actor)) {
+        role->release(actor->data);
+        actor->data = NULL;
+
+        entity_lock(messages_queue);
+        queue_message_trim(messages_queue);
+        entity_unlock(messages_queue);
+    }
+
+    entity_unlock(actor);
+}
+
+void hibernation_step(hibernation_t *hibernation) {
+    int err;
+
+    unsigned long time = now();
+    if (time - atomic_load_explicit(&hibernation->clock, memory_order_relaxed) < HIBERNATE_INTERVAL) {
+        return;
+    }
+    atomic_store_explicit(&hibernation->clock, time, memory_order_relaxed);
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    entity_reader_lock(actors_array);
+    actor_id_t nactors = actors_array->nactors;
+    entity_rw_unlock(actors_array);
+
+    for (actor_id_t i = 0; i < HIBERNATE_BATCH && i < nactors; ++i) {
+        hibernation->cursor = hibernation->cursor % nactors + 1;
+
+        entity_reader_lock(actors_array);
+        actor_t *actor = actors_array_get_actor(actors_array, hibernation->cursor);
+        entity_rw_unlock(actors_array);
+
+        if (actor != NULL) {
+            freeze(hibernation, actor, time);
+        }
+    }
+}
+
+/*
+ * Funkcja kopiuje zapis stanu o uchwycie handle z magazynu do nowego bufora
+ * (pod blokadą hibernacji, bo store_reserve może przenieść magazyn).
+ * Gdy is_taken, blok wraca na listę wolnych bloków swojego rozmiaru.
+ */
+static void *store_get(hibernation_t *hibernation, size_t handle, record_t *record, bool is_taken) {
+    int err;
+
+    size_t offset = handle - 1;
+
+    entity_lock(hibernation);
+
+    memcpy(record, hibernation->data + offset, sizeof(record_t));
+
+    void *stored;
+    malloc_and_check(stored, record->size + 1);
+    memcpy(stored, hibernation->data + offset + sizeof(record_t), record->size);
+
+    if (is_taken) {
+        record_t free_record = *record;
+        free_record.size = hibernation->free[record->block_class];
+        memcpy(hibernation->data + offset, &free_record, sizeof(record_t));
+        hibernation->free[record->block_class] = offset + 1;
+    }
+
+    entity_unlock(hibernation);
+
+    return stored;
+}
+
+/*
+ * Funkcja odtwarza zapis stanu aktora (record.state_size bajtów) w buforze output.
+ */
+static void unpack(const actor_t *actor, const record_t *record, const void *stored, void *output) {
+    if (!record->is_compressed) {
+        memcpy(output, stored, record->size);
+    }
+    else if (!lz_decompress(stored, record->size, output, record->state_size)) {
+        fatal("hibernated state of actor %ld is corrupted", actor->id);
+    }
+}
+
+void hibernation_wake(hibernation_t *hibernation, actor_t *actor) {
+    record_t record;
+    void *state = store_get(hibernation, actor->hibernated, &record, true);
+
+    if (record.is_compressed) {
+        // Rozpakowanie poza blokadą hibernacji nie wstrzymuje budzenia innych aktorów.
+        void *stored = state;
+        malloc_and_check(state, record.state_size + 1);
+        unpack(actor, &record, stored, state);
+        free(stored);
+    }
+
+    actor->data = actor->role->deserialize(MSG_STATE, state, record.state_size);
+    actor->hibernated = 0;
+
+    free(state);
+}
+
+size_t hibernation_read(hibernation_t *hibernation, const actor_t *actor, void *buffer, size_t size) {
+    record_t record;
+    void *stored = store_get(hibernation, actor->hibernated, &record, false);
+
+    if (record.state_size <= size) {
+        unpack(actor, &record, stored, buffer);
+    }
+
+    free(stored);
+
+    return record.state_size;
+}
+
+void hibernation_close(hibernation_t *hibernation) {
+    int err;
+
+    if (hibernation->data != NULL && munmap(hibernation->data, hibernation->capacity) != 0)
+        syserr(errno, "munmap failed");
+
+    if (hibernation->fd >= 0) {
+        close(hibernation->fd);
+        unlink(hibernation->path);
+    }
+
+    mutex_destroy(&hibernation->lock);
+    free(hibernation->path);
+    free(hibernation->scratch);
+    free(hibernation->packed);
+    free(hibernation);
+}
+
+int actor_system_hibernate(unsigned long idle, const char *path) {
+    if (current_actors_system == NULL) {
+        return -1;
+    }
+
+    int err;
+
+    entity_lock(current_actors_system);
+
+    if (atomic_load(&current_actors_system->hibernation) != NULL) {
+        entity_unlock(current_actors_system);
+        return -1;
+    }
+
+    int fd = -1;
+    if (path != NULL && (fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0) {
+        entity_unlock(current_actors_system);
+        return -2;
+    }
+
+    hibernation_t *hibernation;
+    malloc_and_check(hibernation, sizeof(hibernation_t));
+    hibernation->idle = idle;
+    hibernation->since = now();
+    atomic_init(&hibernation->clock, hibernation->since);
+    hibernation->cursor = 0;
+    hibernation->path = NULL;
+    hibernation->fd = fd;
+    hibernation->data = NULL;
+    hibernation->size = 0;
+    hibernation->capacity = 0;
+    memset(hibernation->free, 0, sizeof(hibernation->free));
+    hibernation->scratch_size = SCRATCH_STARTING_SIZE;
+    malloc_and_check(hibernation->scratch, SCRATCH_STARTING_SIZE);
+    hibernation->packed = NULL;
+    hibernation->packed_size = 0;
+    mutex_init(&hibernation->lock);
+
+    if (path != NULL) {
+        size_t length = strlen(path);
+        malloc_and_check(hibernation->path, length + 1);
+        memcpy(hibernation->path, path, length + 1);
+    }
+
+    atomic_store_explicit(&current_actors_system->hibernation, hibernation, memory_order_release);
+
+    entity_unlock(current_actors_system);
+
+    // Wątek kontrolny zaczyna okresowo przeglądać aktorów.
+    actor_system_notify(current_actors_system);
+
+    return 0;
+}
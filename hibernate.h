@@ -0,0 +1,96 @@
+#ifndef HIBERNATE_H
+#define HIBERNATE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "actor.h"
+#include "cacti.h"
+
+/*
+ * Odstęp (w milisekundach) między kolejnymi przeglądami aktorów.
+ */
+#ifndef HIBERNATE_INTERVAL
+#define HIBERNATE_INTERVAL 10
+#endif
+
+/*
+ * Liczba aktorów sprawdzanych przez wątek kontrolny w jednym przeglądzie.
+ */
+#ifndef HIBERNATE_BATCH
+#define HIBERNATE_BATCH 4096
+#endif
+
+/*
+ * Rozmiar najmniejszego bloku magazynu; bloki mają rozmiary
+ * HIBERNATE_BLOCK * 2^k dla k < HIBERNATE_CLASSES.
+ */
+#ifndef HIBERNATE_BLOCK
+#define HIBERNATE_BLOCK 64
+#endif
+
+#define HIBERNATE_CLASSES 32
+
+/*
+ * Struktura przechowująca informacje o hibernacji bezczynnych aktorów.
+ * Magazyn to obszar odwzorowany w pamięci (anonimowy lub plik path) podzielony
+ * na bloki; zwolnione bloki trafiają na listy free według rozmiaru
+ * (przesunięcie bloku + 1, 0 oznacza pustą listę). since to czas włączenia
+ * hibernacji, clock - czas ostatniego przeglądu, a cursor - id kolejnego
+ * sprawdzanego aktora (używane tylko przez wątek kontrolny, podobnie jak
+ * bufory scratch i packed).
+ */
+typedef struct hibernation {
+    unsigned long idle, since;
+    atomic_ulong clock;
+    actor_id_t cursor;
+    char *path;
+    int fd;
+    char *data;
+    size_t size, capacity;
+    size_t free[HIBERNATE_CLASSES];
+    void *scratch, *packed;
+    size_t scratch_size, packed_size;
+    pthread_mutex_t lock;
+} hibernation_t;
+
+/*
+ * Funkcja włącza hibernację aktorów działającego systemu: stan aktora bezczynnego
+ * od co najmniej idle milisekund (z pustą skrzynką), którego rola ma funkcje
+ * serialize, deserialize i release, jest zapisywany w skompresowanej postaci
+ * w magazynie (w pamięci lub, gdy path != NULL, w pliku path, usuwanym przy
+ * zakończeniu systemu), po czym jest zwalniany przez release, a bufor skrzynki
+ * aktora - zwalniany. Kolejny komunikat aktora odtwarza jego stan przez
+ * deserialize przed obsługą. Stany aktorów zahibernowanych w chwili zakończenia
+ * systemu są porzucane.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów
+ * lub ma on już włączoną hibernację, -2 gdy nie udało się utworzyć pliku path.
+ */
+int actor_system_hibernate(unsigned long idle, const char *path);
+
+/*
+ * Funkcja hibernuje kolejnych bezczynnych aktorów (wywoływana przez wątek kontrolny).
+ */
+void hibernation_step(hibernation_t *hibernation);
+
+/*
+ * Funkcja odtwarza stan zahibernowanego aktora.
+ * Funkcja powinna być wywoływana pod blokadą aktora.
+ */
+void hibernation_wake(hibernation_t *hibernation, actor_t *actor);
+
+/*
+ * Funkcja zapisuje do bufora o rozmiarze size stan zahibernowanego aktora
+ * w postaci zwróconej przez serialize, nie odtwarzając go. Zwraca rozmiar
+ * stanu; jeśli jest większy od size, bufor nie jest zapisywany.
+ * Funkcja powinna być wywoływana pod blokadą aktora.
+ */
+size_t hibernation_read(hibernation_t *hibernation, const actor_t *actor, void *buffer, size_t size);
+
+/*
+ * Funkcja zwalnia magazyn i strukturę hibernacji.
+ */
+void hibernation_close(hibernation_t *hibernation);
+
+#endif //HIBERNATE_H
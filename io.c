@@ -0,0 +1,471 @@
+#include "io.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "utils.h"
+
+#define IO_STOP 0
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nargs) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+static io_t *current_io(void) {
+    return current_actors_system == NULL ? NULL : current_actors_system->io;
+}
+
+/*
+ * Funkcja zwraca indeks zarejestrowanego bufora zawierającego adres (-1 spoza puli).
+ */
+static int buffer_index(io_t *io, const void *buffer, size_t nbytes) {
+    const char *address = buffer;
+    if (!io->is_registered || address < io->buffers
+        || address >= io->buffers + io->nbuffers * io->buffer_size) {
+        return -1;
+    }
+
+    size_t index = (address - io->buffers) / io->buffer_size;
+    if (address + nbytes > io->buffers + (index + 1) * io->buffer_size) {
+        return -1;
+    }
+
+    return (int) index;
+}
+
+/*
+ * Funkcja zwraca indeks bufora z puli zaczynającego się pod adresem buffer
+ * (-1 dla innych adresów).
+ */
+static int pool_index(io_t *io, const void *buffer) {
+    const char *address = buffer;
+    if (io->nbuffers == 0 || address < io->buffers
+        || address >= io->buffers + io->nbuffers * io->buffer_size) {
+        return -1;
+    }
+
+    size_t offset = address - io->buffers;
+    if (offset % io->buffer_size != 0) {
+        return -1;
+    }
+
+    return (int) (offset / io->buffer_size);
+}
+
+/*
+ * Funkcja zwraca bufor do puli. Zwraca false, jeśli bufor nie pochodzi z puli
+ * lub już w niej jest.
+ */
+static bool put_buffer(io_t *io, void *buffer) {
+    int err;
+
+    int index = pool_index(io, buffer);
+    if (index < 0) {
+        return false;
+    }
+
+    entity_lock(io);
+    bool is_free = io->is_free_buffer[index];
+    if (!is_free) {
+        io->is_free_buffer[index] = true;
+        io->free_buffers[io->nfree_buffers++] = buffer;
+    }
+    entity_unlock(io);
+
+    return !is_free;
+}
+
+static void release_result(io_t *io, io_result_t *result) {
+    int err;
+
+    entity_lock(io);
+    result->next = io->free_results;
+    io->free_results = result;
+    entity_unlock(io);
+}
+
+/*
+ * Funkcja zwalnia wynik, którego aktor nie przyjmie: przyjęte połączenie
+ * jest zamykane, a bufor z puli do niej wraca.
+ */
+static void discard_result(io_t *io, io_result_t *result) {
+    if (result->is_accept && result->result >= 0) {
+        close(result->result);
+    }
+
+    put_buffer(io, result->buffer);
+    release_result(io, result);
+}
+
+/*
+ * Funkcja umieszcza operację w pierścieniu zgłoszeń i przekazuje ją jądru.
+ * Funkcja powinna być wywoływana pod blokadą io.
+ */
+static void submit(io_t *io, const struct io_uring_sqe *sqe) {
+    unsigned int tail = *io->sq_tail;
+    unsigned int index = tail & *io->sq_mask;
+
+    io->sqes[index] = *sqe;
+    io->sq_array[index] = index;
+    __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (io_uring_enter(io->ring_fd, 1, 0, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            syserr(errno, "io_uring_enter failed");
+    }
+}
+
+/*
+ * Funkcja zleca operację opisaną przez sqe w imieniu bieżącego aktora.
+ */
+static int io_submit(struct io_uring_sqe *sqe, int fd, void *buffer, size_t nbytes, message_type_t reply) {
+    int err;
+
+    io_t *io = current_io();
+    if (io == NULL) {
+        return -1;
+    }
+
+    entity_lock(io);
+    io_result_t *result = io->free_results;
+    if (result == NULL) {
+        // Wszystkie pozycje pierścienia zakończeń są zarezerwowane.
+        entity_unlock(io);
+        return -3;
+    }
+    io->free_results = result->next;
+
+    result->result = 0;
+    result->fd = fd;
+    result->buffer = buffer;
+    result->nbytes = nbytes;
+    result->actor = actor_id_self();
+    result->reply = reply;
+    result->is_accept = sqe->opcode == IORING_OP_ACCEPT;
+
+    sqe->fd = fd;
+    sqe->user_data = (uint64_t) (uintptr_t) result;
+    submit(io, sqe);
+    entity_unlock(io);
+
+    return 0;
+}
+
+static int io_transfer(int fd, void *buffer, size_t nbytes, off_t offset, message_type_t reply,
+                       uint8_t opcode, uint8_t fixed_opcode) {
+    io_t *io = current_io();
+    if (io == NULL) {
+        return -1;
+    }
+
+    int index = buffer_index(io, buffer, nbytes);
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = index >= 0 ? fixed_opcode : opcode;
+    sqe.addr = (uint64_t) (uintptr_t) buffer;
+    sqe.len = (uint32_t) nbytes;
+    sqe.off = (uint64_t) offset;
+    if (index >= 0) {
+        sqe.buf_index = (uint16_t) index;
+    }
+
+    return io_submit(&sqe, fd, buffer, nbytes, reply);
+}
+
+/*
+ * Funkcja wątku odbierającego zakończone operacje i przesyłającego
+ * ich wyniki aktorom jako komunikaty.
+ */
+static void *io_func(void *data) {
+    io_t *io = data;
+    io_result_t **last = &io->pending;
+    bool is_stopping = false;
+    struct timespec retry = {.tv_sec = 0, .tv_nsec = IO_RETRY_INTERVAL * 1000000L};
+
+    while (!is_stopping) {
+        // Gdy wyniki czekają na miejsce w skrzynce, wątek nie czeka na zakończenia.
+        unsigned int min_complete = io->pending == NULL ? 1 : 0;
+        if (io_uring_enter(io->ring_fd, 0, min_complete, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            syserr(errno, "io_uring_enter failed");
+
+        unsigned int head = *io->cq_head;
+        unsigned int tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+            io_result_t *result = (io_result_t *) (uintptr_t) cqe->user_data;
+
+            if (result == IO_STOP) {
+                is_stopping = true;
+                continue;
+            }
+
+            result->result = cqe->res;
+            result->next = NULL;
+            *last = result;
+            last = &result->next;
+        }
+
+        __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+
+        // Wyniki są przesyłane w kolejności zakończenia operacji.
+        while (io->pending != NULL) {
+            io_result_t *result = io->pending;
+
+            // Po przesłaniu wynik należy do aktora, który może go już zwolnić.
+            io_result_t *next = result->next;
+            int sent = send_message(result->actor, (message_t) {
+                    result->reply, sizeof(io_result_t), result
+            });
+            if (sent == -3) {
+                // Skrzynka adresata jest pełna - kolejne wyniki czekają na swoją kolej.
+                break;
+            }
+
+            io->pending = next;
+            if (sent != 0) {
+                // Aktor nie przyjmuje już komunikatów.
+                discard_result(io, result);
+            }
+        }
+
+        if (io->pending == NULL) {
+            last = &io->pending;
+        } else if (!is_stopping) {
+            nanosleep(&retry, NULL);
+        }
+    }
+
+    // Wyniki niedostarczone przed zamknięciem są porzucane.
+    while (io->pending != NULL) {
+        io_result_t *result = io->pending;
+        io->pending = result->next;
+        discard_result(io, result);
+    }
+
+    return 0;
+}
+
+int io_open(unsigned int entries, unsigned int nbuffers, size_t buffer_size) {
+    if (current_actors_system == NULL || current_actors_system->io != NULL) {
+        return -1;
+    }
+
+#ifdef SINGLE_THREADED
+    // Wątek odbierający wymaga blokad pomijanych w trybie jednowątkowym.
+    return -3;
+#endif
+
+    int err;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd < 0) {
+        return -2;
+    }
+
+    io_t *io;
+    malloc_and_check(io, sizeof(io_t));
+    memset(io, 0, sizeof(io_t));
+
+    io->ring_fd = ring_fd;
+    io->sq_entries = params.sq_entries;
+    io->cq_entries = params.cq_entries;
+    io->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    io->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (io->cq_ring_size > io->sq_ring_size) {
+            io->sq_ring_size = io->cq_ring_size;
+        }
+        io->cq_ring_size = io->sq_ring_size;
+    }
+
+    io->sq_ring = mmap(NULL, io->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd, IORING_OFF_SQ_RING);
+    if (io->sq_ring == MAP_FAILED)
+        syserr(errno, "mmap failed");
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        io->cq_ring = io->sq_ring;
+    } else {
+        io->cq_ring = mmap(NULL, io->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring_fd, IORING_OFF_CQ_RING);
+        if (io->cq_ring == MAP_FAILED)
+            syserr(errno, "mmap failed");
+    }
+
+    io->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED)
+        syserr(errno, "mmap failed");
+
+    char *sq = io->sq_ring;
+    io->sq_head = (unsigned int *) (sq + params.sq_off.head);
+    io->sq_tail = (unsigned int *) (sq + params.sq_off.tail);
+    io->sq_mask = (unsigned int *) (sq + params.sq_off.ring_mask);
+    io->sq_array = (unsigned int *) (sq + params.sq_off.array);
+
+    char *cq = io->cq_ring;
+    io->cq_head = (unsigned int *) (cq + params.cq_off.head);
+    io->cq_tail = (unsigned int *) (cq + params.cq_off.tail);
+    io->cq_mask = (unsigned int *) (cq + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    // Pula wyników ma tyle pozycji, ile pierścień zakończeń (bez przepełnień).
+    malloc_and_check(io->results, io->cq_entries * sizeof(io_result_t));
+    io->free_results = NULL;
+    io->pending = NULL;
+    for (unsigned int i = 0; i < io->cq_entries - 1; ++i) {
+        io->results[i].next = io->free_results;
+        io->free_results = io->results + i;
+    }
+
+    if (nbuffers > 0) {
+        io->buffers = mmap(NULL, nbuffers * buffer_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (io->buffers == MAP_FAILED)
+            syserr(errno, "mmap failed");
+
+        struct iovec iovecs[nbuffers];
+        malloc_and_check(io->free_buffers, nbuffers * sizeof(void *));
+        malloc_and_check(io->is_free_buffer, nbuffers * sizeof(bool));
+        for (unsigned int i = 0; i < nbuffers; ++i) {
+            iovecs[i].iov_base = io->buffers + i * buffer_size;
+            iovecs[i].iov_len = buffer_size;
+            io->free_buffers[i] = iovecs[i].iov_base;
+            io->is_free_buffer[i] = true;
+        }
+
+        io->nbuffers = nbuffers;
+        io->nfree_buffers = nbuffers;
+        io->buffer_size = buffer_size;
+
+        // Bez rejestracji bufory pozostają zwykłą pamięcią.
+        io->is_registered = io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovecs, nbuffers) == 0;
+    }
+
+    mutex_init(&io->lock);
+
+    check_if_error(pthread_create(&io->thread, NULL, io_func, io), "pthread create failed");
+
+    entity_lock(current_actors_system);
+    current_actors_system->io = io;
+    entity_unlock(current_actors_system);
+
+    return 0;
+}
+
+void *io_buffer_get(void) {
+    int err;
+
+    io_t *io = current_io();
+    if (io == NULL) {
+        return NULL;
+    }
+
+    void *buffer = NULL;
+
+    entity_lock(io);
+    if (io->nfree_buffers > 0) {
+        buffer = io->free_buffers[--io->nfree_buffers];
+        io->is_free_buffer[pool_index(io, buffer)] = false;
+    }
+    entity_unlock(io);
+
+    return buffer;
+}
+
+int io_buffer_put(void *buffer) {
+    io_t *io = current_io();
+    if (io == NULL) {
+        return -1;
+    }
+
+    return put_buffer(io, buffer) ? 0 : -2;
+}
+
+int io_read(int fd, void *buffer, size_t nbytes, off_t offset, message_type_t reply) {
+    return io_transfer(fd, buffer, nbytes, offset, reply, IORING_OP_READ, IORING_OP_READ_FIXED);
+}
+
+int io_write(int fd, void *buffer, size_t nbytes, off_t offset, message_type_t reply) {
+    return io_transfer(fd, buffer, nbytes, offset, reply, IORING_OP_WRITE, IORING_OP_WRITE_FIXED);
+}
+
+int io_accept(int fd, message_type_t reply) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_ACCEPT;
+
+    return io_submit(&sqe, fd, NULL, 0, reply);
+}
+
+int io_fsync(int fd, message_type_t reply) {
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_FSYNC;
+
+    return io_submit(&sqe, fd, NULL, 0, reply);
+}
+
+void io_release(io_result_t *result) {
+    io_t *io = current_io();
+    if (io == NULL || result == NULL) {
+        return;
+    }
+
+    release_result(io, result);
+}
+
+void io_close(io_t *io) {
+    int err;
+    void *retval;
+
+    // Operacja pusta z IO_STOP budzi i kończy wątek odbierający.
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_NOP;
+    sqe.user_data = IO_STOP;
+
+    entity_lock(io);
+    submit(io, &sqe);
+    entity_unlock(io);
+
+    thread_join(io->thread);
+
+    munmap(io->sqes, io->sq_entries * sizeof(struct io_uring_sqe));
+    if (io->cq_ring != io->sq_ring) {
+        munmap(io->cq_ring, io->cq_ring_size);
+    }
+    munmap(io->sq_ring, io->sq_ring_size);
+    close(io->ring_fd);
+
+    if (io->buffers != NULL) {
+        munmap(io->buffers, io->nbuffers * io->buffer_size);
+    }
+
+    mutex_destroy(&io->lock);
+    free(io->free_buffers);
+    free(io->is_free_buffer);
+    free(io->results);
+    free(io);
+}
@@ -0,0 +1,114 @@
+#ifndef IO_H
+#define IO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "cacti.h"
+
+/*
+ * Czas (w ms), po którym wątek odbierający ponawia przesłanie wyników,
+ * gdy skrzynka adresata była pełna.
+ */
+#ifndef IO_RETRY_INTERVAL
+#define IO_RETRY_INTERVAL 1
+#endif
+
+/*
+ * Wynik asynchronicznej operacji wejścia-wyjścia, przesyłany jako dane
+ * komunikatu do aktora, który ją zlecił. Po obsłużeniu należy go zwolnić
+ * funkcją io_release.
+ */
+typedef struct io_result {
+    int result;             // cqe->res: liczba bajtów, deskryptor lub -errno
+    int fd;
+    void *buffer;
+    size_t nbytes;
+    actor_id_t actor;
+    message_type_t reply;
+    bool is_accept;
+    struct io_result *next;
+} io_result_t;
+
+/*
+ * Struktura przechowująca pierścienie io_uring, pulę zarejestrowanych buforów
+ * (is_free_buffer[i] oznacza, że i-ty bufor jest w puli), pulę wyników operacji
+ * oraz wyniki czekające na miejsce w skrzynce adresata (pending, używane tylko
+ * przez wątek odbierający).
+ */
+typedef struct io {
+    int ring_fd;
+    unsigned int sq_entries, cq_entries;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    char *buffers;
+    unsigned int nbuffers;
+    size_t buffer_size;
+    bool is_registered;
+    void **free_buffers;
+    bool *is_free_buffer;
+    unsigned int nfree_buffers;
+    io_result_t *results;
+    io_result_t *free_results;
+    io_result_t *pending;
+    pthread_t thread;
+    pthread_mutex_t lock;
+} io_t;
+
+/*
+ * Funkcja tworzy instancję io_uring o entries pozycjach dla działającego
+ * systemu aktorów, rejestruje nbuffers buforów o rozmiarze buffer_size
+ * i uruchamia wątek odbierający zakończone operacje.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów
+ * lub ma już instancję io_uring, -2 gdy jądro jej nie udostępnia, -3 w trybie
+ * jednowątkowym (SINGLE_THREADED).
+ */
+int io_open(unsigned int entries, unsigned int nbuffers, size_t buffer_size);
+
+/*
+ * Funkcja pobiera zarejestrowany bufor z puli (NULL gdy pula jest pusta).
+ * Operacje na takich buforach nie wymagają mapowania stron przez jądro.
+ */
+void *io_buffer_get(void);
+
+/*
+ * Funkcja zwraca bufor do puli.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie ma instancji io_uring, -2 gdy
+ * buffer nie pochodzi z puli lub został już do niej zwrócony.
+ */
+int io_buffer_put(void *buffer);
+
+/*
+ * Funkcje zlecają operację w imieniu aktora actor_id_self(). Po jej
+ * zakończeniu aktor otrzymuje komunikat typu reply z danymi io_result_t
+ * (przy pełnej skrzynce - z opóźnieniem; gdy aktor nie przyjmuje już
+ * komunikatów, przyjęte połączenie jest zamykane, a bufor z puli do niej wraca).
+ * Zwracają 0 w przypadku powodzenia, -1 gdy nie ma instancji io_uring,
+ * -3 gdy wszystkie pozycje pierścienia są zajęte.
+ */
+int io_read(int fd, void *buffer, size_t nbytes, off_t offset, message_type_t reply);
+
+int io_write(int fd, void *buffer, size_t nbytes, off_t offset, message_type_t reply);
+
+int io_accept(int fd, message_type_t reply);
+
+int io_fsync(int fd, message_type_t reply);
+
+/*
+ * Funkcja zwalnia wynik operacji.
+ */
+void io_release(io_result_t *result);
+
+/*
+ * Funkcja zatrzymuje wątek odbierający i zamyka instancję io_uring.
+ * Niezakończone operacje są anulowane przez jądro.
+ */
+void io_close(io_t *io);
+
+#endif //IO_H
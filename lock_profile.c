@@ -0,0 +1,227 @@
+#include "lock_profile.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "err.h"
+
+/*
+ * Lista miejsc zajmowania blokad, które zostały użyte.
+ */
+static _Atomic(lock_site_t *) sites = NULL;
+
+/*
+ * Blokada trzymana przez wątek wraz z miejscem i chwilą jej zajęcia.
+ */
+typedef struct held_lock {
+    const void *lock;
+    lock_site_t *site;
+    uint64_t acquired;
+} held_lock_t;
+
+static _Thread_local held_lock_t held[LOCK_PROFILE_DEPTH];
+static _Thread_local unsigned int nheld = 0;
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void update_max(atomic_ullong *max, unsigned long long value) {
+    unsigned long long current = atomic_load_explicit(max, memory_order_relaxed);
+    while (current < value &&
+           !atomic_compare_exchange_weak_explicit(max, &current, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static void register_site(lock_site_t *site) {
+    if (atomic_flag_test_and_set(&site->is_registered)) {
+        return;
+    }
+
+    lock_site_t *head = atomic_load(&sites);
+    do {
+        site->next = head;
+    } while (!atomic_compare_exchange_weak(&sites, &head, site));
+}
+
+/*
+ * Funkcja zapisuje statystyki zajęcia blokady, której zajmowanie rozpoczęto
+ * w chwili start (is_contended - blokady nie udało się zająć bez czekania).
+ */
+static void acquired(lock_site_t *site, const void *lock, uint64_t start, bool is_contended) {
+    uint64_t time = now();
+
+    register_site(site);
+    atomic_fetch_add_explicit(&site->acquisitions, 1, memory_order_relaxed);
+
+    if (is_contended) {
+        atomic_fetch_add_explicit(&site->contended, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->wait_total, time - start, memory_order_relaxed);
+        update_max(&site->wait_max, time - start);
+    }
+
+    if (nheld < LOCK_PROFILE_DEPTH) {
+        held[nheld++] = (held_lock_t) {lock, site, time};
+    }
+}
+
+static void released(const void *lock) {
+    // Blokady są zwykle zwalniane w odwrotnej kolejności, więc szukamy od końca.
+    for (unsigned int i = nheld; i-- > 0;) {
+        if (held[i].lock != lock) {
+            continue;
+        }
+
+        uint64_t hold = now() - held[i].acquired;
+        atomic_fetch_add_explicit(&held[i].site->hold_total, hold, memory_order_relaxed);
+        update_max(&held[i].site->hold_max, hold);
+
+        held[i] = held[--nheld];
+        return;
+    }
+}
+
+void lock_profile_mutex_lock(lock_site_t *site, pthread_mutex_t *lock) {
+    int err;
+    uint64_t start = now();
+    bool is_contended = false;
+
+    if ((err = pthread_mutex_trylock(lock)) == EBUSY) {
+        is_contended = true;
+        err = pthread_mutex_lock(lock);
+    }
+
+    if (err != 0)
+        syserr(err, "mutex lock failed");
+
+    acquired(site, lock, start, is_contended);
+}
+
+void lock_profile_rdlock(lock_site_t *site, pthread_rwlock_t *lock) {
+    int err;
+    uint64_t start = now();
+    bool is_contended = false;
+
+    if ((err = pthread_rwlock_tryrdlock(lock)) == EBUSY) {
+        is_contended = true;
+        err = pthread_rwlock_rdlock(lock);
+    }
+
+    if (err != 0)
+        syserr(err, "rwlock rdlock failed");
+
+    acquired(site, lock, start, is_contended);
+}
+
+void lock_profile_wrlock(lock_site_t *site, pthread_rwlock_t *lock) {
+    int err;
+    uint64_t start = now();
+    bool is_contended = false;
+
+    if ((err = pthread_rwlock_trywrlock(lock)) == EBUSY) {
+        is_contended = true;
+        err = pthread_rwlock_wrlock(lock);
+    }
+
+    if (err != 0)
+        syserr(err, "rwlock wrlock failed");
+
+    acquired(site, lock, start, is_contended);
+}
+
+void lock_profile_mutex_unlock(pthread_mutex_t *lock) {
+    int err;
+
+    released(lock);
+
+    if ((err = pthread_mutex_unlock(lock)) != 0)
+        syserr(err, "mutex unlock failed");
+}
+
+void lock_profile_rw_unlock(pthread_rwlock_t *lock) {
+    int err;
+
+    released(lock);
+
+    if ((err = pthread_rwlock_unlock(lock)) != 0)
+        syserr(err, "rwlock unlock failed");
+}
+
+void lock_profile_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock) {
+    int err;
+
+    held_lock_t *entry = NULL;
+    for (unsigned int i = nheld; i-- > 0;) {
+        if (held[i].lock == lock) {
+            entry = &held[i];
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        uint64_t hold = now() - entry->acquired;
+        atomic_fetch_add_explicit(&entry->site->hold_total, hold, memory_order_relaxed);
+        update_max(&entry->site->hold_max, hold);
+    }
+
+    if ((err = pthread_cond_wait(cond, lock)) != 0)
+        syserr(err, "cond wait failed");
+
+    if (entry != NULL) {
+        entry->acquired = now();
+    }
+}
+
+static int compare_sites(const void *a, const void *b) {
+    unsigned long long wait_a = atomic_load(&(*(lock_site_t *const *) a)->wait_total);
+    unsigned long long wait_b = atomic_load(&(*(lock_site_t *const *) b)->wait_total);
+    return wait_a < wait_b ? 1 : wait_a > wait_b ? -1 : 0;
+}
+
+void lock_profile_report(FILE *file) {
+    size_t nsites = 0;
+    for (lock_site_t *site = atomic_load(&sites); site != NULL; site = site->next) {
+        ++nsites;
+    }
+
+    if (nsites == 0) {
+        return;
+    }
+
+    lock_site_t **sorted = malloc(nsites * sizeof(lock_site_t *));
+    if (sorted == NULL) {
+        syserr(-1, "malloc failed");
+    }
+
+    size_t i = 0;
+    for (lock_site_t *site = atomic_load(&sites); site != NULL; site = site->next) {
+        sorted[i++] = site;
+    }
+    qsort(sorted, nsites, sizeof(lock_site_t *), compare_sites);
+
+    fprintf(file, "%-36s %-28s %-6s %12s %12s %14s %12s %14s %12s\n",
+            "lock", "site", "kind", "acquired", "contended",
+            "wait us", "max wait us", "hold us", "max hold us");
+
+    for (i = 0; i < nsites; ++i) {
+        lock_site_t *site = sorted[i];
+        char location[256];
+        snprintf(location, sizeof(location), "%s:%d", site->file, site->line);
+
+        fprintf(file, "%-36s %-28s %-6s %12lu %12lu %14.1f %12.1f %14.1f %12.1f\n",
+                site->name, location, site->kind,
+                atomic_exchange(&site->acquisitions, 0),
+                atomic_exchange(&site->contended, 0),
+                atomic_exchange(&site->wait_total, 0) / 1000.0,
+                atomic_exchange(&site->wait_max, 0) / 1000.0,
+                atomic_exchange(&site->hold_total, 0) / 1000.0,
+                atomic_exchange(&site->hold_max, 0) / 1000.0);
+    }
+
+    free(sorted);
+}
@@ -0,0 +1,64 @@
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/*
+ * Maksymalna liczba blokad jednocześnie trzymanych przez wątek, dla których
+ * mierzony jest czas trzymania.
+ */
+#ifndef LOCK_PROFILE_DEPTH
+#define LOCK_PROFILE_DEPTH 16
+#endif
+
+/*
+ * Statystyki jednego miejsca zajmowania blokady (wywołania makra entity_*).
+ * Czasy są w nanosekundach.
+ */
+typedef struct lock_site {
+    const char *name;
+    const char *kind;
+    const char *file;
+    int line;
+    atomic_ulong acquisitions;
+    atomic_ulong contended;
+    atomic_ullong wait_total, wait_max;
+    atomic_ullong hold_total, hold_max;
+    atomic_flag is_registered;
+    struct lock_site *next;
+} lock_site_t;
+
+#define LOCK_SITE_INIT(name, kind) \
+    {name, kind, __FILE__, __LINE__, 0, 0, 0, 0, 0, 0, ATOMIC_FLAG_INIT, NULL}
+
+/*
+ * Funkcje zajmują blokadę, zliczając nieudane próby bez czekania oraz czas oczekiwania.
+ */
+void lock_profile_mutex_lock(lock_site_t *site, pthread_mutex_t *lock);
+
+void lock_profile_rdlock(lock_site_t *site, pthread_rwlock_t *lock);
+
+void lock_profile_wrlock(lock_site_t *site, pthread_rwlock_t *lock);
+
+/*
+ * Funkcje zwalniają blokadę i doliczają czas trzymania do miejsca jej zajęcia.
+ */
+void lock_profile_mutex_unlock(pthread_mutex_t *lock);
+
+void lock_profile_rw_unlock(pthread_rwlock_t *lock);
+
+/*
+ * Funkcja czeka na zmiennej warunkowej; czas oczekiwania nie jest wliczany
+ * do czasu trzymania blokady.
+ */
+void lock_profile_cond_wait(pthread_cond_t *cond, pthread_mutex_t *lock);
+
+/*
+ * Funkcja wypisuje statystyki miejsc zajmowania blokad (posortowane według
+ * łącznego czasu oczekiwania) i je zeruje.
+ */
+void lock_profile_report(FILE *file);
+
+#endif //LOCK_PROFILE_H
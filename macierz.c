@@ -1,20 +1,44 @@
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "cacti.h"
 #include "err.h"
+#include "pool.h"
 #include "utils.h"
 
 #define MILI_TO_MICRO 1000
 
 /*
  * Interakcja między aktorami:
- * Aktorzy tworzą się rekurencyjnie, tzn. pierwszy tworzy drugiego, drugi trzeciego, itd.
- * Po utworzeniu wszystkich aktorów, ostatni aktor wysyła do pierwszego MSG_START_COUNTING.
- * Pierwszy aktor wysyła do siebie n wiadomości MSG_COUNT odpowiadających wierszom.
+ * Pierwszy aktor (kolumna 0) tworzy aktorów pozostałych kolumn jednym wywołaniem spawn_many,
+ * więc mają oni kolejne id. Każdemu z nich wysyła numer kolumny (MSG_SETUP_COLUMN),
+ * a następnie wysyła do siebie n wiadomości MSG_COUNT odpowiadających wierszom.
  * Aktor po obliczeniu elementu wysyła MSG_COUNT kolejnemu aktorowi.
  * Po wykonaniu n obliczeń, aktor wysyła do siebie MSG_GODIE.
+ *
+ * Wczytywanie danych tekstowych:
+ * Pierwszy aktor po otrzymaniu MSG_LOAD dzieli dane na fragmenty na granicach linijek
+ * i tworzy dla każdego fragmentu aktora parsującego, który zgłasza się przez MSG_PARSER_READY.
+ * Parsery liczą linijki swoich fragmentów (MSG_COUNT_LINES), po czym pierwszy aktor
+ * wyznacza numer pierwszej linijki każdego fragmentu i zleca parsowanie (MSG_PARSE).
+ * Parser wpisuje komórki bezpośrednio do kolumn macierzy i wysyła MSG_PARSED.
+ * Po sparsowaniu wszystkich fragmentów pierwszy aktor rozpoczyna obliczenia.
+ *
+ * Tryb blokowy:
+ * Z opcją -b komunikat MSG_COUNT_BLOCK niesie blok kolejnych wierszy wraz z wektorem
+ * ich sum częściowych. Aktor kolumny dodaje do niego swój fragment kolumny (czekając
+ * łączny czas komórek bloku) i przekazuje cały blok dalej.
+ *
+ * Użycie: macierz [-o plik_binarny] [-b wiersze_bloku] [plik_wejściowy]
+ * Wejście (plik lub standardowe wejście) może być tekstowe lub binarne. Z opcją -o
+ * wczytana macierz jest dodatkowo zapisywana w formacie binarnym, który przy kolejnych
+ * uruchomieniach jest odwzorowywany w pamięć bez parsowania.
  */
 
 typedef long sum_t;
@@ -28,162 +52,204 @@ typedef struct element {
 } element_t;
 
 #define MSG_FIRST_ACTOR (message_type_t) 0x1
-#define MSG_READY (message_type_t) 0x2
-#define MSG_SPAWN_ACTORS (message_type_t) 0x3
-#define MSG_START_COUNTING (message_type_t) 0x4
-#define MSG_COUNT (message_type_t) 0x5
+#define MSG_SETUP_COLUMN (message_type_t) 0x2
+#define MSG_START_COUNTING (message_type_t) 0x3
+#define MSG_COUNT (message_type_t) 0x4
+#define MSG_LOAD (message_type_t) 0x5
+#define MSG_PARSER_READY (message_type_t) 0x6
+#define MSG_LINES_COUNTED (message_type_t) 0x7
+#define MSG_PARSED (message_type_t) 0x8
+#define MSG_COUNT_BLOCK (message_type_t) 0x9
+
+#define MSG_COUNT_LINES (message_type_t) 0x1
+#define MSG_PARSE (message_type_t) 0x2
+
+#define BINARY_MAGIC 0x3158544D49544341 // "ACTIMTX1"
+
+/*
+ * Minimalny rozmiar fragmentu danych tekstowych i maksymalna liczba fragmentów.
+ */
+#define CHUNK_SIZE (1 << 20)
+#define MAX_CHUNKS (4 * POOL_SIZE)
 
 typedef struct matrix_info {
     element_t **matrix;
     sum_t *output;
     num_t n, k;
+    num_t block_size;
 } matrix_info_t;
 
+typedef struct chunk {
+    const char *begin, *end;
+    num_t first_line;
+    num_t lines;
+    actor_id_t parser;
+    actor_id_t loader;
+    matrix_info_t *matrix_info;
+} chunk_t;
+
+typedef struct load_info {
+    matrix_info_t *matrix_info;
+    const char *begin, *end;
+    chunk_t *chunks;
+    num_t nchunks;
+    num_t assigned;
+    num_t remaining;
+} load_info_t;
+
+typedef struct binary_header {
+    uint64_t magic;
+    int32_t n, k;
+} binary_header_t;
+
 typedef struct actor_state {
     element_t *column_elements;
     num_t column;
     num_t remaining_elements;
     num_t remaining_actors;
     actor_id_t next_actor;
-    actor_id_t first;
     matrix_info_t *matrix_info;
+    load_info_t *load_info;
 } actor_state_t;
 
-typedef struct msg_spawn_actors {
-    matrix_info_t *matrix_info;
-    num_t column;
-    num_t remaining;
-    actor_id_t first;
-    num_t n;
-} msg_spawn_actors_t;
-
 typedef struct msg_count {
     num_t row;
     num_t sum;
     sum_t *output;
 } msg_count_t;
 
+typedef struct msg_count_block {
+    num_t first_row;
+    num_t rows;
+    sum_t sums[];
+} msg_count_block_t;
+
 void hello(actor_state_t **stateptr, size_t nbytes, void *data);
 
 void first_actor(actor_state_t **stateptr, size_t nbytes, matrix_info_t *matrix_info);
 
-void ready(actor_state_t **stateptr, size_t nbytes, void *data);
-
-void spawn_actors(actor_state_t **stateptr, size_t nbytes, msg_spawn_actors_t *data);
+void setup_column(actor_state_t **stateptr, size_t nbytes, void *data);
 
 void start_counting(actor_state_t **stateptr, size_t nbytes, void *data);
 
 void count(actor_state_t **stateptr, size_t nbytes, msg_count_t *data);
 
+void count_block(actor_state_t **stateptr, size_t nbytes, msg_count_block_t *data);
+
+void load(actor_state_t **stateptr, size_t nbytes, load_info_t *data);
+
+void parser_ready(actor_state_t **stateptr, size_t nbytes, void *data);
+
+void lines_counted(actor_state_t **stateptr, size_t nbytes, chunk_t *data);
+
+void parsed(actor_state_t **stateptr, size_t nbytes, chunk_t *data);
+
+void parser_hello(chunk_t **stateptr, size_t nbytes, void *data);
+
+void count_lines(chunk_t **stateptr, size_t nbytes, chunk_t *data);
+
+void parse(chunk_t **stateptr, size_t nbytes, chunk_t *data);
+
 role_t role = {
-        .nprompts = 6,
-        .prompts = (act_t[6]) {
+        .nprompts = 10,
+        .prompts = (act_t[10]) {
                 (act_t) hello,
                 (act_t) first_actor,
-                (act_t) ready,
-                (act_t) spawn_actors,
+                (act_t) setup_column,
                 (act_t) start_counting,
-                (act_t) count
+                (act_t) count,
+                (act_t) load,
+                (act_t) parser_ready,
+                (act_t) lines_counted,
+                (act_t) parsed,
+                (act_t) count_block
         }
 };
 
-message_t msg_spawn = {MSG_SPAWN, sizeof(role_t), &role};
-message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
-
-void hello(UNUSED actor_state_t **stateptr, UNUSED size_t nbytes, void *data) {
-    actor_id_t actor_id = (actor_id_t) data;
-
-    if (actor_id == -1) {
-        return;
-    }
+role_t parser_role = {
+        .nprompts = 3,
+        .prompts = (act_t[3]) {
+                (act_t) parser_hello,
+                (act_t) count_lines,
+                (act_t) parse
+        }
+};
 
-    message_t message = {
-            MSG_READY, sizeof(actor_id_t), (void *) actor_id_self()
-    };
+message_t msg_spawn_parser = {MSG_SPAWN, sizeof(role_t), &parser_role};
+message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
 
-    send_message(actor_id, message);
+void hello(UNUSED actor_state_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    // Aktorzy kolumn czekają na MSG_SETUP_COLUMN.
 }
 
-void first_actor(actor_state_t **stateptr, UNUSED size_t nbytes, matrix_info_t *matrix_info) {
-    malloc_and_check(*stateptr, sizeof(actor_state_t));
-    actor_state_t *state = *stateptr;
+/*
+ * Funkcja inicjuje stan aktora kolumny column.
+ */
+static void init_column(actor_state_t *state, matrix_info_t *matrix_info, num_t column) {
     state->matrix_info = matrix_info;
-
-    actor_id_t actor_id = actor_id_self();
-    msg_spawn_actors_t *msg_spawn_actors;
-    malloc_and_check(msg_spawn_actors, sizeof(msg_spawn_actors_t));
-    msg_spawn_actors->matrix_info = matrix_info;
-    msg_spawn_actors->column = 0;
-    msg_spawn_actors->remaining = matrix_info->k - 1;
-    msg_spawn_actors->first = actor_id;
-    msg_spawn_actors->n = matrix_info->n;
-
-    send_message(actor_id, (message_t) {
-            MSG_SPAWN_ACTORS,
-            sizeof(msg_spawn_actors_t),
-            msg_spawn_actors
-    });
+    state->column_elements = matrix_info->matrix[column];
+    state->column = column;
+    state->remaining_actors = matrix_info->k - 1 - column;
+    state->remaining_elements = matrix_info->n;
+    state->next_actor = actor_id_self() + 1;
 }
 
-void ready(actor_state_t **stateptr, UNUSED size_t nbytes, void *data) {
-    actor_id_t actor_id = (actor_id_t) data;
-
+void first_actor(actor_state_t **stateptr, UNUSED size_t nbytes, matrix_info_t *matrix_info) {
+    if (*stateptr == NULL) {
+        *stateptr = actor_arena_alloc(sizeof(actor_state_t));
+    }
     actor_state_t *state = *stateptr;
-    state->next_actor = actor_id;
+    init_column(state, matrix_info, 0);
 
-    if (state->remaining_actors == 0) {
-        send_message(state->first, (message_t) {
-                MSG_START_COUNTING, sizeof(NULL), NULL
-        });
-        return;
-    }
+    if (matrix_info->k > 1) {
+        // Stanem początkowym aktorów kolumn jest matrix_info.
+        actor_id_t first_column = spawn_many(&role, matrix_info->k - 1, matrix_info);
+        if (first_column < 0) {
+            syserr((int) first_column, "spawn many failed");
+        }
+        state->next_actor = first_column;
 
-    msg_spawn_actors_t *msg_spawn_actors;
-    malloc_and_check(msg_spawn_actors, sizeof(msg_spawn_actors_t));
-    msg_spawn_actors->matrix_info = state->matrix_info;
-    msg_spawn_actors->column = state->column + 1;
-    msg_spawn_actors->remaining = state->remaining_actors - 1;
-    msg_spawn_actors->first = state->first;
-    msg_spawn_actors->n = state->remaining_elements;
+        for (num_t column = 1; column < matrix_info->k; ++column) {
+            send_message(first_column + column - 1, (message_t) {
+                    MSG_SETUP_COLUMN, sizeof(num_t), (void *) (intptr_t) column
+            });
+        }
+    }
 
-    send_message(actor_id, (message_t) {
-            MSG_SPAWN_ACTORS,
-            sizeof(msg_spawn_actors_t),
-            msg_spawn_actors
+    send_message(actor_id_self(), (message_t) {
+            MSG_START_COUNTING, sizeof(NULL), NULL
     });
 }
 
-void spawn_actors(actor_state_t **stateptr, UNUSED size_t nbytes, msg_spawn_actors_t *data) {
-    if (*stateptr == NULL) {
-        malloc_and_check(*stateptr, sizeof(actor_state_t));
-    }
-
-    actor_state_t *state = *stateptr;
+void setup_column(actor_state_t **stateptr, UNUSED size_t nbytes, void *data) {
+    matrix_info_t *matrix_info = (matrix_info_t *) *stateptr;
 
-    state->matrix_info = data->matrix_info;
-    state->column_elements = *(data->matrix_info->matrix + (data->matrix_info->k - data->remaining) - 1);
-    state->column = data->column;
-    state->remaining_actors = data->remaining;
-    state->first = data->first;
-    state->remaining_elements = data->n;
-
-    if (state->remaining_actors == 0) {
-        send_message(state->first, (message_t) {
-                MSG_START_COUNTING, sizeof(NULL), NULL
-        });
-    }
-    else {
-        send_message(actor_id_self(), msg_spawn);
-    }
-    free(data);
+    actor_state_t *state = actor_arena_alloc(sizeof(actor_state_t));
+    *stateptr = state;
+    init_column(state, matrix_info, (num_t) (intptr_t) data);
 }
 
 void start_counting(actor_state_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
     actor_state_t *state = *stateptr;
+    num_t block_size = state->matrix_info->block_size;
+
+    if (block_size > 0) {
+        for (num_t row = 0; row < state->matrix_info->n; row += block_size) {
+            num_t rows = state->matrix_info->n - row < block_size ? state->matrix_info->n - row : block_size;
+            size_t nbytes_block = sizeof(msg_count_block_t) + rows * sizeof(sum_t);
+
+            msg_count_block_t *block = message_alloc(nbytes_block);
+            block->first_row = row;
+            block->rows = rows;
+            memset(block->sums, 0, rows * sizeof(sum_t));
+
+            send_message(actor_id_self(), (message_t) {MSG_COUNT_BLOCK, nbytes_block, block});
+        }
+        return;
+    }
 
     for (num_t i = 0; i < state->matrix_info->n; ++i) {
-        msg_count_t *msg_count;
-        malloc_and_check(msg_count, sizeof(msg_count_t));
+        msg_count_t *msg_count = message_alloc(sizeof(msg_count_t));
         msg_count->row = i;
         msg_count->sum = 0;
         msg_count->output = state->matrix_info->output + i;
@@ -205,7 +271,7 @@ void count(actor_state_t **stateptr, UNUSED size_t nbytes, msg_count_t *data) {
 
     if (state->remaining_actors == 0) {
         *data->output = data->sum;
-        free(data);
+        message_free(data);
     }
     else {
         send_message(state->next_actor, (message_t) {
@@ -217,25 +283,343 @@ void count(actor_state_t **stateptr, UNUSED size_t nbytes, msg_count_t *data) {
 
     if (state->remaining_elements == 0) {
         send_message(actor_id_self(), msg_godie);
-        free(state);
         return;
     }
 }
 
-int main() {
+/*
+ * Funkcja dodaje wartości rows komórek kolumny do sum częściowych i zwraca łączny
+ * czas ich obliczeń.
+ */
+static microseconds_t add_column(sum_t *restrict sums, const element_t *restrict elements, num_t rows) {
+    microseconds_t time = 0;
+
+    for (num_t i = 0; i < rows; ++i) {
+        sums[i] += elements[i].value;
+        time += elements[i].time;
+    }
+
+    return time;
+}
+
+void count_block(actor_state_t **stateptr, size_t nbytes, msg_count_block_t *data) {
+    actor_state_t *state = *stateptr;
+
+    microseconds_t time = add_column(data->sums, state->column_elements + data->first_row, data->rows);
+    if (time > 0) {
+        usleep(MILI_TO_MICRO * time);
+    }
+
+    state->remaining_elements -= data->rows;
+
+    if (state->remaining_actors == 0) {
+        memcpy(state->matrix_info->output + data->first_row, data->sums, data->rows * sizeof(sum_t));
+        message_free(data);
+    }
+    else {
+        send_message(state->next_actor, (message_t) {MSG_COUNT_BLOCK, nbytes, data});
+    }
+
+    if (state->remaining_elements == 0) {
+        send_message(actor_id_self(), msg_godie);
+    }
+}
+
+/*
+ * Funkcja wczytuje liczbę całkowitą zaczynającą się w *text (po pominięciu białych znaków)
+ * i przesuwa *text za nią.
+ */
+static int parse_int(const char **text, const char *end) {
+    const char *c = *text;
+
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')) {
+        ++c;
+    }
+
+    bool is_negative = c < end && *c == '-';
+    if (is_negative) {
+        ++c;
+    }
+
+    int value = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        value = 10 * value + (*c - '0');
+        ++c;
+    }
+
+    *text = c;
+    return is_negative ? -value : value;
+}
+
+/*
+ * Funkcja zwraca wskaźnik za najbliższym znakiem nowej linii od text (lub end).
+ */
+static const char *next_line(const char *text, const char *end) {
+    const char *newline = memchr(text, '\n', end - text);
+    return newline == NULL ? end : newline + 1;
+}
+
+void load(actor_state_t **stateptr, UNUSED size_t nbytes, load_info_t *data) {
+    *stateptr = actor_arena_alloc(sizeof(actor_state_t));
+    actor_state_t *state = *stateptr;
+    state->load_info = data;
+
+    size_t size = data->end - data->begin;
+    num_t nchunks = (num_t) (size / CHUNK_SIZE) + 1;
+    if (nchunks > MAX_CHUNKS) {
+        nchunks = MAX_CHUNKS;
+    }
+
+    malloc_and_check(data->chunks, nchunks * sizeof(chunk_t));
+    data->nchunks = nchunks;
+    data->assigned = 0;
+    data->remaining = nchunks;
+
+    // Fragmenty zaczynają się zawsze na początku linijki.
+    const char *begin = data->begin;
+    for (num_t i = 0; i < nchunks; ++i) {
+        const char *end = i + 1 == nchunks
+                          ? data->end
+                          : next_line(data->begin + (i + 1) * (size / nchunks), data->end);
+        if (end < begin) {
+            end = begin;
+        }
+
+        data->chunks[i] = (chunk_t) {
+                .begin = begin,
+                .end = end,
+                .loader = actor_id_self(),
+                .matrix_info = data->matrix_info
+        };
+        begin = end;
+
+        send_message(actor_id_self(), msg_spawn_parser);
+    }
+}
+
+void parser_ready(actor_state_t **stateptr, UNUSED size_t nbytes, void *data) {
+    load_info_t *load_info = (*stateptr)->load_info;
+    chunk_t *chunk = &load_info->chunks[load_info->assigned++];
+    chunk->parser = (actor_id_t) data;
+
+    send_message(chunk->parser, (message_t) {
+            MSG_COUNT_LINES, sizeof(chunk_t), chunk
+    });
+}
+
+void lines_counted(actor_state_t **stateptr, UNUSED size_t nbytes, UNUSED chunk_t *data) {
+    load_info_t *load_info = (*stateptr)->load_info;
+
+    if (--load_info->remaining > 0) {
+        return;
+    }
+
+    // Numer pierwszej linijki fragmentu to liczba linijek we wcześniejszych fragmentach.
+    num_t first_line = 0;
+    for (num_t i = 0; i < load_info->nchunks; ++i) {
+        load_info->chunks[i].first_line = first_line;
+        first_line += load_info->chunks[i].lines;
+    }
+
+    load_info->remaining = load_info->nchunks;
+    for (num_t i = 0; i < load_info->nchunks; ++i) {
+        send_message(load_info->chunks[i].parser, (message_t) {
+                MSG_PARSE, sizeof(chunk_t), &load_info->chunks[i]
+        });
+    }
+}
+
+void parsed(actor_state_t **stateptr, UNUSED size_t nbytes, UNUSED chunk_t *data) {
+    actor_state_t *state = *stateptr;
+    load_info_t *load_info = state->load_info;
+
+    if (--load_info->remaining > 0) {
+        return;
+    }
+
+    matrix_info_t *matrix_info = load_info->matrix_info;
+    free(load_info->chunks);
+    state->load_info = NULL;
+
+    first_actor(stateptr, sizeof(matrix_info_t), matrix_info);
+}
+
+void parser_hello(UNUSED chunk_t **stateptr, UNUSED size_t nbytes, void *data) {
+    actor_id_t actor_id = (actor_id_t) data;
+
+    send_message(actor_id, (message_t) {
+            MSG_PARSER_READY, sizeof(actor_id_t), (void *) actor_id_self()
+    });
+}
+
+void count_lines(chunk_t **stateptr, UNUSED size_t nbytes, chunk_t *data) {
+    *stateptr = data;
+
+    num_t lines = 0;
+    for (const char *c = data->begin; c < data->end; c = next_line(c, data->end)) {
+        ++lines;
+    }
+    data->lines = lines;
+
+    send_message(data->loader, (message_t) {
+            MSG_LINES_COUNTED, sizeof(chunk_t), data
+    });
+}
+
+void parse(chunk_t **stateptr, UNUSED size_t nbytes, chunk_t *data) {
+    matrix_info_t *matrix_info = data->matrix_info;
+    num_t k = matrix_info->k;
+    num_t cells = matrix_info->n * k;
+
+    // Linijka i opisuje komórkę z wiersza i / k i kolumny i % k.
+    const char *text = data->begin;
+    num_t row = data->first_line / k, column = data->first_line % k;
+
+    for (num_t i = 0; i < data->lines && data->first_line + i < cells; ++i) {
+        element_t *element = matrix_info->matrix[column] + row;
+        element->value = parse_int(&text, data->end);
+        element->time = parse_int(&text, data->end);
+        text = next_line(text, data->end);
+
+        if (++column == k) {
+            column = 0;
+            ++row;
+        }
+    }
+
+    *stateptr = NULL;
+
+    send_message(data->loader, (message_t) {
+            MSG_PARSED, sizeof(chunk_t), data
+    });
+    send_message(actor_id_self(), msg_godie);
+}
+
+/*
+ * Funkcja odwzorowuje w pamięć plik path (lub standardowe wejście, gdy path == NULL).
+ * Wejście, którego nie da się odwzorować (np. potok), jest wczytywane do bufora.
+ */
+static char *load_input(const char *path, size_t *size, bool *is_mapped) {
+    int fd = path == NULL ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        syserr(-1, "open failed");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_WILLNEED);
+            *size = st.st_size;
+            *is_mapped = true;
+            if (path != NULL) {
+                close(fd);
+            }
+            return data;
+        }
+    }
+
+    size_t capacity = 1 << 16;
+    char *data;
+    malloc_and_check(data, capacity);
+    *size = 0;
+
+    ssize_t count;
+    while ((count = read(fd, data + *size, capacity - *size)) > 0) {
+        *size += count;
+        if (*size == capacity) {
+            capacity *= 2;
+            realloc_and_check(data, capacity);
+        }
+    }
+
+    if (count < 0) {
+        syserr(-1, "read failed");
+    }
+
+    *is_mapped = false;
+    if (path != NULL) {
+        close(fd);
+    }
+    return data;
+}
+
+/*
+ * Funkcja zapisuje macierz w formacie binarnym: nagłówek, a po nim kolejne kolumny.
+ */
+static void save_binary(const char *path, element_t **matrix, num_t n, num_t k) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        syserr(-1, "fopen failed");
+    }
+
+    binary_header_t header = {BINARY_MAGIC, n, k};
+    bool is_written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (num_t i = 0; i < k && is_written; ++i) {
+        is_written = fwrite(matrix[i], sizeof(element_t), n, file) == (size_t) n;
+    }
+
+    if (fclose(file) != 0 || !is_written) {
+        syserr(-1, "binary write failed");
+    }
+}
+
+int main(int argc, char *argv[]) {
     int err;
 
+    const char *output_path = NULL;
+    num_t block_size = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:")) != -1) {
+        if (opt == 'o') {
+            output_path = optarg;
+        }
+        else if (opt == 'b' && (block_size = atoi(optarg)) > 0) {
+            continue;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-o binary_output] [-b block_rows] [input]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    size_t size;
+    bool is_mapped;
+    char *input = load_input(optind < argc ? argv[optind] : NULL, &size, &is_mapped);
+
+    const binary_header_t *header = (const binary_header_t *) input;
+    bool is_binary = size >= sizeof(binary_header_t) && header->magic == BINARY_MAGIC;
+
     num_t n, k;
-    scanf("%d%d", &n, &k);
-    element_t *matrix[k];
+    const char *body = input;
+    const char *end = input + size;
 
-    for (num_t i = 0; i < k; ++i) {
-        malloc_and_check(matrix[i],n * sizeof(element_t));
+    if (is_binary) {
+        n = header->n;
+        k = header->k;
+
+        if (size < sizeof(binary_header_t) + (size_t) n * k * sizeof(element_t)) {
+            fprintf(stderr, "binary input is truncated\n");
+            return -1;
+        }
+    }
+    else {
+        n = parse_int(&body, end);
+        body = next_line(body, end);
+        k = parse_int(&body, end);
+        body = next_line(body, end);
     }
 
-    for (num_t i = 0; i < n; ++i) {
-        for (num_t j = 0; j < k; ++j) {
-            scanf("%d%d", &matrix[j][i].value, &matrix[j][i].time);
+    element_t *matrix[k];
+
+    for (num_t i = 0; i < k; ++i) {
+        if (is_binary) {
+            // Kolumny są odwzorowane bezpośrednio z pliku.
+            matrix[i] = (element_t *) (input + sizeof(binary_header_t)) + (size_t) i * n;
+        }
+        else {
+            malloc_and_check(matrix[i], n * sizeof(element_t));
         }
     }
 
@@ -250,12 +634,26 @@ int main() {
             .matrix = matrix,
             .output = outputs,
             .k = k,
-            .n = n
+            .n = n,
+            .block_size = block_size
     };
 
-    send_message(actor_id, (message_t) {
-        MSG_FIRST_ACTOR, sizeof(matrix_info_t), &matrix_info
-    });
+    load_info_t load_info = {
+            .matrix_info = &matrix_info,
+            .begin = body,
+            .end = end
+    };
+
+    if (is_binary) {
+        send_message(actor_id, (message_t) {
+                MSG_FIRST_ACTOR, sizeof(matrix_info_t), &matrix_info
+        });
+    }
+    else {
+        send_message(actor_id, (message_t) {
+                MSG_LOAD, sizeof(load_info_t), &load_info
+        });
+    }
 
     actor_system_join(actor_id);
 
@@ -263,8 +661,21 @@ int main() {
         printf("%ld\n", outputs[i]);
     }
 
-    for (num_t i = 0; i < k; ++i) {
-        free(matrix[i]);
+    if (output_path != NULL) {
+        save_binary(output_path, matrix, n, k);
+    }
+
+    if (!is_binary) {
+        for (num_t i = 0; i < k; ++i) {
+            free(matrix[i]);
+        }
+    }
+
+    if (is_mapped) {
+        munmap(input, size);
+    }
+    else {
+        free(input);
     }
 
     return 0;
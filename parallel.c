@@ -0,0 +1,257 @@
+#include "parallel.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "pool.h"
+#include "utils.h"
+
+/*
+ * Interakcja między aktorami:
+ * Wywołujący tworzy nworkers aktorów (spawn_many) i wysyła każdemu numer jego
+ * części przedziału (MSG_PAR_START). Aktor przetwarza swoją część fragmentami,
+ * wysyłając sobie MSG_PAR_CHUNK. Wyniki są łączone w drzewie dwumianowym: aktor i
+ * otrzymuje (MSG_PAR_RESULT) wyniki aktorów i + 1, i + 2, i + 4, ... (dopóki i jest
+ * podzielne przez krok), a połączony wynik wysyła aktorowi i - (najniższy bit i).
+ * Aktor 0 spełnia future.
+ */
+
+#define MSG_PAR_START (message_type_t) 0x1
+#define MSG_PAR_CHUNK (message_type_t) 0x2
+#define MSG_PAR_RESULT (message_type_t) 0x3
+
+typedef struct job {
+    parallel_body_t body;
+    parallel_reduce_t reduce;
+    void *context;
+    size_t begin, end;
+    size_t nworkers;
+    actor_id_t first;
+    future_t *future;
+} job_t;
+
+typedef struct result {
+    size_t level;
+    void *value;
+} result_t;
+
+/*
+ * Stan aktora części index. received[l] i values[l] opisują wynik aktora
+ * index + 2^l; level to poziom, z którym łączony jest teraz wynik.
+ */
+typedef struct worker {
+    job_t *job;
+    size_t index;
+    size_t next, end;
+    size_t chunk;
+    void *value;
+    bool has_value;
+    bool is_computed;
+    size_t level, nlevels;
+    bool *received;
+    void **values;
+} worker_t;
+
+static void worker_hello(void **stateptr, size_t nbytes, void *data);
+
+static void start(void **stateptr, size_t nbytes, void *data);
+
+static void chunk(worker_t **stateptr, size_t nbytes, void *data);
+
+static void result(worker_t **stateptr, size_t nbytes, result_t *data);
+
+static role_t worker_role = {
+        .nprompts = 4,
+        .prompts = (act_t[4]) {
+                (act_t) worker_hello,
+                (act_t) start,
+                (act_t) chunk,
+                (act_t) result
+        }
+};
+
+static message_t msg_chunk = {MSG_PAR_CHUNK, sizeof(NULL), NULL};
+static message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static void *combine(const job_t *job, void *left, void *right) {
+    return job->reduce == NULL ? NULL : job->reduce(left, right, job->context);
+}
+
+/*
+ * Funkcja łączy wynik aktora z otrzymanymi wynikami kolejnych poziomów
+ * i po otrzymaniu wszystkich przekazuje go dalej.
+ */
+static void try_finish(worker_t *worker) {
+    if (!worker->is_computed) {
+        return;
+    }
+
+    job_t *job = worker->job;
+
+    while (worker->level < worker->nlevels && worker->received[worker->level]) {
+        worker->value = combine(job, worker->value, worker->values[worker->level]);
+        worker->level++;
+    }
+
+    if (worker->level < worker->nlevels) {
+        return;
+    }
+
+    if (worker->index == 0) {
+        future_t *future = job->future;
+        free(job);
+        future_complete(future, worker->value);
+    }
+    else {
+        size_t lowest = worker->index & -worker->index;
+        size_t level = 0;
+        while (((size_t) 1 << level) < lowest) {
+            ++level;
+        }
+
+        result_t *message = message_alloc(sizeof(result_t));
+        message->level = level;
+        message->value = worker->value;
+
+        send_message(job->first + (actor_id_t) (worker->index - lowest), (message_t) {
+                MSG_PAR_RESULT, sizeof(result_t), message
+        });
+    }
+
+    send_message(actor_id_self(), msg_godie);
+}
+
+static void worker_hello(UNUSED void **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    // Aktor czeka na numer swojej części (MSG_PAR_START).
+}
+
+static void start(void **stateptr, UNUSED size_t nbytes, void *data) {
+    job_t *job = *stateptr;
+
+    worker_t *worker = actor_arena_alloc(sizeof(worker_t));
+    *stateptr = worker;
+
+    size_t index = (size_t) data;
+    size_t length = job->end - job->begin;
+
+    worker->job = job;
+    worker->index = index;
+    worker->next = job->begin + length * index / job->nworkers;
+    worker->end = job->begin + length * (index + 1) / job->nworkers;
+    worker->chunk = PARALLEL_MIN_CHUNK;
+    worker->value = NULL;
+    worker->has_value = false;
+    worker->is_computed = false;
+    worker->level = 0;
+    worker->nlevels = 0;
+
+    // Aktor zbiera wyniki z poziomów, dla których index jest podzielne przez 2^(poziom + 1).
+    while ((index & ((size_t) 1 << worker->nlevels)) == 0
+           && index + ((size_t) 1 << worker->nlevels) < job->nworkers) {
+        worker->nlevels++;
+    }
+
+    worker->received = actor_arena_alloc((worker->nlevels + 1) * sizeof(bool));
+    worker->values = actor_arena_alloc((worker->nlevels + 1) * sizeof(void *));
+
+    for (size_t i = 0; i < worker->nlevels; ++i) {
+        worker->received[i] = false;
+    }
+
+    send_message(actor_id_self(), msg_chunk);
+}
+
+static void chunk(worker_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    worker_t *worker = *stateptr;
+    job_t *job = worker->job;
+
+    size_t begin = worker->next;
+    size_t end = worker->end - begin > worker->chunk ? begin + worker->chunk : worker->end;
+
+    uint64_t start_time = now();
+    void *value = job->body(begin, end, job->context);
+    uint64_t elapsed = now() - start_time;
+
+    worker->value = worker->has_value ? combine(job, worker->value, value) : value;
+    worker->has_value = true;
+    worker->next = end;
+
+    // Długość fragmentu zmienia się co najwyżej dwukrotnie na krok.
+    size_t target = elapsed == 0 ? 2 * worker->chunk : worker->chunk * PARALLEL_CHUNK_TIME / elapsed;
+    if (target > 2 * worker->chunk) {
+        target = 2 * worker->chunk;
+    }
+    if (target < worker->chunk / 2) {
+        target = worker->chunk / 2;
+    }
+    worker->chunk = target == 0 ? 1 : target;
+
+    if (worker->next < worker->end) {
+        send_message(actor_id_self(), msg_chunk);
+        return;
+    }
+
+    worker->is_computed = true;
+    try_finish(worker);
+}
+
+static void result(worker_t **stateptr, UNUSED size_t nbytes, result_t *data) {
+    worker_t *worker = *stateptr;
+
+    worker->received[data->level] = true;
+    worker->values[data->level] = data->value;
+    message_free(data);
+
+    try_finish(worker);
+}
+
+int parallel_reduce(size_t begin, size_t end, parallel_body_t body, parallel_reduce_t reduce,
+                    void *context, unsigned int nworkers, future_t *future) {
+    if (begin >= end) {
+        future_complete(future, NULL);
+        return 0;
+    }
+
+    size_t count = nworkers == 0 ? POOL_SIZE : nworkers;
+    if (count > end - begin) {
+        count = end - begin;
+    }
+
+    job_t *job;
+    malloc_and_check(job, sizeof(job_t));
+    job->body = body;
+    job->reduce = reduce;
+    job->context = context;
+    job->begin = begin;
+    job->end = end;
+    job->nworkers = count;
+    job->future = future;
+
+    // Stanem początkowym aktorów jest job, a numery części otrzymują w komunikatach.
+    job->first = spawn_many(&worker_role, count, job);
+    if (job->first < 0) {
+        int err = (int) job->first;
+        free(job);
+        return err;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        send_message(job->first + (actor_id_t) i, (message_t) {
+                MSG_PAR_START, sizeof(size_t), (void *) i
+        });
+    }
+
+    return 0;
+}
+
+int parallel_for(size_t begin, size_t end, parallel_body_t body, void *context,
+                 unsigned int nworkers, future_t *future) {
+    return parallel_reduce(begin, end, body, NULL, context, nworkers, future);
+}
@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+#include "cacti.h"
+#include "future.h"
+
+/*
+ * Docelowy czas (w mikrosekundach) obsługi jednego fragmentu przedziału.
+ * Aktor dostosowuje długość kolejnych fragmentów do czasu obsługi poprzednich.
+ */
+#ifndef PARALLEL_CHUNK_TIME
+#define PARALLEL_CHUNK_TIME 200
+#endif
+
+/*
+ * Długość pierwszego fragmentu przedziału obsługiwanego przez aktora.
+ */
+#ifndef PARALLEL_MIN_CHUNK
+#define PARALLEL_MIN_CHUNK 16
+#endif
+
+/*
+ * Funkcja oblicza częściowy wynik dla indeksów z przedziału [begin, end).
+ */
+typedef void *(*parallel_body_t)(size_t begin, size_t end, void *context);
+
+/*
+ * Funkcja łączy wyniki dwóch sąsiednich przedziałów (left poprzedza right).
+ * Musi być łączna; nie musi być przemienna.
+ */
+typedef void *(*parallel_reduce_t)(void *left, void *right, void *context);
+
+/*
+ * Funkcja dzieli przedział [begin, end) na nworkers spójnych części (0 oznacza
+ * POOL_SIZE) obsługiwanych przez nowych aktorów. Każdy z nich przetwarza swoją
+ * część fragmentami, wysyłając sobie komunikat po każdym z nich, tak aby nie
+ * zajmować wątku roboczego dłużej niż przez około PARALLEL_CHUNK_TIME.
+ * Wyniki są łączone funkcją reduce w drzewie (w kolejności przedziałów),
+ * a wynik całości spełnia future. Funkcja może być wywoływana z obsługi
+ * komunikatu lub spoza systemu aktorów.
+ * Zwraca 0 w przypadku powodzenia i kody błędów spawn_many w przeciwnym razie.
+ */
+int parallel_reduce(size_t begin, size_t end, parallel_body_t body, parallel_reduce_t reduce,
+                    void *context, unsigned int nworkers, future_t *future);
+
+/*
+ * Funkcja jak parallel_reduce, ale bez łączenia wyników (future jest spełniana
+ * wartością NULL).
+ */
+int parallel_for(size_t begin, size_t end, parallel_body_t body, void *context,
+                 unsigned int nworkers, future_t *future);
+
+#endif //PARALLEL_H
@@ -0,0 +1,480 @@
+#include "pipeline.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "actor.h"
+#include "pool.h"
+#include "utils.h"
+
+/*
+ * Interakcja między aktorami:
+ * Pierwszy aktor (źródło) po otrzymaniu MSG_PIPE_START tworzy aktorów wszystkich
+ * etapów, którzy zgłaszają się przez MSG_PIPE_JOIN. Następnie wysyła każdemu z nich
+ * MSG_PIPE_SETUP z listą aktorów następnego etapu i zaczyna pobierać elementy.
+ * Paczki elementów są przekazywane przez MSG_PIPE_BATCH; odbiorca po obsłużeniu
+ * paczki zwraca nadawcy miejsce na kolejną (MSG_PIPE_CREDIT). Po wysłaniu ostatniej
+ * paczki nadawca wysyła odbiorcom MSG_PIPE_END, a sam wysyła do siebie MSG_GODIE.
+ */
+
+#define MSG_PIPE_START (message_type_t) 0x1
+#define MSG_PIPE_JOIN (message_type_t) 0x2
+#define MSG_PIPE_SETUP (message_type_t) 0x3
+#define MSG_PIPE_BATCH (message_type_t) 0x4
+#define MSG_PIPE_CREDIT (message_type_t) 0x5
+#define MSG_PIPE_END (message_type_t) 0x6
+
+/*
+ * Paczka elementów. slot to indeks odbiorcy u nadawcy, odsyłany w MSG_PIPE_CREDIT.
+ */
+typedef struct batch {
+    actor_id_t sender;
+    size_t slot;
+    size_t nitems;
+    struct batch *next;
+    void *items[];
+} batch_t;
+
+/*
+ * Wyjście aktora potoku. credits[i] to liczba paczek, które można jeszcze wysłać
+ * do receivers[i]; batch to paczka w trakcie wypełniania.
+ */
+typedef struct output {
+    actor_id_t *receivers;
+    unsigned int *credits;
+    size_t nreceivers;
+    size_t next;
+    size_t batch_size;
+    batch_t *batch;
+} output_t;
+
+typedef struct source {
+    const pipeline_t *pipeline;
+    actor_id_t *workers;
+    size_t nworkers;
+    size_t joined;
+    bool is_exhausted;
+    bool is_ended;
+    output_t output;
+} source_t;
+
+/*
+ * Stan aktora etapu. input to kolejka otrzymanych paczek, z których pierwsza
+ * jest obsłużona do indeksu position.
+ */
+typedef struct worker {
+    const pipeline_stage_t *stage;
+    unsigned int nupstream;
+    unsigned int nended;
+    batch_t *input, *input_tail;
+    size_t position;
+    bool is_ended;
+    output_t output;
+} worker_t;
+
+typedef struct setup {
+    const pipeline_stage_t *stage;
+    unsigned int nupstream;
+    unsigned int credits;
+    size_t batch_size;
+    size_t nreceivers;
+    actor_id_t receivers[];
+} setup_t;
+
+static void source_hello(source_t **stateptr, size_t nbytes, void *data);
+
+static void start(source_t **stateptr, size_t nbytes, const pipeline_t *data);
+
+static void join(source_t **stateptr, size_t nbytes, void *data);
+
+static void source_credit(source_t **stateptr, size_t nbytes, void *data);
+
+static void worker_hello(worker_t **stateptr, size_t nbytes, void *data);
+
+static void setup(worker_t **stateptr, size_t nbytes, setup_t *data);
+
+static void batch(worker_t **stateptr, size_t nbytes, batch_t *data);
+
+static void worker_credit(worker_t **stateptr, size_t nbytes, void *data);
+
+static void end(worker_t **stateptr, size_t nbytes, void *data);
+
+static role_t source_role = {
+        .nprompts = 6,
+        .prompts = (act_t[6]) {
+                (act_t) source_hello,
+                (act_t) start,
+                (act_t) join,
+                NULL,
+                NULL,
+                (act_t) source_credit
+        }
+};
+
+static role_t worker_role = {
+        .nprompts = 7,
+        .prompts = (act_t[7]) {
+                (act_t) worker_hello,
+                NULL,
+                NULL,
+                (act_t) setup,
+                (act_t) batch,
+                (act_t) worker_credit,
+                (act_t) end
+        }
+};
+
+static message_t msg_spawn_worker = {MSG_SPAWN, sizeof(role_t), &worker_role};
+static message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
+
+static unsigned int stage_parallelism(const pipeline_t *pipeline, size_t stage) {
+    unsigned int parallelism = pipeline->stages[stage].parallelism;
+    return parallelism == 0 ? 1 : parallelism;
+}
+
+/*
+ * Funkcja zwraca liczbę paczek, które każdy z nadawców może mieć w drodze
+ * do jednego aktora etapu stage (pojemność aktora dzielona między nadawców).
+ */
+static unsigned int stage_credits(const pipeline_t *pipeline, size_t stage) {
+    unsigned int capacity = pipeline->stages[stage].capacity;
+    unsigned int nsenders = stage == 0 ? 1 : stage_parallelism(pipeline, stage - 1);
+
+    capacity = capacity == 0 ? PIPELINE_CAPACITY : capacity;
+    return capacity < nsenders ? 1 : capacity / nsenders;
+}
+
+static size_t batch_size(const pipeline_t *pipeline) {
+    return pipeline->batch_size == 0 ? PIPELINE_BATCH_SIZE : pipeline->batch_size;
+}
+
+/*
+ * Funkcja sprawdza, czy komunikaty potoku zmieszczą się w skrzynkach aktorów.
+ */
+static bool is_valid(const pipeline_t *pipeline) {
+    if (pipeline->source == NULL || pipeline->nstages == 0) {
+        return false;
+    }
+
+    size_t nworkers = 0;
+
+    for (size_t i = 0; i < pipeline->nstages; ++i) {
+        if (pipeline->stages[i].func == NULL) {
+            return false;
+        }
+
+        size_t nupstream = i == 0 ? 1 : stage_parallelism(pipeline, i - 1);
+        size_t pending = nupstream * (stage_credits(pipeline, i) + 1) + 1;
+        if (i + 1 < pipeline->nstages) {
+            pending += stage_parallelism(pipeline, i + 1) * stage_credits(pipeline, i + 1);
+        }
+
+        if (pending > ACTOR_QUEUE_LIMIT) {
+            return false;
+        }
+
+        nworkers += stage_parallelism(pipeline, i);
+    }
+
+    return 2 * nworkers + stage_parallelism(pipeline, 0) * stage_credits(pipeline, 0) + 1
+           <= ACTOR_QUEUE_LIMIT;
+}
+
+static void output_init(output_t *output, const actor_id_t *receivers, size_t nreceivers,
+                        unsigned int credits, size_t batch_size) {
+    output->receivers = actor_arena_alloc(nreceivers * sizeof(actor_id_t));
+    output->credits = actor_arena_alloc(nreceivers * sizeof(unsigned int));
+    output->nreceivers = nreceivers;
+    output->next = 0;
+    output->batch_size = batch_size;
+    output->batch = NULL;
+
+    for (size_t i = 0; i < nreceivers; ++i) {
+        output->receivers[i] = receivers[i];
+        output->credits[i] = credits;
+    }
+}
+
+static bool output_is_full(const output_t *output) {
+    return output->batch != NULL && output->batch->nitems == output->batch_size;
+}
+
+static void output_push(output_t *output, void *item) {
+    if (output->batch == NULL) {
+        output->batch = message_alloc(sizeof(batch_t) + output->batch_size * sizeof(void *));
+        output->batch->nitems = 0;
+        output->batch->next = NULL;
+    }
+
+    output->batch->items[output->batch->nitems++] = item;
+}
+
+/*
+ * Funkcja wysyła wypełnianą paczkę kolejnemu odbiorcy, który ma na nią miejsce.
+ * Zwraca false, jeśli żaden odbiorca nie ma miejsca.
+ */
+static bool output_flush(output_t *output) {
+    if (output->batch == NULL) {
+        return true;
+    }
+
+    for (size_t i = 0; i < output->nreceivers; ++i) {
+        size_t slot = (output->next + i) % output->nreceivers;
+        if (output->credits[slot] == 0) {
+            continue;
+        }
+
+        batch_t *batch = output->batch;
+        batch->sender = actor_id_self();
+        batch->slot = slot;
+
+        output->batch = NULL;
+        output->credits[slot]--;
+        output->next = slot + 1;
+
+        if (send_message(output->receivers[slot], (message_t) {
+                .message_type = MSG_PIPE_BATCH,
+                .nbytes = sizeof(batch_t) + batch->nitems * sizeof(void *),
+                .data = batch
+        }) != 0) {
+            // System aktorów został przerwany.
+            message_free(batch);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static void output_end(const output_t *output) {
+    for (size_t i = 0; i < output->nreceivers; ++i) {
+        send_message(output->receivers[i], (message_t) {MSG_PIPE_END, sizeof(NULL), NULL});
+    }
+}
+
+/*
+ * Funkcja pobiera elementy ze źródła, dopóki następny etap ma miejsce na paczki.
+ */
+static void source_pump(source_t *source) {
+    if (source->is_ended) {
+        return;
+    }
+
+    const pipeline_t *pipeline = source->pipeline;
+
+    while (!source->is_exhausted) {
+        if (output_is_full(&source->output) && !output_flush(&source->output)) {
+            return;
+        }
+
+        void *item = pipeline->source(pipeline->source_context);
+        if (item == NULL) {
+            source->is_exhausted = true;
+        }
+        else {
+            output_push(&source->output, item);
+        }
+    }
+
+    if (!output_flush(&source->output)) {
+        return;
+    }
+
+    source->is_ended = true;
+    output_end(&source->output);
+    send_message(actor_id_self(), msg_godie);
+}
+
+/*
+ * Funkcja obsługuje otrzymane paczki, dopóki następny etap ma miejsce na wyniki.
+ * Miejsce na paczkę jest zwracane nadawcy po obsłużeniu wszystkich jej elementów.
+ */
+static void worker_pump(worker_t *worker) {
+    if (worker->is_ended) {
+        return;
+    }
+
+    const pipeline_stage_t *stage = worker->stage;
+
+    while (worker->input != NULL) {
+        batch_t *input = worker->input;
+
+        while (worker->position < input->nitems) {
+            if (output_is_full(&worker->output) && !output_flush(&worker->output)) {
+                return;
+            }
+
+            void *item = stage->func(input->items[worker->position++], stage->context);
+            if (item != NULL && worker->output.nreceivers > 0) {
+                output_push(&worker->output, item);
+            }
+        }
+
+        worker->input = input->next;
+        worker->position = 0;
+
+        send_message(input->sender, (message_t) {MSG_PIPE_CREDIT, sizeof(size_t), (void *) input->slot});
+        message_free(input);
+    }
+
+    // Brak paczek do obsługi - niepełna paczka wyników jest wysyłana od razu.
+    if (!output_flush(&worker->output) || worker->nended < worker->nupstream) {
+        return;
+    }
+
+    worker->is_ended = true;
+    output_end(&worker->output);
+    send_message(actor_id_self(), msg_godie);
+}
+
+static void source_hello(UNUSED source_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {}
+
+static void start(source_t **stateptr, UNUSED size_t nbytes, const pipeline_t *data) {
+    source_t *source = actor_arena_alloc(sizeof(source_t));
+    *stateptr = source;
+
+    source->pipeline = data;
+    source->nworkers = 0;
+    source->joined = 0;
+    source->is_exhausted = false;
+    source->is_ended = false;
+
+    for (size_t i = 0; i < data->nstages; ++i) {
+        source->nworkers += stage_parallelism(data, i);
+    }
+
+    source->workers = actor_arena_alloc(source->nworkers * sizeof(actor_id_t));
+
+    for (size_t i = 0; i < source->nworkers; ++i) {
+        send_message(actor_id_self(), msg_spawn_worker);
+    }
+}
+
+static void join(source_t **stateptr, UNUSED size_t nbytes, void *data) {
+    source_t *source = *stateptr;
+    const pipeline_t *pipeline = source->pipeline;
+
+    source->workers[source->joined++] = (actor_id_t) data;
+    if (source->joined < source->nworkers) {
+        return;
+    }
+
+    // Aktorzy etapu i zajmują kolejne pozycje tablicy workers.
+    actor_id_t *stage_workers = source->workers;
+
+    for (size_t i = 0; i < pipeline->nstages; ++i) {
+        unsigned int parallelism = stage_parallelism(pipeline, i);
+        actor_id_t *next_workers = stage_workers + parallelism;
+        size_t nreceivers = i + 1 < pipeline->nstages ? stage_parallelism(pipeline, i + 1) : 0;
+
+        for (unsigned int j = 0; j < parallelism; ++j) {
+            setup_t *setup = message_alloc(sizeof(setup_t) + nreceivers * sizeof(actor_id_t));
+            setup->stage = &pipeline->stages[i];
+            setup->nupstream = i == 0 ? 1 : stage_parallelism(pipeline, i - 1);
+            setup->credits = nreceivers > 0 ? stage_credits(pipeline, i + 1) : 0;
+            setup->batch_size = batch_size(pipeline);
+            setup->nreceivers = nreceivers;
+
+            for (size_t r = 0; r < nreceivers; ++r) {
+                setup->receivers[r] = next_workers[r];
+            }
+
+            send_message(stage_workers[j], (message_t) {
+                    .message_type = MSG_PIPE_SETUP,
+                    .nbytes = sizeof(setup_t) + nreceivers * sizeof(actor_id_t),
+                    .data = setup
+            });
+        }
+
+        stage_workers = next_workers;
+    }
+
+    output_init(&source->output, source->workers, stage_parallelism(pipeline, 0),
+                stage_credits(pipeline, 0), batch_size(pipeline));
+
+    source_pump(source);
+}
+
+static void source_credit(source_t **stateptr, UNUSED size_t nbytes, void *data) {
+    source_t *source = *stateptr;
+
+    source->output.credits[(size_t) data]++;
+    source_pump(source);
+}
+
+static void worker_hello(UNUSED worker_t **stateptr, UNUSED size_t nbytes, void *data) {
+    send_message((actor_id_t) data, (message_t) {
+            .message_type = MSG_PIPE_JOIN,
+            .nbytes = sizeof(actor_id_t),
+            .data = (void *) actor_id_self()
+    });
+}
+
+static void setup(worker_t **stateptr, UNUSED size_t nbytes, setup_t *data) {
+    worker_t *worker = actor_arena_alloc(sizeof(worker_t));
+    *stateptr = worker;
+
+    worker->stage = data->stage;
+    worker->nupstream = data->nupstream;
+    worker->nended = 0;
+    worker->input = NULL;
+    worker->input_tail = NULL;
+    worker->position = 0;
+    worker->is_ended = false;
+
+    output_init(&worker->output, data->receivers, data->nreceivers, data->credits, data->batch_size);
+
+    message_free(data);
+}
+
+static void batch(worker_t **stateptr, UNUSED size_t nbytes, batch_t *data) {
+    worker_t *worker = *stateptr;
+
+    data->next = NULL;
+    if (worker->input == NULL) {
+        worker->input = data;
+    }
+    else {
+        worker->input_tail->next = data;
+    }
+    worker->input_tail = data;
+
+    worker_pump(worker);
+}
+
+static void worker_credit(worker_t **stateptr, UNUSED size_t nbytes, void *data) {
+    worker_t *worker = *stateptr;
+
+    worker->output.credits[(size_t) data]++;
+    worker_pump(worker);
+}
+
+static void end(worker_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    worker_t *worker = *stateptr;
+
+    worker->nended++;
+    worker_pump(worker);
+}
+
+int pipeline_run(const pipeline_t *pipeline) {
+    if (!is_valid(pipeline)) {
+        return -2;
+    }
+
+    actor_id_t actor;
+
+    if (actor_system_create(&actor, &source_role) != 0) {
+        return -1;
+    }
+
+    send_message(actor, (message_t) {
+            .message_type = MSG_PIPE_START,
+            .nbytes = sizeof(pipeline_t),
+            .data = (void *) pipeline
+    });
+
+    actor_system_join(actor);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+
+#include "cacti.h"
+
+/*
+ * Domyślny rozmiar paczki elementów przekazywanej między etapami.
+ */
+#ifndef PIPELINE_BATCH_SIZE
+#define PIPELINE_BATCH_SIZE 64
+#endif
+
+/*
+ * Domyślna liczba paczek, które mogą oczekiwać na obsługę przez aktora etapu.
+ */
+#ifndef PIPELINE_CAPACITY
+#define PIPELINE_CAPACITY 4
+#endif
+
+/*
+ * Funkcja źródła zwraca kolejny element potoku lub NULL na końcu strumienia.
+ */
+typedef void *(*pipeline_source_t)(void *context);
+
+/*
+ * Funkcja etapu przetwarza element i zwraca element dla następnego etapu
+ * (NULL odrzuca element). Wynik funkcji ostatniego etapu jest pomijany.
+ * Przy parallelism > 1 funkcja jest wywoływana współbieżnie z tym samym context.
+ */
+typedef void *(*pipeline_stage_func_t)(void *item, void *context);
+
+/*
+ * Opis etapu potoku. Etap jest obsługiwany przez parallelism aktorów, z których
+ * każdy przyjmuje co najwyżej capacity nieobsłużonych paczek. Wartości 0 oznaczają
+ * odpowiednio jednego aktora i PIPELINE_CAPACITY paczek.
+ */
+typedef struct pipeline_stage {
+    pipeline_stage_func_t func;
+    void *context;
+    unsigned int parallelism;
+    unsigned int capacity;
+} pipeline_stage_t;
+
+/*
+ * Opis potoku: źródło i nstages etapów. Elementy są przekazywane między etapami
+ * w paczkach po co najwyżej batch_size (0 oznacza PIPELINE_BATCH_SIZE).
+ */
+typedef struct pipeline {
+    pipeline_source_t source;
+    void *source_context;
+    size_t nstages;
+    const pipeline_stage_t *stages;
+    size_t batch_size;
+} pipeline_t;
+
+/*
+ * Funkcja tworzy system aktorów wykonujący potok i czeka na jego zakończenie.
+ * Aktor wysyła paczkę dalej, gdy jest pełna lub gdy skończyły mu się paczki
+ * do obsługi, o ile odbiorca ma na nią miejsce - w przeciwnym razie wstrzymuje
+ * obsługę, co wstrzymuje też poprzednie etapy (aż do źródła). Koniec strumienia
+ * jest przekazywany kolejnym etapom po obsłużeniu wszystkich elementów, a aktorzy
+ * etapu kończą wtedy działanie.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie udało się utworzyć systemu aktorów,
+ * -2 gdy opis potoku jest niepoprawny (brak etapów lub pojemności przekraczające
+ * rozmiar skrzynek aktorów).
+ */
+int pipeline_run(const pipeline_t *pipeline);
+
+#endif //PIPELINE_H
@@ -0,0 +1,246 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "actor.h"
+#include "system.h"
+#include "utils.h"
+
+/*
+ * Znacznik stosu remote puli, której wątek się zakończył. Bloki takiej puli
+ * są zwalniane bezpośrednio.
+ */
+#define POOL_ORPHANED ((pool_block_t *) 1)
+
+#define POOL_LARGE POOL_CLASSES
+
+/*
+ * Pule zakończonych wątków, przejmowane przez nowe wątki.
+ */
+static struct {
+    pool_t *pools;
+    pthread_mutex_t lock;
+} orphans = {NULL, PTHREAD_MUTEX_INITIALIZER};
+
+static _Thread_local pool_t *local_pool = NULL;
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Funkcja zwalnia wolne bloki puli kończącego się wątku i oddaje pulę do ponownego użycia.
+ */
+static void pool_orphan(void *data) {
+    int err;
+
+    pool_t *pool = data;
+
+    for (size_t i = 0; i < POOL_CLASSES; ++i) {
+        while (pool->free_blocks[i] != NULL) {
+            pool_block_t *block = pool->free_blocks[i];
+            pool->free_blocks[i] = block->next;
+            free(block);
+        }
+        pool->nfree_blocks[i] = 0;
+    }
+
+    pool_block_t *remote = atomic_exchange(&pool->remote, POOL_ORPHANED);
+    while (remote != NULL) {
+        pool_block_t *next = remote->next;
+        free(remote);
+        remote = next;
+    }
+
+    local_pool = NULL;
+
+    entity_lock((&orphans));
+    pool->next = orphans.pools;
+    orphans.pools = pool;
+    entity_unlock((&orphans));
+}
+
+static void pool_key_create(void) {
+    int err;
+
+    check_if_error(pthread_key_create(&pool_key, pool_orphan), "pthread key create failed");
+}
+
+/*
+ * Funkcja zwraca pulę wywołującego wątku, tworząc ją przy pierwszym użyciu.
+ */
+static pool_t *get_pool(void) {
+    if (local_pool != NULL) {
+        return local_pool;
+    }
+
+    int err;
+
+    check_if_error(pthread_once(&pool_once, pool_key_create), "pthread once failed");
+
+    entity_lock((&orphans));
+    pool_t *pool = orphans.pools;
+    if (pool != NULL) {
+        orphans.pools = pool->next;
+    }
+    entity_unlock((&orphans));
+
+    if (pool == NULL) {
+        malloc_and_check(pool, sizeof(pool_t));
+        for (size_t i = 0; i < POOL_CLASSES; ++i) {
+            pool->free_blocks[i] = NULL;
+            pool->nfree_blocks[i] = 0;
+        }
+    }
+
+    atomic_store(&pool->remote, NULL);
+    local_pool = pool;
+
+    check_if_error(pthread_setspecific(pool_key, pool), "pthread setspecific failed");
+
+    return pool;
+}
+
+/*
+ * Funkcja umieszcza blok na liście wolnych bloków puli wątku.
+ */
+static void pool_put(pool_t *pool, pool_block_t *block) {
+    size_t size_class = block->size_class;
+
+    if (pool->nfree_blocks[size_class] >= POOL_CACHE_LIMIT) {
+        free(block);
+        return;
+    }
+
+    block->next = pool->free_blocks[size_class];
+    pool->free_blocks[size_class] = block;
+    pool->nfree_blocks[size_class]++;
+}
+
+/*
+ * Funkcja przejmuje bloki zwolnione przez inne wątki.
+ */
+static void pool_collect(pool_t *pool) {
+    pool_block_t *remote = atomic_exchange_explicit(&pool->remote, NULL, memory_order_acquire);
+
+    while (remote != NULL) {
+        pool_block_t *next = remote->next;
+        pool_put(pool, remote);
+        remote = next;
+    }
+}
+
+void *message_alloc(size_t size) {
+    size_t size_class = 0;
+    while (size_class < POOL_CLASSES && ((size_t) POOL_MIN_SIZE << size_class) < size) {
+        ++size_class;
+    }
+
+    pool_block_t *block;
+
+    if (size_class == POOL_LARGE) {
+        malloc_and_check(block, sizeof(pool_block_t) + size);
+        block->owner = NULL;
+        block->size_class = POOL_LARGE;
+        return block->data;
+    }
+
+    pool_t *pool = get_pool();
+
+    if (pool->free_blocks[size_class] == NULL) {
+        pool_collect(pool);
+    }
+
+    block = pool->free_blocks[size_class];
+
+    if (block != NULL) {
+        pool->free_blocks[size_class] = block->next;
+        pool->nfree_blocks[size_class]--;
+    }
+    else {
+        malloc_and_check(block, sizeof(pool_block_t) + ((size_t) POOL_MIN_SIZE << size_class));
+        block->size_class = size_class;
+    }
+
+    block->owner = pool;
+    return block->data;
+}
+
+void message_free(void *data) {
+    if (data == NULL) {
+        return;
+    }
+
+    pool_block_t *block = (pool_block_t *) ((char *) data - offsetof(pool_block_t, data));
+    pool_t *owner = block->owner;
+
+    if (owner == NULL) {
+        free(block);
+        return;
+    }
+
+    if (owner == local_pool) {
+        pool_put(owner, block);
+        return;
+    }
+
+    // Blok wraca do puli wątku, który go przydzielił.
+    pool_block_t *head = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    do {
+        if (head == POOL_ORPHANED) {
+            free(block);
+            return;
+        }
+        block->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&owner->remote, &head, block,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+void *arena_alloc(arena_chunk_t **arena, size_t size) {
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+    arena_chunk_t *chunk = *arena;
+
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = ARENA_CHUNK_SIZE - sizeof(arena_chunk_t);
+        if (chunk_size < size) {
+            chunk_size = size;
+        }
+
+        malloc_and_check(chunk, sizeof(arena_chunk_t) + chunk_size);
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        chunk->next = *arena;
+        *arena = chunk;
+    }
+
+    void *data = chunk->data + chunk->used;
+    chunk->used += size;
+
+    return data;
+}
+
+void arena_release(arena_chunk_t **arena) {
+    while (*arena != NULL) {
+        arena_chunk_t *chunk = *arena;
+        *arena = chunk->next;
+        free(chunk);
+    }
+}
+
+void *actor_arena_alloc(size_t size) {
+    if (current_actors_system == NULL || current_actor == -1) {
+        return NULL;
+    }
+
+    int err;
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    entity_reader_lock(actors_array);
+    actor_t *actor = actors_array_get_actor(actors_array, current_actor);
+    entity_rw_unlock(actors_array);
+
+    // Z areny korzysta tylko wątek obsługujący komunikat aktora.
+    return arena_alloc(&actor->arena, size);
+}
@@ -0,0 +1,88 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "cacti.h"
+
+/*
+ * Klasy rozmiarów puli danych komunikatów: POOL_MIN_SIZE, 2 * POOL_MIN_SIZE, ...
+ * Większe bloki są alokowane bezpośrednio funkcją malloc.
+ */
+#define POOL_MIN_SIZE 16
+#define POOL_CLASSES 8
+
+/*
+ * Maksymalna liczba wolnych bloków jednej klasy przechowywanych przez wątek.
+ */
+#ifndef POOL_CACHE_LIMIT
+#define POOL_CACHE_LIMIT 512
+#endif
+
+/*
+ * Rozmiar fragmentu areny aktora.
+ */
+#ifndef ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE 4096
+#endif
+
+/*
+ * Nagłówek bloku danych komunikatu.
+ */
+typedef struct pool_block {
+    struct pool *owner;
+    struct pool_block *next;
+    size_t size_class;
+    _Alignas(max_align_t) char data[];
+} pool_block_t;
+
+/*
+ * Pula wolnych bloków wątku. Bloki zwalniane przez inne wątki trafiają na stos
+ * remote, który właściciel przejmuje, gdy zabraknie mu bloków danej klasy.
+ */
+typedef struct pool {
+    pool_block_t *free_blocks[POOL_CLASSES];
+    unsigned int nfree_blocks[POOL_CLASSES];
+    _Atomic(pool_block_t *) remote;
+    struct pool *next;
+} pool_t;
+
+/*
+ * Fragment areny aktora.
+ */
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used, size;
+    _Alignas(max_align_t) char data[];
+} arena_chunk_t;
+
+/*
+ * Funkcja przydziela blok na dane komunikatu z puli wywołującego wątku.
+ * Blok może zostać zwolniony przez dowolny wątek funkcją message_free.
+ */
+void *message_alloc(size_t size);
+
+/*
+ * Funkcja zwalnia blok przydzielony funkcją message_alloc.
+ */
+void message_free(void *data);
+
+/*
+ * Funkcja przydziela pamięć z areny aktora actor_id_self(). Arena jest zwalniana
+ * w całości, gdy aktor przechodzi w stan martwy, więc nadaje się na jego stan.
+ * Zwraca NULL, gdy jest wywołana poza obsługą komunikatu.
+ */
+void *actor_arena_alloc(size_t size);
+
+/*
+ * Funkcja przydziela pamięć z areny.
+ */
+void *arena_alloc(arena_chunk_t **arena, size_t size);
+
+/*
+ * Funkcja zwalnia całą arenę.
+ */
+void arena_release(arena_chunk_t **arena);
+
+#endif //POOL_H
@@ -2,6 +2,10 @@
 
 #define TYPE_ message_t
 #define SUFIX_ message
+#ifdef SEGMENTED_MAILBOX
+#include "queue_segmented.def"
+#else
 #include "queue.def"
+#endif
 #undef SUFIX_
 #undef TYPE_
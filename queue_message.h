@@ -8,7 +8,15 @@
 #define TYPE_ message_t
 #define SUFIX_ message
 
+/*
+ * Z makrem SEGMENTED_MAILBOX skrzynki aktorów są kolejkami segmentowymi,
+ * które rosną bez realokacji i kopiowania komunikatów.
+ */
+#ifdef SEGMENTED_MAILBOX
+#include "queue_segmented.dec"
+#else
 #include "queue.dec"
+#endif
 
 #undef SUFIX_
 #undef TYPE_
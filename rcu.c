@@ -0,0 +1,172 @@
+#include "rcu.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "system.h"
+#include "utils.h"
+
+#define OFFLINE 0ul
+
+/*
+ * Wersja danych czekająca na zwolnienie. Może zostać zwolniona, gdy każdy
+ * wątek roboczy jest w spoczynku lub rozpoczął obsługę komunikatu w epoce
+ * co najmniej epoch.
+ */
+typedef struct retired {
+    void *data;
+    rcu_release_t release;
+    unsigned long epoch;
+    struct retired *next;
+} retired_t;
+
+/*
+ * Lista wersji czekających na zwolnienie.
+ */
+typedef struct retired_list {
+    retired_t *head;
+    pthread_mutex_t lock;
+} retired_list_t;
+
+/*
+ * Epoka zwiększana przy każdej publikacji. slots[i] to epoka, w której wątek
+ * roboczy i rozpoczął obsługę komunikatu (OFFLINE, gdy czeka na komunikat).
+ */
+static atomic_ulong epoch = 1;
+static atomic_ulong slots[POOL_SIZE];
+static atomic_size_t npending = 0;
+
+static retired_list_t retired_storage = {.head = NULL, .lock = PTHREAD_MUTEX_INITIALIZER};
+static retired_list_t *const retired = &retired_storage;
+
+/*
+ * Funkcja przekazuje wersję danych do zwolnienia po okresie karencji.
+ */
+static void retire(void *data, rcu_release_t release) {
+    int err;
+
+    retired_t *entry;
+    malloc_and_check(entry, sizeof(retired_t));
+    entry->data = data;
+    entry->release = release;
+
+    // Wątek, który zapisze epokę po tym zwiększeniu, widzi już nową wersję.
+    entry->epoch = atomic_fetch_add(&epoch, 1) + 1;
+
+    entity_shared_lock(retired);
+    entry->next = retired->head;
+    retired->head = entry;
+    atomic_fetch_add(&npending, 1);
+    entity_shared_unlock(retired);
+}
+
+rcu_t *rcu_new(void *data, rcu_release_t release) {
+    rcu_t *rcu;
+    malloc_and_check(rcu, sizeof(rcu_t));
+    atomic_init(&rcu->data, data);
+    rcu->release = release;
+
+    return rcu;
+}
+
+void *rcu_read(rcu_t *rcu) {
+    return atomic_load_explicit(&rcu->data, memory_order_acquire);
+}
+
+void rcu_publish(rcu_t *rcu, void *data) {
+    void *previous = atomic_exchange(&rcu->data, data);
+
+    if (previous != NULL && rcu->release != NULL) {
+        retire(previous, rcu->release);
+    }
+
+    rcu_reclaim(false);
+}
+
+void rcu_free(rcu_t *rcu) {
+    void *data = atomic_load(&rcu->data);
+
+    if (data != NULL && rcu->release != NULL) {
+        retire(data, rcu->release);
+    }
+
+    // Trwająca obsługa komunikatu może jeszcze odczytywać rcu->data.
+    retire(rcu, free);
+
+    rcu_reclaim(false);
+}
+
+void rcu_offline(void) {
+    atomic_store_explicit(&slots[worker_index], OFFLINE, memory_order_release);
+}
+
+void rcu_online(void) {
+    // Zapis sekwencyjnie spójny: późniejsze odczyty danych nie mogą go wyprzedzić.
+    atomic_store(&slots[worker_index], atomic_load(&epoch));
+}
+
+void rcu_synchronize(void) {
+    unsigned long current = atomic_fetch_add(&epoch, 1) + 1;
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 100000};
+
+    for (unsigned int i = 0; i < POOL_SIZE; ++i) {
+        while (true) {
+            unsigned long slot = atomic_load(&slots[i]);
+            if (slot == OFFLINE || slot >= current) {
+                break;
+            }
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+bool rcu_reclaim(bool is_final) {
+    int err;
+
+    if (atomic_load(&npending) == 0) {
+        return false;
+    }
+
+    unsigned long oldest = ULONG_MAX;
+    for (unsigned int i = 0; i < POOL_SIZE && !is_final; ++i) {
+        unsigned long slot = atomic_load(&slots[i]);
+        if (slot != OFFLINE && slot < oldest) {
+            oldest = slot;
+        }
+    }
+
+    retired_t *ready = NULL;
+
+    entity_shared_lock(retired);
+    retired_t **entry = &retired->head;
+    while (*entry != NULL) {
+        if ((*entry)->epoch <= oldest) {
+            retired_t *next = (*entry)->next;
+            (*entry)->next = ready;
+            ready = *entry;
+            *entry = next;
+            atomic_fetch_sub(&npending, 1);
+        }
+        else {
+            entry = &(*entry)->next;
+        }
+    }
+    bool is_pending = retired->head != NULL;
+    entity_shared_unlock(retired);
+
+    // Wersje są zwalniane poza blokadą, więc release może publikować dane.
+    while (ready != NULL) {
+        retired_t *next = ready->next;
+        ready->release(ready->data);
+        free(ready);
+        ready = next;
+    }
+
+    return is_pending;
+}
+
+bool rcu_is_pending(void) {
+    return atomic_load(&npending) > 0;
+}
@@ -0,0 +1,84 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/*
+ * Maksymalny odstęp (w milisekundach) między próbami zwolnienia zastąpionych
+ * wersji danych przez wątek kontrolny.
+ */
+#ifndef RCU_INTERVAL
+#define RCU_INTERVAL 10
+#endif
+
+/*
+ * Funkcja zwalniająca wersję danych.
+ */
+typedef void (*rcu_release_t)(void *data);
+
+/*
+ * Współdzielone dane tylko do odczytu (np. konfiguracja lub tablica routingu),
+ * publikowane wszystkim aktorom. Odczyt z obsługi komunikatu to jedno pobranie
+ * wskaźnika; nowa wersja jest publikowana atomowo, a poprzednia zwalniana
+ * (przez release) dopiero, gdy każdy wątek roboczy zakończy obsługę komunikatu
+ * rozpoczętą przed publikacją (punktem spoczynku wątku jest oczekiwanie
+ * na kolejny komunikat).
+ */
+typedef struct rcu {
+    _Atomic(void *) data;
+    rcu_release_t release;
+} rcu_t;
+
+/*
+ * Funkcja tworzy współdzielone dane z pierwszą wersją data.
+ */
+rcu_t *rcu_new(void *data, rcu_release_t release);
+
+/*
+ * Funkcja zwraca obecną wersję danych. Wersja pozostaje ważna do końca obsługi
+ * komunikatu (lub do wstrzymania jej w actor_await) i nie może być modyfikowana.
+ * Poza obsługą komunikatu wynik jest ważny, dopóki wywołujący sam nie
+ * opublikuje nowej wersji.
+ */
+void *rcu_read(rcu_t *rcu);
+
+/*
+ * Funkcja publikuje nową wersję danych, a poprzednią przekazuje do zwolnienia
+ * po okresie karencji. Może być wywoływana z obsługi komunikatu i spoza systemu.
+ */
+void rcu_publish(rcu_t *rcu, void *data);
+
+/*
+ * Funkcja zwalnia współdzielone dane (obecną wersję po okresie karencji).
+ */
+void rcu_free(rcu_t *rcu);
+
+/*
+ * Funkcje oznaczają początek oczekiwania wątku roboczego worker_index na
+ * komunikat (od tej chwili wątek nie korzysta ze współdzielonych danych)
+ * i jego koniec.
+ */
+void rcu_offline(void);
+
+void rcu_online(void);
+
+/*
+ * Funkcja czeka, aż każdy wątek roboczy zakończy obsługę komunikatu rozpoczętą
+ * przed jej wywołaniem. Nie może być wywoływana z obsługi komunikatu.
+ */
+void rcu_synchronize(void);
+
+/*
+ * Funkcja zwalnia wersje, których okres karencji minął
+ * (wszystkie, gdy is_final - po zatrzymaniu wątków roboczych).
+ * Zwraca true, gdy pozostały wersje czekające na zwolnienie.
+ */
+bool rcu_reclaim(bool is_final);
+
+/*
+ * Funkcja sprawdza, czy są wersje czekające na zwolnienie.
+ */
+bool rcu_is_pending(void);
+
+#endif //RCU_H
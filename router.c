@@ -0,0 +1,525 @@
+#include "router.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pool.h"
+#include "system.h"
+#include "utils.h"
+
+/*
+ * Interakcja między aktorami:
+ * Nadawcy wysyłają routerowi komunikaty z kluczem (MSG_ROUTER_ROUTE), a router
+ * przekazuje je aktorowi docelowemu wskazanemu przez pierścień haszujący.
+ * Zmiany zbioru aktorów docelowych (MSG_ROUTER_ADD, MSG_ROUTER_REMOVE) przechodzą
+ * przez skrzynkę routera, więc są uporządkowane względem kierowanych komunikatów.
+ * MSG_ROUTER_STOP kończy działanie routera i utworzonych przez niego aktorów.
+ */
+
+#define MSG_ROUTER_ROUTE (message_type_t) 0x1
+#define MSG_ROUTER_ADD (message_type_t) 0x2
+#define MSG_ROUTER_REMOVE (message_type_t) 0x3
+#define MSG_ROUTER_STOP (message_type_t) 0x4
+
+typedef struct route {
+    long key;
+    message_t message;
+} route_t;
+
+/*
+ * Punkt pierścienia haszującego. slot to pozycja aktora w tablicy routees.
+ */
+typedef struct point {
+    uint64_t hash;
+    actor_id_t routee;
+    size_t slot;
+} point_t;
+
+/*
+ * Klucz śledzony przez algorytm Space-Saving (count == 0 oznacza wolne miejsce).
+ * Ruch klucza jest dzielony między ways kolejnych aktorów na pierścieniu.
+ */
+typedef struct hot_key {
+    long key;
+    unsigned long count;
+    unsigned int ways;
+    unsigned int next;
+} hot_key_t;
+
+/*
+ * Stan routera. total to suma liczników kluczy (zmniejszana razem z nimi),
+ * owned - aktorzy utworzeni przez router. order to kolejni różni aktorzy na
+ * pierścieniu wyznaczeni przez ring_walk, a seen - numery przejść (stamp),
+ * w których aktorzy z tablicy routees zostali już napotkani.
+ */
+typedef struct router {
+    router_config_t config;
+    actor_id_t *routees;
+    size_t nroutees, routees_size;
+    actor_id_t *order;
+    unsigned long *seen;
+    unsigned long stamp;
+    actor_id_t *owned;
+    size_t nowned, owned_size;
+    point_t *points;
+    size_t npoints;
+    hot_key_t hot[ROUTER_HOT_KEYS];
+    unsigned long total;
+    unsigned long routed;
+    bool is_stopped;
+} router_t;
+
+static void router_hello(router_t **stateptr, size_t nbytes, void *data);
+
+static void route(router_t **stateptr, size_t nbytes, route_t *data);
+
+static void attach(router_t **stateptr, size_t nbytes, void *data);
+
+static void detach(router_t **stateptr, size_t nbytes, void *data);
+
+static void stop(router_t **stateptr, size_t nbytes, void *data);
+
+static role_t router_role = {
+        .nprompts = 5,
+        .prompts = (act_t[5]) {
+                (act_t) router_hello,
+                (act_t) route,
+                (act_t) attach,
+                (act_t) detach,
+                (act_t) stop
+        }
+};
+
+static message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
+
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ value >> 30) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ value >> 27) * 0x94D049BB133111EBull;
+    return value ^ value >> 31;
+}
+
+static int compare_points(const void *a, const void *b) {
+    uint64_t hash_a = ((const point_t *) a)->hash;
+    uint64_t hash_b = ((const point_t *) b)->hash;
+    return hash_a < hash_b ? -1 : hash_a > hash_b ? 1 : 0;
+}
+
+static size_t depth_limit(const router_t *router) {
+    return router->config.depth_limit == 0 ? ROUTER_DEPTH_LIMIT : router->config.depth_limit;
+}
+
+static unsigned int split_limit(const router_t *router) {
+    unsigned int limit = router->config.split_limit == 0 ? ROUTER_SPLIT_LIMIT : router->config.split_limit;
+    return limit < router->nroutees ? limit : (unsigned int) router->nroutees;
+}
+
+static bool is_routee(const router_t *router, actor_id_t routee) {
+    for (size_t i = 0; i < router->nroutees; ++i) {
+        if (router->routees[i] == routee) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Funkcja dodaje aktora docelowego wraz z jego punktami na pierścieniu.
+ */
+static void add_routee(router_t *router, actor_id_t routee) {
+    if (routee <= 0 || is_routee(router, routee)) {
+        return;
+    }
+
+    if (router->nroutees == router->routees_size) {
+        router->routees_size = router->routees_size == 0 ? 4 : 2 * router->routees_size;
+        realloc_and_check(router->routees, router->routees_size * sizeof(actor_id_t));
+        realloc_and_check(router->order, router->routees_size * sizeof(actor_id_t));
+        realloc_and_check(router->seen, router->routees_size * sizeof(unsigned long));
+    }
+    size_t slot = router->nroutees++;
+    router->routees[slot] = routee;
+    router->seen[slot] = 0;
+
+    realloc_and_check(router->points, (router->npoints + ROUTER_VNODES) * sizeof(point_t));
+    for (uint64_t i = 0; i < ROUTER_VNODES; ++i) {
+        router->points[router->npoints++] = (point_t) {
+                .hash = mix((uint64_t) routee * ROUTER_VNODES + i),
+                .routee = routee,
+                .slot = slot
+        };
+    }
+
+    qsort(router->points, router->npoints, sizeof(point_t), compare_points);
+}
+
+/*
+ * Funkcja usuwa aktora docelowego; pozostałe punkty pierścienia zachowują kolejność.
+ */
+static void remove_routee(router_t *router, actor_id_t routee) {
+    size_t slot = 0;
+    while (slot < router->nroutees && router->routees[slot] != routee) {
+        ++slot;
+    }
+
+    if (slot == router->nroutees) {
+        return;
+    }
+
+    for (size_t i = slot + 1; i < router->nroutees; ++i) {
+        router->routees[i - 1] = router->routees[i];
+        router->seen[i - 1] = router->seen[i];
+    }
+    router->nroutees--;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < router->npoints; ++i) {
+        point_t point = router->points[i];
+
+        if (point.routee != routee) {
+            point.slot -= point.slot > slot;
+            router->points[kept++] = point;
+        }
+    }
+    router->npoints = kept;
+}
+
+/*
+ * Funkcja zwraca pozycję pierwszego punktu pierścienia nie mniejszego niż hash.
+ */
+static size_t ring_find(const router_t *router, uint64_t hash) {
+    size_t begin = 0, end = router->npoints;
+
+    while (begin < end) {
+        size_t middle = begin + (end - begin) / 2;
+        if (router->points[middle].hash < hash) {
+            begin = middle + 1;
+        }
+        else {
+            end = middle;
+        }
+    }
+
+    return begin == router->npoints ? 0 : begin;
+}
+
+/*
+ * Funkcja zapisuje w order pierwszych count różnych aktorów na pierścieniu,
+ * licząc od punktu index, w jednym przejściu po pierścieniu. Wymaga count <= nroutees.
+ */
+static void ring_walk(router_t *router, size_t index, size_t count) {
+    size_t nfound = 0;
+
+    router->stamp++;
+    for (size_t i = 0; nfound < count; ++i) {
+        const point_t *point = &router->points[(index + i) % router->npoints];
+
+        if (router->seen[point->slot] != router->stamp) {
+            router->seen[point->slot] = router->stamp;
+            router->order[nfound++] = point->routee;
+        }
+    }
+}
+
+/*
+ * Funkcja zlicza wystąpienie klucza (Space-Saving: nowy klucz zastępuje klucz
+ * o najmniejszym liczniku i przejmuje jego licznik) i zwraca jego wpis.
+ */
+static hot_key_t *track(router_t *router, long key) {
+    hot_key_t *least = &router->hot[0];
+
+    router->total++;
+
+    for (size_t i = 0; i < ROUTER_HOT_KEYS; ++i) {
+        hot_key_t *hot = &router->hot[i];
+
+        if (hot->count != 0 && hot->key == key) {
+            hot->count++;
+            return hot;
+        }
+
+        if (hot->count < least->count) {
+            least = hot;
+        }
+    }
+
+    least->key = key;
+    least->count++;
+    least->ways = 1;
+    least->next = 0;
+
+    return least;
+}
+
+/*
+ * Klucz jest gorący, gdy jego udział w ruchu jest co najmniej udziałem jednego aktora.
+ */
+static bool is_hot(const router_t *router, const hot_key_t *hot) {
+    return hot->count * router->nroutees >= router->total;
+}
+
+/*
+ * Funkcja wybiera, któremu z aktorów dzielących ruch klucza przekazać komunikat.
+ * Ruch gorącego klucza jest dzielony między dwukrotnie więcej aktorów, gdy aktor
+ * wybrany w tej kolejce ma przepełnioną skrzynkę.
+ */
+static unsigned int choose_way(router_t *router, long key, size_t index) {
+    hot_key_t *hot = track(router, key);
+
+    if (hot->ways < split_limit(router) && is_hot(router, hot)) {
+        size_t n = hot->next % hot->ways;
+        ring_walk(router, index, n + 1);
+
+        if (actor_system_mailbox_length(router->order[n]) > depth_limit(router)) {
+            hot->ways = 2 * hot->ways < split_limit(router) ? 2 * hot->ways : split_limit(router);
+        }
+    }
+
+    return hot->ways == 1 ? 0 : hot->next++ % hot->ways;
+}
+
+/*
+ * Funkcja tworzy nowego aktora docelowego (jeśli router ma jego rolę i nie
+ * osiągnął max_routees).
+ */
+static void grow(router_t *router) {
+    if (router->config.routee_role == NULL || router->nroutees >= router->config.max_routees) {
+        return;
+    }
+
+    actor_id_t routee = spawn_many(router->config.routee_role, 1, router->config.routee_data);
+    if (routee < 0) {
+        return;
+    }
+
+    if (router->nowned == router->owned_size) {
+        router->owned_size = router->owned_size == 0 ? 4 : 2 * router->owned_size;
+        realloc_and_check(router->owned, router->owned_size * sizeof(actor_id_t));
+    }
+    router->owned[router->nowned++] = routee;
+
+    add_routee(router, routee);
+}
+
+/*
+ * Funkcja przekazuje komunikat, którego router nie przekazał żadnemu aktorowi
+ * docelowemu, funkcji undelivered z konfiguracji (bez niej komunikat jest porzucany).
+ */
+static void undelivered(const router_t *router, long key, message_t message) {
+    if (router->config.undelivered != NULL) {
+        router->config.undelivered(key, message);
+    }
+}
+
+/*
+ * Funkcja przekazuje komunikat aktorowi docelowemu. Martwi aktorzy są usuwani
+ * z pierścienia, a komunikat do aktora z pełną skrzynką trafia do kolejnego
+ * aktora na pierścieniu.
+ */
+static void forward(router_t *router, long key, message_t message) {
+    if (router->nroutees == 0) {
+        grow(router);
+    }
+
+    if (router->nroutees == 0) {
+        undelivered(router, key, message);
+        return;
+    }
+
+    size_t index = ring_find(router, mix((uint64_t) key));
+    size_t nroutees = router->nroutees;
+    size_t first = choose_way(router, key, index) % nroutees;
+
+    // Zwykle wystarcza wybrany aktor; pozostali są wyznaczani dopiero po pierwszym
+    // niepowodzeniu, zanim pierścień się zmieni.
+    size_t nwalked = first + 1;
+    ring_walk(router, index, nwalked);
+
+    for (size_t attempt = 0; attempt < nroutees; ++attempt) {
+        actor_id_t routee = router->order[(first + attempt) % nroutees];
+
+        int err = send_message(routee, message);
+        if (err >= 0) {
+            return;
+        }
+
+        if (nwalked < nroutees) {
+            nwalked = nroutees;
+            ring_walk(router, index, nwalked);
+        }
+
+        if (err == -1 || err == -2) {
+            // Aktor nie przyjmuje już komunikatów.
+            remove_routee(router, routee);
+        }
+        else if (err != -3) {
+            // System aktorów nie przyjmuje komunikatów.
+            break;
+        }
+    }
+
+    undelivered(router, key, message);
+}
+
+/*
+ * Funkcja kończy okno ROUTER_WINDOW komunikatów: zmniejsza liczniki kluczy,
+ * scala ruch kluczy, które przestały być gorące, i w razie przeciążenia
+ * aktorów docelowych tworzy nowego.
+ */
+static void rebalance(router_t *router) {
+    router->total /= 2;
+
+    for (size_t i = 0; i < ROUTER_HOT_KEYS; ++i) {
+        hot_key_t *hot = &router->hot[i];
+        hot->count /= 2;
+
+        if (hot->ways > 1 && !is_hot(router, hot)) {
+            hot->ways = 1;
+        }
+    }
+
+    if (router->config.routee_role == NULL || router->nroutees >= router->config.max_routees) {
+        return;
+    }
+
+    size_t depth = 0;
+    for (size_t i = 0; i < router->nroutees; ++i) {
+        depth += actor_system_mailbox_length(router->routees[i]);
+    }
+
+    if (router->nroutees > 0 && depth / router->nroutees <= depth_limit(router)) {
+        return;
+    }
+
+    grow(router);
+}
+
+static void router_hello(router_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    // Stan routera, przekazany przez spawn_many, trafia do areny aktora: po zatrzymaniu
+    // jest potrzebny do obsługi komunikatów wysłanych wcześniej, aż do śmierci aktora.
+    router_t *router = actor_arena_alloc(sizeof(router_t));
+    *router = **stateptr;
+    free(*stateptr);
+    *stateptr = router;
+}
+
+static void route(router_t **stateptr, UNUSED size_t nbytes, route_t *data) {
+    router_t *router = *stateptr;
+    route_t request = *data;
+    message_free(data);
+
+    if (router->is_stopped) {
+        undelivered(router, request.key, request.message);
+        return;
+    }
+
+    forward(router, request.key, request.message);
+
+    if (++router->routed % ROUTER_WINDOW == 0) {
+        rebalance(router);
+    }
+}
+
+static void attach(router_t **stateptr, UNUSED size_t nbytes, void *data) {
+    if (!(*stateptr)->is_stopped) {
+        add_routee(*stateptr, (actor_id_t) data);
+    }
+}
+
+static void detach(router_t **stateptr, UNUSED size_t nbytes, void *data) {
+    if (!(*stateptr)->is_stopped) {
+        remove_routee(*stateptr, (actor_id_t) data);
+    }
+}
+
+/*
+ * Funkcja zwalnia tablice routera (sam stan jest w arenie aktora).
+ */
+static void router_free(router_t *router) {
+    free(router->routees);
+    free(router->order);
+    free(router->seen);
+    free(router->owned);
+    free(router->points);
+}
+
+static void stop(router_t **stateptr, UNUSED size_t nbytes, UNUSED void *data) {
+    router_t *router = *stateptr;
+
+    if (router->is_stopped) {
+        return;
+    }
+
+    for (size_t i = 0; i < router->nowned; ++i) {
+        send_message(router->owned[i], msg_godie);
+    }
+
+    router_free(router);
+    router->is_stopped = true;
+
+    send_message(actor_id_self(), msg_godie);
+}
+
+actor_id_t router_spawn(const router_config_t *config) {
+    router_t *router;
+    malloc_and_check(router, sizeof(router_t));
+
+    router->config = *config;
+    router->config.routees = NULL;
+    router->routees = NULL;
+    router->nroutees = 0;
+    router->routees_size = 0;
+    router->order = NULL;
+    router->seen = NULL;
+    router->stamp = 0;
+    router->owned = NULL;
+    router->nowned = 0;
+    router->owned_size = 0;
+    router->points = NULL;
+    router->npoints = 0;
+    router->total = 0;
+    router->routed = 0;
+    router->is_stopped = false;
+
+    for (size_t i = 0; i < ROUTER_HOT_KEYS; ++i) {
+        router->hot[i] = (hot_key_t) {.key = 0, .count = 0, .ways = 1, .next = 0};
+    }
+
+    for (size_t i = 0; i < config->nroutees; ++i) {
+        add_routee(router, config->routees[i]);
+    }
+
+    actor_id_t actor = spawn_many(&router_role, 1, router);
+    if (actor < 0) {
+        router_free(router);
+        free(router);
+    }
+
+    return actor;
+}
+
+int router_send(actor_id_t router, long key, message_t message) {
+    route_t *route = message_alloc(sizeof(route_t));
+    route->key = key;
+    route->message = message;
+
+    int err = send_message(router, (message_t) {MSG_ROUTER_ROUTE, sizeof(route_t), route});
+    if (err != 0) {
+        message_free(route);
+    }
+
+    return err;
+}
+
+int router_add(actor_id_t router, actor_id_t routee) {
+    return send_message(router, (message_t) {MSG_ROUTER_ADD, sizeof(actor_id_t), (void *) routee});
+}
+
+int router_remove(actor_id_t router, actor_id_t routee) {
+    return send_message(router, (message_t) {MSG_ROUTER_REMOVE, sizeof(actor_id_t), (void *) routee});
+}
+
+int router_stop(actor_id_t router) {
+    return send_message(router, (message_t) {MSG_ROUTER_STOP, sizeof(NULL), NULL});
+}
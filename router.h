@@ -0,0 +1,98 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+
+#include "cacti.h"
+
+/*
+ * Liczba punktów aktora docelowego na pierścieniu haszującym.
+ */
+#ifndef ROUTER_VNODES
+#define ROUTER_VNODES 64
+#endif
+
+/*
+ * Liczba najczęstszych kluczy śledzonych przez router.
+ */
+#ifndef ROUTER_HOT_KEYS
+#define ROUTER_HOT_KEYS 16
+#endif
+
+/*
+ * Liczba komunikatów, po której router zmniejsza o połowę liczniki kluczy
+ * i sprawdza obciążenie aktorów docelowych.
+ */
+#ifndef ROUTER_WINDOW
+#define ROUTER_WINDOW 1024
+#endif
+
+/*
+ * Domyślna liczba komunikatów w skrzynce aktora docelowego, powyżej której
+ * jest on uznawany za przeciążony.
+ */
+#ifndef ROUTER_DEPTH_LIMIT
+#define ROUTER_DEPTH_LIMIT 64
+#endif
+
+/*
+ * Domyślna maksymalna liczba aktorów docelowych, między których jest dzielony
+ * ruch jednego klucza.
+ */
+#ifndef ROUTER_SPLIT_LIMIT
+#define ROUTER_SPLIT_LIMIT 4
+#endif
+
+/*
+ * Opis routera. Komunikaty są kierowane do aktorów routees według spójnego
+ * haszowania klucza, więc dodanie lub usunięcie aktora przenosi tylko klucze
+ * z jego części pierścienia. Gdy routee_role != NULL, a średnia liczba komunikatów
+ * w skrzynkach przekracza depth_limit, router tworzy (spawn_many z routee_data)
+ * kolejnych aktorów, aż do max_routees.
+ * Gorący klucz (klucz o udziale w ruchu co najmniej równym udziałowi jednego
+ * aktora), którego aktor jest przeciążony, jest dzielony między kolejnych aktorów
+ * na pierścieniu (co najwyżej split_limit, 1 wyłącza dzielenie) - komunikaty
+ * takiego klucza mogą być wtedy obsługiwane w innej kolejności niż wysłane.
+ * Komunikat, którego router nie przekazał żadnemu aktorowi docelowemu (także
+ * wysłany przed zatrzymaniem routera, a obsłużony po nim), jest przekazywany
+ * funkcji undelivered (np. aby zwolnić jego dane), a gdy undelivered == NULL - porzucany.
+ * Wartości 0 oznaczają domyślne limity.
+ */
+typedef struct router_config {
+    const actor_id_t *routees;
+    size_t nroutees;
+    role_t *routee_role;
+    void *routee_data;
+    size_t max_routees;
+    size_t depth_limit;
+    unsigned int split_limit;
+    void (*undelivered)(long key, message_t message);
+} router_config_t;
+
+/*
+ * Funkcja tworzy aktora routera (konfiguracja jest kopiowana).
+ * Zwraca jego id lub kody błędów spawn_many.
+ */
+actor_id_t router_spawn(const router_config_t *config);
+
+/*
+ * Funkcja wysyła komunikat przez router do aktora wybranego według klucza key.
+ * Zwraca kody błędów send_message dla aktora routera (wtedy komunikat nie trafia
+ * do funkcji undelivered).
+ */
+int router_send(actor_id_t router, long key, message_t message);
+
+/*
+ * Funkcje dodają i usuwają aktora docelowego routera.
+ */
+int router_add(actor_id_t router, actor_id_t routee);
+
+int router_remove(actor_id_t router, actor_id_t routee);
+
+/*
+ * Funkcja kończy działanie routera i utworzonych przez niego aktorów
+ * docelowych (po obsłużeniu wcześniej wysłanych komunikatów).
+ */
+int router_stop(actor_id_t router);
+
+#endif //ROUTER_H
@@ -1,8 +1,12 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "cacti.h"
 #include "err.h"
+#include "pool.h"
 #include "utils.h"
 
 /*
@@ -11,13 +15,55 @@
  * B wysyła MSG_READY ze swoim actor_id_t (id ojca otrzymał w MSG_HELLO).
  * A dokonuje obliczeń, wysyła ich wynik do B (MSG_EXECUTE) i wysyła do siebie MSG_GODIE.
  * Trwa to do momentu policzenia silni. Wtedy aktor wywołujący MSG_EXECUTE wypisuje wynik i umiera.
+ *
+ * Tryb drzewa iloczynów (silnia -t):
+ * Aktor otrzymuje przedział [lo, hi] (MSG_RANGE). Krótki przedział mnoży sam, dłuższy dzieli
+ * na połowy i tworzy dwóch potomków, którym po otrzymaniu MSG_READY przekazuje połowy.
+ * Potomkowie odsyłają iloczyny (MSG_RESULT) jako liczby dowolnej precyzji, a rodzic
+ * mnoży je i przekazuje wynik wyżej. Korzeń drzewa wypisuje n!.
  */
 
 #define MSG_EXECUTE (message_type_t) 0x01
 #define MSG_READY (message_type_t) 0x02
 
+#define MSG_RANGE (message_type_t) 0x01
+#define MSG_RESULT (message_type_t) 0x03
+
+/*
+ * Liczby dowolnej precyzji są zapisywane w systemie o podstawie 10^9 (cyfry od najmniej znaczącej).
+ */
+#define LIMB_BASE 1000000000u
+#define LIMB_DIGITS 9
+
+/*
+ * Poniżej tej liczby cyfr mnożenie jest szkolne, powyżej - metodą Karacuby.
+ */
+#define KARATSUBA_THRESHOLD 48
+
+/*
+ * Przedziały nie dłuższe niż LEAF_RANGE są mnożone przez jednego aktora.
+ */
+#define LEAF_RANGE 512
+
 typedef int num_t;
 typedef long fact_t;
+typedef uint32_t limb_t;
+
+typedef struct bigint {
+    size_t size, capacity;
+    limb_t *limbs;
+} bigint_t;
+
+typedef struct range {
+    num_t lo, hi;
+} range_t;
+
+typedef struct node {
+    actor_id_t parent;
+    range_t range;
+    int nchildren;
+    bigint_t *partial;
+} node_t;
 
 typedef struct execute_info {
     num_t k;
@@ -40,7 +86,26 @@ role_t role = {
         }
 };
 
+void node_hello(node_t **stateptr, size_t nbytes, void *data);
+
+void node_range(node_t **stateptr, size_t nbytes, range_t *data);
+
+void node_ready(node_t **stateptr, size_t nbytes, void *data);
+
+void node_result(node_t **stateptr, size_t nbytes, bigint_t *data);
+
+role_t tree_role = {
+        .nprompts = 4,
+        .prompts = (act_t[4]) {
+                (act_t) node_hello,
+                (act_t) node_range,
+                (act_t) node_ready,
+                (act_t) node_result
+        }
+};
+
 message_t msg_spawn = {MSG_SPAWN, sizeof(role_t), &role};
+message_t msg_spawn_node = {MSG_SPAWN, sizeof(role_t), &tree_role};
 message_t msg_godie = {MSG_GODIE, sizeof(NULL), NULL};
 
 void hello(UNUSED execute_info_t **stateptr, UNUSED size_t nbytes, void *data) {
@@ -81,7 +146,299 @@ void ready(execute_info_t **stateptr, UNUSED size_t nbytes, void *data) {
     send_message(actor_id_self(), msg_godie);
 }
 
-int main() {
+/*
+ * Funkcja zwraca liczbę cyfr a bez zer wiodących.
+ */
+static size_t trim(const limb_t *a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+        --n;
+    }
+    return n;
+}
+
+/*
+ * Funkcja dodaje n cyfr a do r. Przeniesienie musi się zmieścić w r.
+ */
+static void add_into(limb_t *r, const limb_t *a, size_t n) {
+    limb_t carry = 0;
+    size_t i = 0;
+
+    for (; i < n; ++i) {
+        limb_t sum = r[i] + a[i] + carry;
+        carry = sum >= LIMB_BASE;
+        r[i] = carry ? sum - LIMB_BASE : sum;
+    }
+
+    for (; carry; ++i) {
+        limb_t sum = r[i] + 1;
+        carry = sum == LIMB_BASE;
+        r[i] = carry ? 0 : sum;
+    }
+}
+
+/*
+ * Funkcja odejmuje n cyfr a od r (r nie może być mniejsze od a).
+ */
+static void sub_from(limb_t *r, const limb_t *a, size_t n) {
+    limb_t borrow = 0;
+    size_t i = 0;
+
+    for (; i < n; ++i) {
+        limb_t subtrahend = a[i] + borrow;
+        borrow = r[i] < subtrahend;
+        r[i] = borrow ? r[i] + LIMB_BASE - subtrahend : r[i] - subtrahend;
+    }
+
+    for (; borrow; ++i) {
+        borrow = r[i] == 0;
+        r[i] = borrow ? LIMB_BASE - 1 : r[i] - 1;
+    }
+}
+
+/*
+ * Funkcja zapisuje iloczyn a i b w wyzerowanym r o na + nb cyfrach.
+ */
+static void multiply(const limb_t *a, size_t na, const limb_t *b, size_t nb, limb_t *r) {
+    if (na < nb) {
+        const limb_t *t = a;
+        a = b;
+        b = t;
+        size_t nt = na;
+        na = nb;
+        nb = nt;
+    }
+
+    if (nb == 0) {
+        return;
+    }
+
+    if (nb < KARATSUBA_THRESHOLD) {
+        for (size_t i = 0; i < na; ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < nb; ++j) {
+                uint64_t t = (uint64_t) a[i] * b[j] + r[i + j] + carry;
+                r[i + j] = t % LIMB_BASE;
+                carry = t / LIMB_BASE;
+            }
+            r[i + nb] = carry;
+        }
+        return;
+    }
+
+    if (na >= 2 * nb) {
+        // Czynniki bardzo różnej długości - a jest mnożone kawałkami długości b.
+        limb_t *t;
+        malloc_and_check(t, 2 * nb * sizeof(limb_t));
+
+        for (size_t offset = 0; offset < na; offset += nb) {
+            size_t length = na - offset < nb ? na - offset : nb;
+            memset(t, 0, (length + nb) * sizeof(limb_t));
+            multiply(a + offset, length, b, nb, t);
+            add_into(r + offset, t, trim(t, length + nb));
+        }
+
+        free(t);
+        return;
+    }
+
+    // a = a0 + a1 * B^m, b = b0 + b1 * B^m, ab = z0 + z1 * B^m + z2 * B^2m
+    size_t m = na / 2;
+    size_t na1 = na - m, nb1 = nb - m;
+    multiply(a, m, b, m, r);
+    multiply(a + m, na1, b + m, nb1, r + 2 * m);
+
+    size_t ns1 = na1 + 1, ns2 = (m > nb1 ? m : nb1) + 1;
+    limb_t *s1 = calloc(ns1 + ns2 + ns1 + ns2, sizeof(limb_t));
+    if (s1 == NULL) {
+        syserr(-1, "calloc failed");
+    }
+    limb_t *s2 = s1 + ns1, *z1 = s2 + ns2;
+
+    memcpy(s1, a + m, na1 * sizeof(limb_t));
+    add_into(s1, a, m);
+
+    if (m > nb1) {
+        memcpy(s2, b, m * sizeof(limb_t));
+        add_into(s2, b + m, nb1);
+    }
+    else {
+        memcpy(s2, b + m, nb1 * sizeof(limb_t));
+        add_into(s2, b, m);
+    }
+
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2
+    multiply(s1, trim(s1, ns1), s2, trim(s2, ns2), z1);
+    sub_from(z1, r, trim(r, 2 * m));
+    sub_from(z1, r + 2 * m, trim(r + 2 * m, na1 + nb1));
+    add_into(r + m, z1, trim(z1, ns1 + ns2));
+
+    free(s1);
+}
+
+static bigint_t *bigint_new(size_t capacity) {
+    bigint_t *x;
+    malloc_and_check(x, sizeof(bigint_t));
+    x->limbs = calloc(capacity, sizeof(limb_t));
+    if (x->limbs == NULL) {
+        syserr(-1, "calloc failed");
+    }
+    x->size = 0;
+    x->capacity = capacity;
+    return x;
+}
+
+static void bigint_free(bigint_t *x) {
+    free(x->limbs);
+    free(x);
+}
+
+static bigint_t *bigint_multiply(const bigint_t *x, const bigint_t *y) {
+    bigint_t *r = bigint_new(x->size + y->size);
+    multiply(x->limbs, x->size, y->limbs, y->size, r->limbs);
+    r->size = trim(r->limbs, r->capacity);
+    return r;
+}
+
+/*
+ * Funkcja mnoży x przez liczbę mniejszą od LIMB_BASE.
+ */
+static void bigint_multiply_small(bigint_t *x, uint64_t factor) {
+    uint64_t carry = 0;
+
+    for (size_t i = 0; i < x->size; ++i) {
+        uint64_t t = x->limbs[i] * factor + carry;
+        x->limbs[i] = t % LIMB_BASE;
+        carry = t / LIMB_BASE;
+    }
+
+    if (carry > 0) {
+        if (x->size == x->capacity) {
+            x->capacity *= 2;
+            realloc_and_check(x->limbs, x->capacity * sizeof(limb_t));
+        }
+        x->limbs[x->size++] = carry;
+    }
+}
+
+static void bigint_print(const bigint_t *x) {
+    printf("%u", x->size > 0 ? x->limbs[x->size - 1] : 0);
+
+    for (size_t i = x->size - 1; i-- > 0;) {
+        printf("%0*u", LIMB_DIGITS, x->limbs[i]);
+    }
+
+    printf("\n");
+}
+
+/*
+ * Funkcja mnoży liczby z przedziału [lo, hi], łącząc czynniki w iloczyny mniejsze od LIMB_BASE.
+ */
+static bigint_t *range_product(range_t range) {
+    bigint_t *product = bigint_new(16);
+    product->limbs[0] = 1;
+    product->size = 1;
+
+    uint64_t factor = 1;
+    for (uint64_t i = range.lo; i <= (uint64_t) range.hi; ++i) {
+        if (factor * i >= LIMB_BASE) {
+            bigint_multiply_small(product, factor);
+            factor = 1;
+        }
+        factor *= i;
+    }
+    bigint_multiply_small(product, factor);
+
+    return product;
+}
+
+/*
+ * Funkcja przekazuje iloczyn przedziału rodzicowi (korzeń wypisuje wynik).
+ */
+static void node_finish(node_t *node, bigint_t *product) {
+    if (node->parent == -1) {
+        bigint_print(product);
+        bigint_free(product);
+    }
+    else {
+        send_message(node->parent, (message_t) {
+                MSG_RESULT, sizeof(bigint_t), product
+        });
+    }
+
+    send_message(actor_id_self(), msg_godie);
+}
+
+void node_hello(node_t **stateptr, UNUSED size_t nbytes, void *data) {
+    *stateptr = actor_arena_alloc(sizeof(node_t));
+    node_t *node = *stateptr;
+    node->parent = (actor_id_t) data;
+    node->nchildren = 0;
+    node->partial = NULL;
+
+    if (node->parent != -1) {
+        send_message(node->parent, (message_t) {
+                MSG_READY, sizeof(actor_id_t), (void *) actor_id_self()
+        });
+    }
+}
+
+void node_range(node_t **stateptr, UNUSED size_t nbytes, range_t *data) {
+    node_t *node = *stateptr;
+    node->range = *data;
+    message_free(data);
+
+    if (node->range.hi - node->range.lo < LEAF_RANGE) {
+        *stateptr = NULL;
+        node_finish(node, range_product(node->range));
+        return;
+    }
+
+    send_message(actor_id_self(), msg_spawn_node);
+    send_message(actor_id_self(), msg_spawn_node);
+}
+
+void node_ready(node_t **stateptr, UNUSED size_t nbytes, void *data) {
+    node_t *node = *stateptr;
+    actor_id_t child = (actor_id_t) data;
+    num_t middle = node->range.lo + (node->range.hi - node->range.lo) / 2;
+
+    range_t *range = message_alloc(sizeof(range_t));
+    *range = node->nchildren++ == 0
+             ? (range_t) {node->range.lo, middle}
+             : (range_t) {middle + 1, node->range.hi};
+
+    send_message(child, (message_t) {
+            MSG_RANGE, sizeof(range_t), range
+    });
+}
+
+void node_result(node_t **stateptr, UNUSED size_t nbytes, bigint_t *data) {
+    node_t *node = *stateptr;
+
+    if (node->partial == NULL) {
+        node->partial = data;
+        return;
+    }
+
+    bigint_t *product = bigint_multiply(node->partial, data);
+    bigint_free(node->partial);
+    bigint_free(data);
+
+    *stateptr = NULL;
+    node_finish(node, product);
+}
+
+int main(int argc, char *argv[]) {
+    bool is_tree = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t")) != -1) {
+        if (opt != 't') {
+            fprintf(stderr, "usage: %s [-t]\n", argv[0]);
+            return -1;
+        }
+        is_tree = true;
+    }
+
     num_t n;
 
     scanf("%d", &n);
@@ -94,6 +451,23 @@ int main() {
     int err;
     actor_id_t actor_id;
 
+    if (is_tree) {
+        if ((err = actor_system_create(&actor_id, &tree_role)) != 0) {
+            syserr(err, "actor system create failed");
+        }
+
+        range_t *range = message_alloc(sizeof(range_t));
+        *range = (range_t) {1, n};
+
+        send_message(actor_id, (message_t) {
+                MSG_RANGE, sizeof(range_t), range
+        });
+
+        actor_system_join(actor_id);
+
+        return 0;
+    }
+
     if ((err = actor_system_create(&actor_id, &role)) != 0) {
         syserr(err, "actor system create failed");
     }
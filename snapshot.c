@@ -0,0 +1,820 @@
+#define _GNU_SOURCE
+
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hibernate.h"
+#include "rcu.h"
+#include "system.h"
+#include "utils.h"
+
+#define SNAPSHOT_MAGIC 0x504E534954434143 // "CACTISNP"
+#define SNAPSHOT_VERSION 2
+#define BUFFER_STARTING_SIZE 4096
+#define NO_ROLE (int64_t)-1
+
+#define ALIGN(size) (((size) + 7) & ~(size_t) 7)
+
+/*
+ * Nagłówek pliku migawki.
+ */
+typedef struct snapshot_header {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t nactors;
+} snapshot_header_t;
+
+/*
+ * Zapis aktora w migawce. Po nim następuje stan aktora (state_size bajtów,
+ * o ile różne od SERIALIZE_SKIP) oraz nmessages zapisów komunikatów.
+ */
+typedef struct actor_record {
+    int64_t role;
+    uint32_t is_live;
+    uint32_t is_active;
+    uint64_t state_size;
+    uint64_t nmessages;
+} actor_record_t;
+
+/*
+ * Rodzaje zapisu komunikatu: zwykły, wysłany z kluczem (nowy oczekujący komunikat)
+ * oraz zastępujący oczekujący komunikat o tym samym typie i kluczu.
+ */
+#define RECORD_PLAIN 0
+#define RECORD_COALESCED 1
+#define RECORD_REPLACEMENT 2
+
+/*
+ * Zapis komunikatu w migawce i w dzienniku. Po nim następuje size bajtów danych.
+ * Klucz key ma znaczenie tylko dla zapisów innych niż RECORD_PLAIN.
+ */
+typedef struct message_record {
+    int64_t actor;
+    int64_t message_type;
+    uint64_t nbytes;
+    uint64_t size;
+    uint64_t kind;
+    int64_t key;
+    uint64_t checksum;
+} message_record_t;
+
+/*
+ * Struktura do odczytu odwzorowanego w pamięci pliku.
+ */
+typedef struct reader {
+    const char *data;
+    size_t size, offset;
+} reader_t;
+
+static void buffer_reserve(buffer_t *buffer, size_t n) {
+    if (buffer->size + n <= buffer->capacity) {
+        return;
+    }
+
+    size_t capacity = buffer->capacity == 0 ? BUFFER_STARTING_SIZE : buffer->capacity;
+    while (capacity < buffer->size + n) {
+        capacity *= 2;
+    }
+
+    if (buffer->fd < 0) {
+        realloc_and_check(buffer->data, capacity);
+    } else {
+        if (ftruncate(buffer->fd, capacity) != 0)
+            syserr(errno, "ftruncate failed");
+
+        void *data = buffer->data == NULL
+                     ? mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, buffer->fd, 0)
+                     : mremap(buffer->data, buffer->capacity, capacity, MREMAP_MAYMOVE);
+        if (data == MAP_FAILED)
+            syserr(errno, "mmap failed");
+
+        buffer->data = data;
+    }
+
+    buffer->capacity = capacity;
+}
+
+/*
+ * Funkcja zwraca wskaźnik na kolejne n bajtów pliku (NULL jeśli plik jest za krótki).
+ */
+static const void *reader_take(reader_t *reader, size_t n) {
+    if (n > reader->size - reader->offset) {
+        return NULL;
+    }
+
+    const void *output = reader->data + reader->offset;
+    reader->offset += ALIGN(n) <= reader->size - reader->offset ? ALIGN(n) : n;
+
+    return output;
+}
+
+static uint64_t checksum(const message_record_t *record, const void *data) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325;
+    const unsigned char *bytes = data;
+
+    hash = (hash ^ (uint64_t) record->actor) * 0x100000001B3;
+    hash = (hash ^ (uint64_t) record->message_type) * 0x100000001B3;
+    hash = (hash ^ record->nbytes) * 0x100000001B3;
+    hash = (hash ^ record->kind) * 0x100000001B3;
+    hash = (hash ^ (uint64_t) record->key) * 0x100000001B3;
+    for (size_t i = 0; i < record->size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+static int64_t role_index(persistence_t *persistence, const role_t *role) {
+    for (size_t i = 0; i < persistence->nroles; ++i) {
+        if (persistence->roles[i] == role) {
+            return (int64_t) i;
+        }
+    }
+
+    return NO_ROLE;
+}
+
+static role_t *role_at(persistence_t *persistence, int64_t index) {
+    if (index < 0 || (uint64_t) index >= persistence->nroles) {
+        return NULL;
+    }
+
+    return persistence->roles[index];
+}
+
+/*
+ * Funkcja dopisuje komunikat skierowany do aktora o danej roli do bufora
+ * jako zapis rodzaju kind. Zwraca false, jeśli komunikatu nie da się zapisać.
+ */
+static bool write_message(buffer_t *buffer, persistence_t *persistence, const role_t *role,
+                          actor_id_t actor, message_t message, uint64_t kind, long key) {
+    size_t offset = buffer->size;
+    size_t header = sizeof(message_record_t);
+    size_t size;
+
+    buffer_reserve(buffer, header + sizeof(int64_t));
+
+    switch (message.message_type) {
+        case MSG_GODIE: {
+            size = 0;
+            break;
+        }
+        case MSG_HELLO: {
+            // Dane komunikatu to identyfikator aktora, a nie wskaźnik.
+            int64_t value = (int64_t) (intptr_t) message.data;
+            size = sizeof(value);
+            memcpy(buffer->data + offset + header, &value, size);
+            break;
+        }
+        case MSG_SPAWN: {
+            int64_t value = role_index(persistence, message.data);
+            if (value == NO_ROLE) {
+                return false;
+            }
+            size = sizeof(value);
+            memcpy(buffer->data + offset + header, &value, size);
+            break;
+        }
+        default: {
+            if (role == NULL || role->serialize == NULL) {
+                return false;
+            }
+
+            size_t available = buffer->capacity - offset - header;
+            size = role->serialize(message.message_type, message.data, message.nbytes,
+                                   buffer->data + offset + header, available);
+            if (size == SERIALIZE_SKIP) {
+                return false;
+            }
+
+            if (size > available) {
+                buffer_reserve(buffer, header + size);
+                available = buffer->capacity - offset - header;
+                size = role->serialize(message.message_type, message.data, message.nbytes,
+                                       buffer->data + offset + header, available);
+                if (size == SERIALIZE_SKIP || size > available) {
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+
+    buffer_reserve(buffer, header + ALIGN(size));
+
+    message_record_t record = {
+            .actor = actor,
+            .message_type = message.message_type,
+            .nbytes = message.nbytes,
+            .size = size,
+            .kind = kind,
+            .key = key
+    };
+    record.checksum = checksum(&record, buffer->data + offset + header);
+
+    memcpy(buffer->data + offset, &record, header);
+    buffer->size = offset + header + ALIGN(size);
+
+    return true;
+}
+
+/*
+ * Funkcja odtwarza komunikat z zapisu. Zwraca false, jeśli komunikatu nie da się odtworzyć.
+ */
+static bool read_message(persistence_t *persistence, const role_t *role,
+                         const message_record_t *record, const void *data, message_t *message) {
+    message->message_type = record->message_type;
+    message->nbytes = record->nbytes;
+
+    switch (record->message_type) {
+        case MSG_GODIE: {
+            message->data = NULL;
+            return true;
+        }
+        case MSG_HELLO: {
+            int64_t value;
+            memcpy(&value, data, sizeof(value));
+            message->data = (void *) (intptr_t) value;
+            return true;
+        }
+        case MSG_SPAWN: {
+            int64_t value;
+            memcpy(&value, data, sizeof(value));
+            message->data = role_at(persistence, value);
+            return message->data != NULL;
+        }
+        default: {
+            if (role == NULL || role->deserialize == NULL) {
+                return false;
+            }
+            message->data = role->deserialize(record->message_type, data, record->size);
+            return true;
+        }
+    }
+}
+
+/*
+ * Funkcja odczytuje kolejny zapis komunikatu (NULL jeśli zapis jest niepełny lub uszkodzony).
+ */
+static const message_record_t *reader_take_message(reader_t *reader, const void **data) {
+    const message_record_t *record = reader_take(reader, sizeof(message_record_t));
+    if (record == NULL) {
+        return NULL;
+    }
+
+    bool is_predefined = record->message_type == MSG_HELLO || record->message_type == MSG_SPAWN;
+    if (is_predefined && record->size != sizeof(int64_t)) {
+        return NULL;
+    }
+
+    if ((*data = reader_take(reader, record->size)) == NULL
+        || checksum(record, *data) != record->checksum) {
+        return NULL;
+    }
+
+    return record;
+}
+
+/*
+ * Funkcja zapisuje stan aktora do bufora o rozmiarze size (jak serialize_t).
+ * Zapis stanu zahibernowanego aktora jest przepisywany z magazynu bez budzenia aktora.
+ */
+static size_t write_state(actor_t *actor, void *buffer, size_t size) {
+    if (actor->hibernated != 0) {
+        return hibernation_read(current_actors_system->hibernation, actor, buffer, size);
+    }
+
+    return actor->role->serialize(MSG_STATE, actor->data, 0, buffer, size);
+}
+
+/*
+ * Funkcja dopisuje do migawki aktora wraz z kolejką jego komunikatów.
+ * Funkcja powinna być wywoływana pod blokadą aktora i jego kolejki.
+ */
+static void write_actor(buffer_t *buffer, persistence_t *persistence, actor_t *actor) {
+    const role_t *role = actor->role;
+    size_t offset = buffer->size;
+
+    actor_record_t record = {
+            .role = role_index(persistence, role),
+            .is_live = actor->is_live,
+            .is_active = actor->is_active,
+            .state_size = SERIALIZE_SKIP,
+            .nmessages = 0
+    };
+
+    buffer_reserve(buffer, sizeof(actor_record_t));
+    buffer->size += sizeof(actor_record_t);
+
+    if (!actor->is_live) {
+        // Martwy aktor zachowuje jedynie swój identyfikator.
+        memcpy(buffer->data + offset, &record, sizeof(actor_record_t));
+        return;
+    }
+
+    if ((actor->data != NULL || actor->hibernated != 0) && role != NULL && role->serialize != NULL) {
+        size_t available = buffer->capacity - buffer->size;
+        size_t size = write_state(actor, buffer->data + buffer->size, available);
+
+        if (size != SERIALIZE_SKIP && size > available) {
+            buffer_reserve(buffer, size);
+            available = buffer->capacity - buffer->size;
+            size = write_state(actor, buffer->data + buffer->size, available);
+
+            if (size > available) {
+                size = SERIALIZE_SKIP;
+            }
+        }
+
+        if (size != SERIALIZE_SKIP) {
+            record.state_size = size;
+            buffer_reserve(buffer, ALIGN(size));
+            buffer->size += ALIGN(size);
+        }
+    }
+
+    queue_message_t *messages_queue = &actor->msg_queue;
+    for (size_t i = 0; i < queue_message_length(messages_queue); ++i) {
+        message_t message = queue_message_peek(messages_queue, i);
+        uint64_t kind = RECORD_PLAIN;
+        long key = 0;
+        if (message.message_type == MSG_COALESCED) {
+            // Po odtworzeniu komunikat wciąż może zostać zastąpiony.
+            coalesce_slot_t *slot = message.data;
+            message = slot->message;
+            kind = RECORD_COALESCED;
+            key = slot->key;
+        }
+
+        if (write_message(buffer, persistence, role, actor->id, message, kind, key)) {
+            record.nmessages++;
+        }
+    }
+
+    memcpy(buffer->data + offset, &record, sizeof(actor_record_t));
+}
+
+/*
+ * Funkcja zapisuje migawkę systemu aktorów. Najpierw zapisuje plik tymczasowy,
+ * a następnie podmienia nim poprzednią migawkę.
+ * Funkcja powinna być wywoływana po zatrzymaniu systemu i pod blokadą persistence.
+ */
+static int write_snapshot(persistence_t *persistence) {
+    int err;
+
+    size_t length = strlen(persistence->path);
+    char tmp_path[length + sizeof(".tmp")];
+    memcpy(tmp_path, persistence->path, length);
+    memcpy(tmp_path + length, ".tmp", sizeof(".tmp"));
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -2;
+    }
+
+    buffer_t buffer = {.data = NULL, .size = 0, .capacity = 0, .fd = fd};
+    buffer_reserve(&buffer, sizeof(snapshot_header_t));
+    buffer.size = sizeof(snapshot_header_t);
+
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    entity_reader_lock(actors_array);
+    snapshot_header_t header = {
+            .magic = SNAPSHOT_MAGIC,
+            .version = SNAPSHOT_VERSION,
+            .nactors = actors_array->nactors
+    };
+
+    for (actor_id_t actor_id = 1; actor_id <= actors_array->nactors; ++actor_id) {
+        actor_t *actor = actors_array_get_actor(actors_array, actor_id);
+        queue_message_t *messages_queue = &actor->msg_queue;
+
+        entity_lock(actor);
+        entity_lock(messages_queue);
+        write_actor(&buffer, persistence, actor);
+        entity_unlock(messages_queue);
+        entity_unlock(actor);
+    }
+    entity_rw_unlock(actors_array);
+
+    memcpy(buffer.data, &header, sizeof(snapshot_header_t));
+
+    int result = 0;
+    if (msync(buffer.data, buffer.size, MS_SYNC) != 0
+        || munmap(buffer.data, buffer.capacity) != 0
+        || ftruncate(fd, buffer.size) != 0
+        || fsync(fd) != 0) {
+        result = -2;
+    }
+
+    close(fd);
+
+    if (result == 0 && rename(tmp_path, persistence->path) != 0) {
+        result = -2;
+    }
+
+    return result;
+}
+
+/*
+ * Funkcja zapisuje cały bufor dziennika do pliku.
+ * Funkcja powinna być wywoływana pod blokadą persistence.
+ */
+static void write_log(persistence_t *persistence) {
+    buffer_t *log = &persistence->log;
+    size_t written = 0;
+
+    while (written < log->size) {
+        ssize_t n = write(persistence->log_fd, log->data + written, log->size - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syserr(errno, "log write failed");
+        }
+        written += n;
+    }
+
+    log->size = 0;
+}
+
+/*
+ * Funkcja czyści dziennik po zapisaniu migawki.
+ * Funkcja powinna być wywoływana pod blokadą persistence.
+ */
+static void reset_log(persistence_t *persistence) {
+    persistence->log.size = 0;
+
+    if (ftruncate(persistence->log_fd, 0) != 0 || fsync(persistence->log_fd) != 0)
+        syserr(errno, "log truncate failed");
+}
+
+static persistence_t *persistence_new(const char *path, role_t *const *roles, size_t nroles) {
+    int err;
+
+    persistence_t *persistence;
+    malloc_and_check(persistence, sizeof(persistence_t));
+
+    size_t length = strlen(path);
+    malloc_and_check(persistence->path, length + 1);
+    memcpy(persistence->path, path, length + 1);
+
+    persistence->nroles = nroles;
+    malloc_and_check(persistence->roles, (nroles + 1) * sizeof(role_t *));
+    memcpy(persistence->roles, roles, nroles * sizeof(role_t *));
+
+    char log_path[length + sizeof(".log")];
+    memcpy(log_path, path, length);
+    memcpy(log_path + length, ".log", sizeof(".log"));
+
+    persistence->log_fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (persistence->log_fd < 0)
+        syserr(errno, "log open failed");
+
+    persistence->log = (buffer_t) {.data = NULL, .size = 0, .capacity = 0, .fd = -1};
+    mutex_init(&persistence->lock);
+
+    return persistence;
+}
+
+void persistence_append(persistence_t *persistence, actor_t *actor, message_t message,
+                        const long *key, bool is_replacement) {
+    uint64_t kind = key == NULL ? RECORD_PLAIN
+                    : is_replacement ? RECORD_REPLACEMENT
+                    : RECORD_COALESCED;
+    write_message(&persistence->log, persistence, actor->role, actor->id, message,
+                  kind, key != NULL ? *key : 0);
+
+    if (persistence->log.size >= LOG_BUFFER_LIMIT) {
+        write_log(persistence);
+    }
+}
+
+void persistence_commit(persistence_t *persistence) {
+    int err;
+
+    entity_lock(persistence);
+    bool is_dirty = persistence->log.size > 0;
+    write_log(persistence);
+    entity_unlock(persistence);
+
+    // Jedno fdatasync dla wszystkich komunikatów zebranych od ostatniego zatwierdzenia.
+    if (is_dirty && fdatasync(persistence->log_fd) != 0)
+        syserr(errno, "log fdatasync failed");
+}
+
+void persistence_destroy(persistence_t *persistence) {
+    int err;
+
+    persistence_commit(persistence);
+
+    close(persistence->log_fd);
+    mutex_destroy(&persistence->lock);
+    free(persistence->log.data);
+    free(persistence->roles);
+    free(persistence->path);
+    free(persistence);
+}
+
+int actor_system_persist(const char *path, role_t *const *roles, size_t nroles) {
+    if (current_actors_system == NULL || current_actors_system->persistence != NULL) {
+        return -1;
+    }
+
+    if (is_worker) {
+        return -3;
+    }
+
+    int err;
+
+    persistence_t *persistence = persistence_new(path, roles, nroles);
+
+    // Obsługa komunikatu rozpoczęta przed ustawieniem flagi nie bierze blokady
+    // systemu, więc migawka czeka na jej zakończenie.
+    atomic_store(&current_actors_system->is_persistent, true);
+    rcu_synchronize();
+
+    entity_writer_lock(current_actors_system);
+    entity_lock(persistence);
+
+    int result = write_snapshot(persistence);
+    if (result == 0) {
+        reset_log(persistence);
+
+        entity_lock(current_actors_system);
+        current_actors_system->persistence = persistence;
+        entity_unlock(current_actors_system);
+    }
+
+    entity_unlock(persistence);
+    entity_rw_unlock(current_actors_system);
+
+    if (result != 0) {
+        atomic_store(&current_actors_system->is_persistent, false);
+        persistence_destroy(persistence);
+        return result;
+    }
+
+    // Wątek kontrolny zaczyna okresowo zatwierdzać dziennik.
+    actor_system_notify(current_actors_system);
+
+    return 0;
+}
+
+int actor_system_snapshot(void) {
+    if (current_actors_system == NULL || current_actors_system->persistence == NULL) {
+        return -1;
+    }
+
+    if (is_worker) {
+        return -3;
+    }
+
+    int err;
+
+    persistence_t *persistence = current_actors_system->persistence;
+
+    entity_writer_lock(current_actors_system);
+    entity_lock(persistence);
+
+    int result = write_snapshot(persistence);
+    if (result == 0) {
+        reset_log(persistence);
+    }
+
+    entity_unlock(persistence);
+    entity_rw_unlock(current_actors_system);
+
+    return result;
+}
+
+/*
+ * Funkcja sprawdza poprawność struktury migawki.
+ */
+static bool validate_snapshot(reader_t reader) {
+    const snapshot_header_t *header = reader_take(&reader, sizeof(snapshot_header_t));
+    if (header == NULL || header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION
+        || header->nactors == 0 || header->nactors > CAST_LIMIT) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < header->nactors; ++i) {
+        const actor_record_t *record = reader_take(&reader, sizeof(actor_record_t));
+        if (record == NULL) {
+            return false;
+        }
+
+        if (record->state_size != SERIALIZE_SKIP && reader_take(&reader, record->state_size) == NULL) {
+            return false;
+        }
+
+        for (uint64_t j = 0; j < record->nmessages; ++j) {
+            const void *data;
+            if (reader_take_message(&reader, &data) == NULL) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Funkcja dodaje komunikat z zapisu record do kolejki odtwarzanego aktora.
+ * Limit długości kolejki nie obowiązuje - komunikaty z migawki i dziennika
+ * zostały już wcześniej przyjęte.
+ */
+static void restore_message(actor_t *actor, message_t message, const message_record_t *record) {
+    queue_message_t *messages_queue = &actor->msg_queue;
+
+    if (record->kind == RECORD_REPLACEMENT) {
+        coalesce_slot_t *slot = actor_coalesce_find(actor, message.message_type, record->key);
+        if (slot != NULL) {
+            // Dane zastąpionego komunikatu (w działającym systemie zwracane nadawcy) są porzucane.
+            slot->message = message;
+            return;
+        }
+    }
+
+    if (record->kind != RECORD_PLAIN) {
+        coalesce_slot_t *slot = actor_coalesce_insert(actor, message, record->key);
+        message = (message_t) {MSG_COALESCED, sizeof(coalesce_slot_t), slot};
+    }
+
+    size_t max_size = messages_queue->max_size;
+    messages_queue->max_size = 0;
+    queue_message_push(messages_queue, message);
+    messages_queue->max_size = max_size;
+}
+
+/*
+ * Funkcja odtwarza aktorów z migawki.
+ */
+static void read_snapshot(reader_t reader, persistence_t *persistence) {
+    int err;
+
+    const snapshot_header_t *header = reader_take(&reader, sizeof(snapshot_header_t));
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+
+    for (uint64_t i = 0; i < header->nactors; ++i) {
+        const actor_record_t *record = reader_take(&reader, sizeof(actor_record_t));
+        const role_t *role = role_at(persistence, record->role);
+
+        entity_writer_lock(actors_array);
+        actor_id_t actor_id = actors_array_new_actor(actors_array, role);
+        actor_t *actor = actors_array_get_actor(actors_array, actor_id);
+        entity_rw_unlock(actors_array);
+
+        actor->is_active = record->is_live && record->is_active && role != NULL;
+
+        if (record->state_size != SERIALIZE_SKIP) {
+            const void *state = reader_take(&reader, record->state_size);
+            if (role != NULL && role->deserialize != NULL) {
+                actor->data = role->deserialize(MSG_STATE, state, record->state_size);
+            }
+        }
+
+        for (uint64_t j = 0; j < record->nmessages; ++j) {
+            const void *data;
+            const message_record_t *message_record = reader_take_message(&reader, &data);
+
+            message_t message;
+            if (role != NULL && read_message(persistence, role, message_record, data, &message)) {
+                restore_message(actor, message, message_record);
+            }
+        }
+
+        if (record->is_live && role != NULL) {
+            entity_lock(current_actors_system);
+            actor_system_enlist(current_actors_system, actor);
+            entity_unlock(current_actors_system);
+        }
+    }
+}
+
+/*
+ * Funkcja dodaje do kolejek aktorów komunikaty z dziennika i obcina
+ * jego niepełny (przerwany awarią) koniec.
+ */
+static void read_log(persistence_t *persistence) {
+    size_t length = strlen(persistence->path);
+    char log_path[length + sizeof(".log")];
+    memcpy(log_path, persistence->path, length);
+    memcpy(log_path + length, ".log", sizeof(".log"));
+
+    int fd = open(log_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        syserr(errno, "mmap failed");
+    }
+
+    reader_t reader = {.data = data, .size = st.st_size, .offset = 0};
+    actors_array_t *actors_array = &current_actors_system->actors_array;
+    size_t valid = 0;
+
+    while (true) {
+        const void *payload;
+        const message_record_t *record = reader_take_message(&reader, &payload);
+        if (record == NULL) {
+            break;
+        }
+        valid = reader.offset;
+
+        actor_t *actor = actors_array_get_actor(actors_array, record->actor);
+        if (actor == NULL || !actor->is_active) {
+            continue;
+        }
+
+        message_t message;
+        if (read_message(persistence, actor->role, record, payload, &message)) {
+            restore_message(actor, message, record);
+        }
+    }
+
+    munmap((void *) data, st.st_size);
+
+    if (valid < (size_t) st.st_size && ftruncate(persistence->log_fd, valid) != 0)
+        syserr(errno, "log truncate failed");
+}
+
+int actor_system_restore(actor_id_t *actor, const char *path, role_t *const *roles, size_t nroles) {
+    if (current_actors_system != NULL) {
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -2;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(snapshot_header_t)) {
+        close(fd);
+        return -2;
+    }
+
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -2;
+    }
+
+    reader_t reader = {.data = data, .size = st.st_size, .offset = 0};
+    if (!validate_snapshot(reader)) {
+        munmap((void *) data, st.st_size);
+        return -2;
+    }
+
+    int err;
+
+    actor_system_open();
+
+    persistence_t *persistence = persistence_new(path, roles, nroles);
+
+    read_snapshot(reader, persistence);
+    munmap((void *) data, st.st_size);
+
+    read_log(persistence);
+
+    // Aktorzy z zaległymi komunikatami trafiają do kolejki oczekujących.
+    entity_lock(current_actors_system);
+    for (actor_t *live = current_actors_system->live_actors; live != NULL; live = live->live_next) {
+        if (!queue_message_is_empty(&live->msg_queue)) {
+            live->state = WAITING;
+            actor_system_schedule(live->id);
+        }
+    }
+
+    current_actors_system->persistence = persistence;
+    atomic_store(&current_actors_system->is_persistent, true);
+
+    if (current_actors_system->active_actors == 0) {
+        actor_system_godie(current_actors_system);
+    }
+    entity_unlock(current_actors_system);
+
+    *actor = 1;
+
+    actor_system_start();
+
+    return 0;
+}
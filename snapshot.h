@@ -0,0 +1,89 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <pthread.h>
+
+#include "actor.h"
+#include "cacti.h"
+
+/*
+ * Odstęp (w milisekundach) między grupowymi zatwierdzeniami dziennika.
+ */
+#ifndef LOG_COMMIT_INTERVAL
+#define LOG_COMMIT_INTERVAL 10
+#endif
+
+/*
+ * Rozmiar bufora dziennika, po przekroczeniu którego zapis następuje od razu.
+ */
+#ifndef LOG_BUFFER_LIMIT
+#define LOG_BUFFER_LIMIT (1 << 20)
+#endif
+
+/*
+ * Struktura rozszerzającego się bufora zapisu. Gdy fd jest nieujemny,
+ * bufor jest plikiem odwzorowanym w pamięci, w przeciwnym razie - pamięcią.
+ */
+typedef struct buffer {
+    char *data;
+    size_t size, capacity;
+    int fd;
+} buffer_t;
+
+/*
+ * Struktura przechowująca informacje o utrwalaniu systemu aktorów:
+ * ścieżkę migawki, rejestr ról oraz dziennik komunikatów spoza systemu
+ * zapisanych od ostatniej migawki (bufor czekający na zatwierdzenie).
+ */
+typedef struct persistence {
+    char *path;
+    role_t **roles;
+    size_t nroles;
+    int log_fd;
+    buffer_t log;
+    pthread_mutex_t lock;
+} persistence_t;
+
+/*
+ * Funkcja włącza utrwalanie systemu aktorów: zapisuje migawkę do pliku path,
+ * a komunikaty wysyłane spoza systemu dopisuje do dziennika path.log.
+ * Role aktorów są zapisywane jako indeksy w tablicy roles.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów,
+ * -2 gdy nie udało się zapisać migawki, -3 gdy wywołano ją z obsługi komunikatu.
+ */
+int actor_system_persist(const char *path, role_t *const *roles, size_t nroles);
+
+/*
+ * Funkcja zatrzymuje obsługę komunikatów, zapisuje stany aktorów i zawartość
+ * ich kolejek do migawki i czyści dziennik. Wartości zwracane jak wyżej.
+ */
+int actor_system_snapshot(void);
+
+/*
+ * Funkcja odtwarza system aktorów z migawki path i dziennika path.log,
+ * a następnie włącza dalsze utrwalanie. Pod wskaźnikiem actor zapisuje
+ * identyfikator pierwszego aktora. Zwraca -1, gdy działa już inny system
+ * aktorów, -2 gdy migawki nie udało się odczytać.
+ */
+int actor_system_restore(actor_id_t *actor, const char *path, role_t *const *roles, size_t nroles);
+
+/*
+ * Funkcja dopisuje komunikat wysłany do aktora do bufora dziennika. Dla komunikatu
+ * wysłanego z kluczem key zapisuje, czy zastąpił on oczekujący komunikat
+ * (is_replacement), aby odtworzenie dziennika scalało komunikaty tak samo.
+ * Funkcja powinna być wywoływana pod blokadą persistence.
+ */
+void persistence_append(persistence_t *persistence, actor_t *actor, message_t message,
+                        const long *key, bool is_replacement);
+
+/*
+ * Funkcja zapisuje bufor dziennika do pliku (grupowe zatwierdzenie).
+ */
+void persistence_commit(persistence_t *persistence);
+
+/*
+ * Funkcja zatwierdza dziennik i zwalnia strukturę.
+ */
+void persistence_destroy(persistence_t *persistence);
+
+#endif //SNAPSHOT_H
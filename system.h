@@ -0,0 +1,113 @@
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+#include "actor.h"
+#include "queue_actor_id.h"
+
+struct persistence;
+struct transport;
+struct io;
+struct gateway;
+struct watchdog;
+struct hibernation;
+
+/*
+ * Struktura przechowująca informacje o systemie aktorów.
+ * Czytelnikami blokady rwlock są wątki w trakcie obsługi komunikatu,
+ * pisarzem - operacje wymagające zatrzymania wszystkich aktorów.
+ * idle_workers to liczba wątków roboczych czekających na aktora w kolejce.
+ * previous_sigaction to obsługa SIGINT zastąpiona przez actor_system_open.
+ */
+typedef struct actors_system {
+    actors_array_t actors_array;
+    pthread_mutex_t lock;
+    pthread_rwlock_t rwlock;
+    unsigned int nthreads;
+    pthread_t *threads;
+    queue_actor_id_t waiting_actors;
+    atomic_uint idle_workers;
+    unsigned long active_actors;
+    actor_t *live_actors;
+    bool is_active;
+    bool is_interrupted;
+    bool is_joining;
+    pthread_cond_t finished;
+    pthread_t control_thread;
+    int signal_fd;
+    int control_fd;
+    sigset_t previous_sigmask;
+    struct sigaction previous_sigaction;
+    pthread_t creator;
+    struct persistence *persistence;
+    atomic_bool is_persistent;
+    struct transport *transport;
+    struct io *io;
+    struct gateway *gateway;
+    _Atomic(struct watchdog *) watchdog;
+    _Atomic(struct hibernation *) hibernation;
+} actors_system_t;
+
+/*
+ * Obecnie działający system aktorów.
+ */
+extern actors_system_t *current_actors_system;
+
+/*
+ * Aktor, którego komunikat obsługuje wątek (-1 poza obsługą komunikatu).
+ */
+extern _Thread_local actor_id_t current_actor;
+
+/*
+ * Informacja, czy wątek jest wątkiem roboczym systemu aktorów.
+ */
+extern _Thread_local bool is_worker;
+
+/*
+ * Numer wątku roboczego (od 0).
+ */
+extern _Thread_local unsigned int worker_index;
+
+/*
+ * Funkcja tworzy pusty system aktorów (bez aktorów i wątków roboczych).
+ * Zwraca -1, jeśli działa już inny system aktorów.
+ */
+int actor_system_open(void);
+
+/*
+ * Funkcja uruchamia wątki robocze i wątek kontrolny systemu aktorów.
+ */
+void actor_system_start(void);
+
+/*
+ * Funkcja powoduje przejście systemu aktorów w stan martwy.
+ * Funkcja powinna być wywoływana pod blokadą systemu aktorów.
+ */
+void actor_system_godie(actors_system_t *actors_system);
+
+/*
+ * Funkcja dodaje aktora do listy żywych aktorów systemu.
+ * Funkcja powinna być wywoływana pod blokadą systemu aktorów.
+ */
+void actor_system_enlist(actors_system_t *actors_system, actor_t *actor);
+
+/*
+ * Funkcja umieszcza aktora w kolejce aktorów oczekujących.
+ */
+void actor_system_schedule(actor_id_t actor_id);
+
+/*
+ * Funkcja zwraca liczbę komunikatów w skrzynce aktora z tego procesu
+ * (0, gdy aktor nie istnieje lub nie przyjmuje komunikatów).
+ */
+size_t actor_system_mailbox_length(actor_id_t actor_id);
+
+/*
+ * Funkcja budzi wątek kontrolny, aby ponownie odczytał swoją konfigurację.
+ */
+void actor_system_notify(actors_system_t *actors_system);
+
+#endif //SYSTEM_H
@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cacti.h"
+#include "err.h"
+
+/*
+ * Test wstrzymywania obsługi w actor_await: komunikaty, które nadeszły przed
+ * oczekiwaną odpowiedzią, czekają w skrzynce i są obsługiwane po wznowieniu
+ * w kolejności wysłania, a odpowiedź jest wyjmowana ze środka skrzynki
+ * (także spoza pierwszego segmentu skrzynki segmentowej). Poza włóknem
+ * actor_await zwraca -1.
+ */
+
+#define MSG_START (message_type_t) 0x01
+#define MSG_REPLY (message_type_t) 0x02
+#define MSG_OTHER (message_type_t) 0x03
+
+#define MSG_REQUEST (message_type_t) 0x01
+
+#define NROUNDS 3
+#define NOTHERS 100
+
+static int nothers = 0;
+static int nresumed = 0;
+static bool is_out_of_order = false;
+static int server_await = 0;
+static actor_id_t client = -1, server = -1;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void client_hello(void **stateptr, size_t nbytes, void *data);
+
+static void client_start(void **stateptr, size_t nbytes, void *data);
+
+static void client_reply(void **stateptr, size_t nbytes, void *data);
+
+static void client_other(void **stateptr, size_t nbytes, void *data);
+
+static void server_hello(void **stateptr, size_t nbytes, void *data);
+
+static void server_request(void **stateptr, size_t nbytes, void *data);
+
+static act_t client_prompts[] = {client_hello, client_start, client_reply, client_other};
+static role_t client_role = {.nprompts = 4, .prompts = client_prompts, .is_suspendable = true};
+
+static act_t server_prompts[] = {server_hello, server_request};
+static role_t server_role = {.nprompts = 2, .prompts = server_prompts};
+
+static void client_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    client = actor_id_self();
+    server = spawn_many(&server_role, 1, NULL);
+    check(server > 0, "spawn_many");
+
+    send_message(actor_id_self(), (message_t) {MSG_START, 0, (void *) 0});
+}
+
+static void client_start(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    intptr_t round = (intptr_t) data;
+
+    // Komunikaty do aktora wysłane przed odpowiedzią trafiają do skrzynki przed nią.
+    for (intptr_t i = 0; i < NOTHERS; ++i) {
+        send_message(actor_id_self(), (message_t) {MSG_OTHER, 0, (void *) (round * NOTHERS + i)});
+    }
+    send_message(server, (message_t) {MSG_REQUEST, sizeof(intptr_t), (void *) round});
+
+    size_t reply_nbytes;
+    void *reply;
+    check(actor_await(MSG_REPLY, &reply_nbytes, &reply) == 0, "actor_await");
+
+    check(reply_nbytes == sizeof(intptr_t) && (intptr_t) reply == round + 1000, "reply");
+    check(nothers == round * NOTHERS, "messages handled while suspended");
+    nresumed++;
+
+    if (round + 1 < NROUNDS) {
+        send_message(actor_id_self(), (message_t) {MSG_START, 0, (void *) (round + 1)});
+    }
+    else {
+        send_message(server, (message_t) {MSG_GODIE, 0, NULL});
+        send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+    }
+}
+
+static void client_reply(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    fatal("reply passed to prompts");
+}
+
+static void client_other(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    if ((intptr_t) data != nothers) {
+        is_out_of_order = true;
+    }
+    nothers++;
+}
+
+static void server_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void server_request(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    size_t reply_nbytes;
+    void *reply;
+    server_await = actor_await(MSG_REPLY, &reply_nbytes, &reply);
+
+    send_message(client, (message_t) {MSG_REPLY, sizeof(intptr_t), (void *) ((intptr_t) data + 1000)});
+}
+
+int main(void) {
+    actor_id_t actor;
+    if (actor_system_create(&actor, &client_role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    actor_system_join(actor);
+
+    check(nresumed == NROUNDS, "resumed");
+    check(nothers == NROUNDS * NOTHERS && !is_out_of_order, "messages after resume");
+    check(server_await == -1, "actor_await outside fiber");
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "hibernate.h"
+#include "snapshot.h"
+
+/*
+ * Test hibernacji: bezczynni aktorzy są zamrażani dopiero po upływie czasu
+ * bezczynności liczonego od włączenia hibernacji, migawka zapisuje ich stany
+ * bez budzenia, a komunikat budzi tylko adresata. Na końcu system jest
+ * odtwarzany z migawki i dziennika, a stany porównywane z osiągniętymi wcześniej.
+ */
+
+#define MSG_SPAWN_COUNTERS (message_type_t) 0x01
+#define MSG_FINISH (message_type_t) 0x02
+#define MSG_ADD (message_type_t) 0x01
+
+#define NCOUNTERS 256
+#define IDLE 1000
+#define WAIT_LIMIT 10000
+#define PADDING 1024
+
+#define PATH "hibernate_test.bin"
+#define LOG_PATH PATH ".log"
+
+typedef struct counter {
+    long value;
+    char padding[PADDING];
+} counter_t;
+
+static atomic_long first_counter = -1;
+static atomic_long nadded = 0, nreleased = 0, ndeserialized = 0;
+
+static long live[NCOUNTERS], restored[NCOUNTERS];
+static long *results = live;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void root_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void root_spawn(void **stateptr, size_t nbytes, void *data);
+
+static void root_finish(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+static void counter_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+
+    if (*stateptr == NULL) {
+        // Wypełnienie dobrze się kompresuje.
+        *stateptr = calloc(1, sizeof(counter_t));
+    }
+}
+
+static void counter_add(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+
+    counter_t *counter = *stateptr;
+    counter->value += (long) data;
+    atomic_fetch_add(&nadded, 1);
+}
+
+static void counter_finish(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+
+    counter_t *counter = *stateptr;
+    results[actor_id_self() - atomic_load(&first_counter)] = counter->value;
+    free(counter);
+    *stateptr = NULL;
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+static size_t counter_serialize(message_type_t type, void *object, size_t nbytes, void *buffer, size_t size) {
+    (void) nbytes;
+
+    if (type == MSG_STATE) {
+        if (size >= sizeof(counter_t)) {
+            memcpy(buffer, object, sizeof(counter_t));
+        }
+        return sizeof(counter_t);
+    }
+
+    if (type == MSG_ADD) {
+        if (size >= sizeof(long)) {
+            memcpy(buffer, &object, sizeof(long));
+        }
+        return sizeof(long);
+    }
+
+    return 0;
+}
+
+static void *counter_deserialize(message_type_t type, const void *buffer, size_t size) {
+    if (type == MSG_STATE) {
+        check(size == sizeof(counter_t), "state size");
+        atomic_fetch_add(&ndeserialized, 1);
+
+        counter_t *counter = malloc(sizeof(counter_t));
+        memcpy(counter, buffer, size);
+        return counter;
+    }
+
+    if (type == MSG_ADD) {
+        long value;
+        memcpy(&value, buffer, sizeof(long));
+        return (void *) value;
+    }
+
+    return NULL;
+}
+
+static void counter_release(void *state) {
+    atomic_fetch_add(&nreleased, 1);
+    free(state);
+}
+
+static act_t root_prompts[] = {root_hello, root_spawn, root_finish};
+static act_t counter_prompts[] = {counter_hello, counter_add, counter_finish};
+
+static role_t root_role = {
+        .nprompts = 3,
+        .prompts = root_prompts,
+        .serialize = counter_serialize,
+        .deserialize = counter_deserialize
+};
+static role_t counter_role = {
+        .nprompts = 3,
+        .prompts = counter_prompts,
+        .serialize = counter_serialize,
+        .deserialize = counter_deserialize,
+        .release = counter_release
+};
+
+static role_t *const roles[] = {&root_role, &counter_role};
+
+static void root_spawn(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    atomic_store(&first_counter, spawn_many(&counter_role, NCOUNTERS, NULL));
+}
+
+/*
+ * Funkcja czeka (co najwyżej WAIT_LIMIT ms), aż licznik osiągnie wartość expected.
+ */
+static void wait_for(atomic_long *counter, long expected, const char *what) {
+    for (int i = 0; i < WAIT_LIMIT && atomic_load(counter) < expected; ++i) {
+        usleep(1000);
+    }
+
+    check(atomic_load(counter) == expected, what);
+}
+
+/*
+ * Wartość dodawana do licznika i przed hibernacją.
+ */
+static long value(long i) {
+    return i + 1;
+}
+
+int main(void) {
+    int err;
+
+    unlink(PATH);
+    unlink(LOG_PATH);
+
+    actor_id_t root;
+    if (actor_system_create(&root, &root_role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    send_message(root, (message_t) {MSG_SPAWN_COUNTERS, 0, NULL});
+    while (atomic_load(&first_counter) < 0) {
+        usleep(1000);
+    }
+
+    actor_id_t first = atomic_load(&first_counter);
+    for (long i = 0; i < NCOUNTERS; ++i) {
+        send_message(first + i, (message_t) {MSG_ADD, 0, (void *) value(i)});
+    }
+    wait_for(&nadded, NCOUNTERS, "messages before hibernation");
+
+    // Aktorzy bezczynni przed włączeniem hibernacji nie są zamrażani od razu.
+    check(actor_system_hibernate(IDLE, NULL) == 0, "actor_system_hibernate");
+    usleep(IDLE / 10 * 1000);
+    check(atomic_load(&nreleased) == 0, "early hibernation");
+
+    wait_for(&nreleased, NCOUNTERS, "hibernation");
+
+    // Migawka przepisuje zapisane stany, nie budząc aktorów.
+    if ((err = actor_system_persist(PATH, roles, 2)) != 0) {
+        fatal("actor_system_persist: %d", err);
+    }
+    check(atomic_load(&ndeserialized) == 0, "snapshot woke hibernated actors");
+
+    // Komunikat budzi jedynie swojego adresata.
+    for (long i = 0; i < NCOUNTERS; i += 2) {
+        send_message(first + i, (message_t) {MSG_ADD, 0, (void *) (long) NCOUNTERS});
+    }
+    wait_for(&nadded, NCOUNTERS + NCOUNTERS / 2, "messages after hibernation");
+    check(atomic_load(&ndeserialized) == NCOUNTERS / 2, "woken actors");
+
+    for (long i = 0; i < NCOUNTERS; ++i) {
+        send_message(first + i, (message_t) {MSG_FINISH, 0, NULL});
+    }
+    send_message(root, (message_t) {MSG_FINISH, 0, NULL});
+
+    actor_system_join(root);
+
+    // Odtworzony system powtarza komunikaty z dziennika, w tym MSG_FINISH.
+    results = restored;
+    if ((err = actor_system_restore(&root, PATH, roles, 2)) != 0) {
+        fatal("actor_system_restore: %d", err);
+    }
+    actor_system_join(root);
+
+    unlink(PATH);
+    unlink(LOG_PATH);
+
+    for (long i = 0; i < NCOUNTERS; ++i) {
+        long expected = value(i) + (i % 2 == 0 ? NCOUNTERS : 0);
+
+        if (live[i] != expected) {
+            fatal("counter %ld: %ld, expected %ld", i, live[i], expected);
+        }
+
+        if (restored[i] != expected) {
+            fatal("restored counter %ld: %ld, expected %ld", i, restored[i], expected);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "io.h"
+
+/*
+ * Test operacji wejścia-wyjścia: aktor zapisuje bufor z puli do pliku,
+ * synchronizuje go, odczytuje z powrotem i przyjmuje połączenie. Następnie
+ * zleca serię operacji przy pełnej skrzynce - wyniki muszą dotrzeć wszystkie.
+ */
+
+#define MSG_START (message_type_t) 0x01
+#define MSG_WRITTEN (message_type_t) 0x02
+#define MSG_SYNCED (message_type_t) 0x03
+#define MSG_READ (message_type_t) 0x04
+#define MSG_ACCEPTED (message_type_t) 0x05
+#define MSG_FILLER (message_type_t) 0x06
+#define MSG_FLUSHED (message_type_t) 0x07
+
+#define BUFFER_SIZE 4096
+#define NFLUSHES 100
+
+/*
+ * Kod wyjścia oznaczający pominięcie testu (jądro bez io_uring).
+ */
+#define SKIP 77
+
+static int file_fd, listen_fd;
+static void *written, *read_back;
+static int nflushed;
+static bool is_done;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void start(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    written = io_buffer_get();
+    check(written != NULL, "io_buffer_get");
+    for (size_t i = 0; i < BUFFER_SIZE; ++i) {
+        ((unsigned char *) written)[i] = (unsigned char) (i * 7);
+    }
+
+    check(io_write(file_fd, written, BUFFER_SIZE, 0, MSG_WRITTEN) == 0, "io_write");
+}
+
+static void on_written(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    io_result_t *result = data;
+    check(result->result == BUFFER_SIZE, "write result");
+    io_release(result);
+
+    check(io_fsync(file_fd, MSG_SYNCED) == 0, "io_fsync");
+}
+
+static void on_synced(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    io_result_t *result = data;
+    check(result->result == 0, "fsync result");
+    io_release(result);
+
+    read_back = io_buffer_get();
+    check(read_back != NULL && read_back != written, "io_buffer_get");
+    check(io_read(file_fd, read_back, BUFFER_SIZE, 0, MSG_READ) == 0, "io_read");
+}
+
+static void on_read(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    io_result_t *result = data;
+    check(result->result == BUFFER_SIZE, "read result");
+    check(memcmp(written, read_back, BUFFER_SIZE) == 0, "read data");
+    io_release(result);
+
+    check(io_buffer_put(written) == 0 && io_buffer_put(read_back) == 0, "io_buffer_put");
+    check(io_buffer_put(written) == -2, "io_buffer_put twice");
+    check(io_buffer_put((char *) read_back + 1) == -2, "io_buffer_put outside the pool");
+
+    check(io_accept(listen_fd, MSG_ACCEPTED) == 0, "io_accept");
+}
+
+static void on_accepted(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    io_result_t *result = data;
+    check(result->result >= 0, "accept result");
+    close(result->result);
+    io_release(result);
+
+    // Skrzynka jest zapełniana, zanim operacje się zakończą.
+    while (send_message(actor_id_self(), (message_t) {MSG_FILLER, 0, NULL}) == 0) {
+    }
+
+    for (int i = 0; i < NFLUSHES; ++i) {
+        check(io_fsync(file_fd, MSG_FLUSHED) == 0, "io_fsync");
+    }
+}
+
+static void filler(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void on_flushed(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    io_release(data);
+
+    if (++nflushed == NFLUSHES) {
+        is_done = true;
+        send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+    }
+}
+
+static act_t prompts[] = {hello, start, on_written, on_synced, on_read, on_accepted, filler, on_flushed};
+static role_t role = {.nprompts = 8, .prompts = prompts};
+
+int main(void) {
+    char path[] = "/tmp/cacti_io_testXXXXXX";
+    if ((file_fd = mkstemp(path)) < 0) {
+        syserr(errno, "mkstemp");
+    }
+    unlink(path);
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+
+    if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+        || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0
+        || listen(listen_fd, 1) != 0
+        || getsockname(listen_fd, (struct sockaddr *) &address, &length) != 0) {
+        syserr(errno, "listen");
+    }
+
+    actor_id_t actor;
+    if (actor_system_create(&actor, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    int result = io_open(256, 2, BUFFER_SIZE);
+    if (result != 0) {
+        send_message(actor, (message_t) {MSG_GODIE, 0, NULL});
+        actor_system_join(actor);
+        return result == -2 || result == -3 ? SKIP : 1;
+    }
+
+    // Połączenie czeka w kolejce gniazda na io_accept.
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client_fd < 0 || connect(client_fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        syserr(errno, "connect");
+    }
+
+    send_message(actor, (message_t) {MSG_START, 0, NULL});
+    actor_system_join(actor);
+
+    close(client_fd);
+    close(listen_fd);
+    close(file_fd);
+
+    check(is_done, "flush results");
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "parallel.h"
+
+/*
+ * Test parallel_reduce: wyniki fragmentów są łączone w kolejności przedziałów
+ * (funkcja łącząca nie jest przemienna) dla różnych liczb aktorów, parallel_for
+ * obsługuje każdy indeks dokładnie raz, a aktor wskazany w future otrzymuje
+ * wynik, choć czekający wątek zdążył już zniszczyć future.
+ */
+
+#define MSG_REPLY (message_type_t) 0x01
+
+#define BEGIN 5
+#define END 100005
+#define NRUNS 6
+
+static const unsigned int nworkers[NRUNS] = {1, 2, 3, 7, 0, 1000};
+
+static atomic_int visits[END];
+static atomic_int nreplies = 0;
+
+/*
+ * Przedział obsłużony przez fragment lub połączony z sąsiednich.
+ */
+typedef struct span {
+    size_t begin, end;
+    bool is_ordered;
+} span_t;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void *span_body(size_t begin, size_t end, void *context) {
+    (void) context;
+
+    span_t *span = malloc(sizeof(span_t));
+    check(span != NULL, "malloc");
+    *span = (span_t) {.begin = begin, .end = end, .is_ordered = begin < end};
+
+    return span;
+}
+
+static void *span_reduce(void *left, void *right, void *context) {
+    (void) context;
+
+    span_t *span = left, *next = right;
+    span->is_ordered = span->is_ordered && next->is_ordered && span->end == next->begin;
+    span->end = next->end;
+    free(next);
+
+    return span;
+}
+
+static void *visit_body(size_t begin, size_t end, void *context) {
+    (void) context;
+
+    for (size_t i = begin; i < end; ++i) {
+        atomic_fetch_add(&visits[i], 1);
+    }
+
+    return NULL;
+}
+
+static void check_span(span_t *span, const char *what) {
+    check(span != NULL && span->is_ordered && span->begin == BEGIN && span->end == END, what);
+    free(span);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void reply(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    check_span(data, "reply");
+
+    if (atomic_fetch_add(&nreplies, 1) + 1 == NRUNS) {
+        send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+    }
+}
+
+static act_t prompts[] = {hello, reply};
+static role_t role = {.nprompts = 2, .prompts = prompts};
+
+int main(void) {
+    actor_id_t actor;
+    if (actor_system_create(&actor, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    for (int i = 0; i < NRUNS; ++i) {
+        future_t future;
+        future_init(&future, -1, 0);
+        check(parallel_reduce(BEGIN, END, span_body, span_reduce, NULL, nworkers[i], &future) == 0,
+              "parallel_reduce");
+        check_span(future_wait(&future), "ordering");
+        future_destroy(&future);
+    }
+
+    future_t future;
+    future_init(&future, -1, 0);
+    check(parallel_for(BEGIN, END, visit_body, NULL, 0, &future) == 0, "parallel_for");
+    check(future_wait(&future) == NULL, "parallel_for value");
+    future_destroy(&future);
+
+    for (size_t i = 0; i < END; ++i) {
+        check(atomic_load(&visits[i]) == (i >= BEGIN), "visits");
+    }
+
+    future_init(&future, -1, 0);
+    check(parallel_reduce(END, BEGIN, span_body, span_reduce, NULL, 0, &future) == 0, "empty range");
+    check(future_is_ready(&future) && future_wait(&future) == NULL, "empty range value");
+    future_destroy(&future);
+
+    // Future są zwalniane zaraz po ich spełnieniu, przed obsługą odpowiedzi.
+    for (int i = 0; i < NRUNS; ++i) {
+        future_t *replied = malloc(sizeof(future_t));
+        check(replied != NULL, "malloc");
+        future_init(replied, actor, MSG_REPLY);
+        check(parallel_reduce(BEGIN, END, span_body, span_reduce, NULL, nworkers[i], replied) == 0,
+              "parallel_reduce");
+
+        future_wait(replied);
+        future_destroy(replied);
+        free(replied);
+    }
+
+    actor_system_join(actor);
+
+    check(atomic_load(&nreplies) == NRUNS, "replies");
+
+    return 0;
+}
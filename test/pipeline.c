@@ -0,0 +1,131 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "err.h"
+#include "pipeline.h"
+
+/*
+ * Test potoku: przy wolnym ostatnim etapie źródło nie wyprzedza go o więcej
+ * elementów, niż mieszczą paczki oczekujące w etapach, a po końcu strumienia
+ * każdy element jest obsłużony dokładnie raz i pipeline_run kończy działanie.
+ */
+
+#define NITEMS 20000
+#define BATCH_SIZE 16
+#define NSTAGES 3
+
+static long nproduced;
+static long max_ahead;
+static atomic_long nconsumed = 0, nfiltered = 0, sum = 0;
+static atomic_int seen[NITEMS + 1];
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void *source(void *context) {
+    (void) context;
+
+    if (nproduced == NITEMS) {
+        return NULL;
+    }
+
+    long ahead = ++nproduced - atomic_load(&nconsumed) - atomic_load(&nfiltered);
+    if (ahead > max_ahead) {
+        max_ahead = ahead;
+    }
+
+    return (void *) (intptr_t) nproduced;
+}
+
+static void *triple(void *item, void *context) {
+    (void) context;
+
+    return (void *) ((intptr_t) item * 3);
+}
+
+static void *filter(void *item, void *context) {
+    (void) context;
+
+    if ((intptr_t) item % 2 != 0) {
+        atomic_fetch_add(&nfiltered, 1);
+        return NULL;
+    }
+
+    return item;
+}
+
+static void *sink(void *item, void *context) {
+    (void) context;
+
+    long value = (long) (intptr_t) item;
+    check(atomic_fetch_add(&seen[value / 3], 1) == 0, "item seen twice");
+    atomic_fetch_add(&sum, value);
+
+    usleep(10);
+    atomic_fetch_add(&nconsumed, 1);
+
+    return NULL;
+}
+
+static void *empty_source(void *context) {
+    (void) context;
+
+    return NULL;
+}
+
+int main(void) {
+    const pipeline_stage_t stages[NSTAGES] = {
+            {.func = triple, .parallelism = 3},
+            {.func = filter, .capacity = 8},
+            {.func = sink, .parallelism = 2, .capacity = 2}
+    };
+    pipeline_t pipeline = {
+            .source = source,
+            .nstages = NSTAGES,
+            .stages = stages,
+            .batch_size = BATCH_SIZE
+    };
+
+    check(pipeline_run(&pipeline) == 0, "pipeline_run");
+
+    long expected = 0;
+    for (long i = 1; i <= NITEMS; ++i) {
+        if (i * 3 % 2 == 0) {
+            expected += i * 3;
+        }
+    }
+
+    long nconsumed_after = atomic_load(&nconsumed);
+    check(nproduced == NITEMS, "end of stream");
+    check(nconsumed_after + atomic_load(&nfiltered) == NITEMS, "items lost");
+    check(atomic_load(&sum) == expected, "sum");
+
+    // Każdy aktor etapu ma co najwyżej capacity paczek w skrzynce, jedną w obsłudze
+    // i jedną w budowie, a źródło - jedną w budowie.
+    long limit = BATCH_SIZE;
+    for (int i = 0; i < NSTAGES; ++i) {
+        unsigned int parallelism = stages[i].parallelism == 0 ? 1 : stages[i].parallelism;
+        unsigned int capacity = stages[i].capacity == 0 ? PIPELINE_CAPACITY : stages[i].capacity;
+        limit += (long) parallelism * (capacity + 2) * BATCH_SIZE;
+    }
+    check(max_ahead <= limit, "backpressure");
+    check(max_ahead < NITEMS / 2, "source ran ahead");
+
+    usleep(10000);
+    check(atomic_load(&nconsumed) == nconsumed_after, "stage called after pipeline_run");
+
+    pipeline.source = empty_source;
+    check(pipeline_run(&pipeline) == 0, "empty stream");
+    check(atomic_load(&nconsumed) == nconsumed_after, "items in empty stream");
+
+    pipeline.nstages = 0;
+    check(pipeline_run(&pipeline) == -2, "no stages");
+
+    return 0;
+}
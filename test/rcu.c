@@ -0,0 +1,157 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "rcu.h"
+
+/*
+ * Test danych współdzielonych: aktorzy czytają kolejne wersje publikowane przez
+ * siebie i przez wątek spoza systemu, a żadna wersja nie jest zwalniana (i zamazywana),
+ * póki czyta ją obsługa komunikatu. Zastąpione wersje są zwalniane już w trakcie
+ * działania systemu, ostatnia - przez rcu_free.
+ */
+
+#define MSG_READ (message_type_t) 0x01
+
+#define NREADERS 16
+#define NVALUES 64
+#define NPUBLISHED 200
+#define PUBLISH_EVERY 64
+#define WAIT_LIMIT 10000
+
+typedef struct table {
+    long version;
+    long values[NVALUES];
+} table_t;
+
+static rcu_t *shared;
+static atomic_long npublished = 0, nreleased = 0, ncorrupted = 0, nreads = 0;
+static atomic_bool is_stopped = false;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static table_t *table_new(long version) {
+    table_t *table = malloc(sizeof(table_t));
+    check(table != NULL, "malloc");
+
+    table->version = version;
+    for (int i = 0; i < NVALUES; ++i) {
+        table->values[i] = version * NVALUES + i;
+    }
+    atomic_fetch_add(&npublished, 1);
+
+    return table;
+}
+
+static void table_release(void *data) {
+    // Zamazanie ujawnia odczyt zwolnionej wersji.
+    memset(data, 0xAB, sizeof(table_t));
+    free(data);
+    atomic_fetch_add(&nreleased, 1);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+
+static void reader(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts[] = {hello, reader};
+static role_t role = {.nprompts = 2, .prompts = prompts};
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    if ((actor_id_t) data == -1) {
+        actor_id_t first = spawn_many(&role, NREADERS, NULL);
+        check(first > 0, "spawn_many");
+    }
+
+    send_message(actor_id_self(), (message_t) {MSG_READ, 0, NULL});
+}
+
+static void reader(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    const table_t *table = rcu_read(shared);
+    long version = table->version;
+
+    // Odczyt trwa, podczas gdy inne wątki publikują nowe wersje.
+    for (int round = 0; round < 8; ++round) {
+        for (int i = 0; i < NVALUES; ++i) {
+            if (table->values[i] != version * NVALUES + i) {
+                atomic_fetch_add(&ncorrupted, 1);
+            }
+        }
+    }
+
+    if (atomic_fetch_add(&nreads, 1) % PUBLISH_EVERY == 0) {
+        rcu_publish(shared, table_new(-version - 1));
+    }
+
+    if (atomic_load(&is_stopped)) {
+        send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+    }
+    else {
+        send_message(actor_id_self(), (message_t) {MSG_READ, 0, NULL});
+    }
+}
+
+/*
+ * Wątek spoza systemu publikuje wersje, czeka, aż zastąpione wersje zaczną
+ * być zwalniane w trakcie działania aktorów, i kończy ich pracę.
+ */
+static void *publisher(void *data) {
+    bool *is_reclaimed = data;
+
+    for (long version = 1; version <= NPUBLISHED; ++version) {
+        rcu_publish(shared, table_new(version));
+        usleep(100);
+    }
+
+    for (int i = 0; i < WAIT_LIMIT && atomic_load(&nreleased) < NPUBLISHED / 2; ++i) {
+        usleep(1000);
+    }
+    *is_reclaimed = atomic_load(&nreleased) >= NPUBLISHED / 2;
+
+    atomic_store(&is_stopped, true);
+
+    return NULL;
+}
+
+int main(void) {
+    shared = rcu_new(table_new(0), table_release);
+
+    actor_id_t actor;
+    if (actor_system_create(&actor, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    pthread_t thread;
+    bool is_reclaimed = false;
+    check(pthread_create(&thread, NULL, publisher, &is_reclaimed) == 0, "pthread_create");
+
+    actor_system_join(actor);
+    check(pthread_join(thread, NULL) == 0, "pthread_join");
+
+    check(atomic_load(&ncorrupted) == 0, "released version read");
+    check(is_reclaimed, "no reclamation while running");
+    check(atomic_load(&nreleased) == atomic_load(&npublished) - 1, "versions left after join");
+
+    rcu_free(shared);
+
+    check(atomic_load(&nreleased) == atomic_load(&npublished), "versions left after rcu_free");
+    check(!rcu_is_pending(), "pending versions");
+
+    return 0;
+}
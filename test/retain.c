@@ -0,0 +1,140 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cacti.h"
+#include "err.h"
+
+/*
+ * Test kolejnych systemów aktorów z zachowywanymi zasobami: dla każdego
+ * zestawu flag actor_system_retain (zmienianego także między systemami) każdy
+ * system zaczyna z czystą tablicą aktorów, stanami i skrzynkami, obsługuje
+ * wszystkie komunikaty, a zachowane wątki robocze są używane ponownie.
+ */
+
+#define MSG_ADD (message_type_t) 0x01
+#define MSG_FINISH (message_type_t) 0x02
+
+#define NCYCLES 20
+#define NCHILDREN 16
+#define NMESSAGES 50
+#define NTHREADS_LIMIT 64
+
+static const int flags[] = {0, RETAIN_THREADS, RETAIN_MEMORY, RETAIN_THREADS | RETAIN_MEMORY, 0};
+
+static atomic_long total = 0;
+static atomic_int nstale = 0;
+
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t threads[NTHREADS_LIMIT];
+static int nthreads = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+/*
+ * Funkcja zapisuje wątek obsługujący komunikat.
+ */
+static void note_thread(void) {
+    pthread_mutex_lock(&threads_lock);
+
+    bool is_known = false;
+    for (int i = 0; i < nthreads && !is_known; ++i) {
+        is_known = pthread_equal(threads[i], pthread_self());
+    }
+
+    if (!is_known && nthreads < NTHREADS_LIMIT) {
+        threads[nthreads++] = pthread_self();
+    }
+
+    pthread_mutex_unlock(&threads_lock);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+
+static void add(void **stateptr, size_t nbytes, void *data);
+
+static void finish(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts[] = {hello, add, finish};
+static role_t role = {.nprompts = 3, .prompts = prompts};
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+
+    // Stan aktora z zachowanej pamięci nie może pochodzić z poprzedniego systemu.
+    if (*stateptr != NULL) {
+        atomic_fetch_add(&nstale, 1);
+    }
+    *stateptr = malloc(sizeof(long));
+    check(*stateptr != NULL, "malloc");
+    *(long *) *stateptr = 0;
+
+    if ((actor_id_t) data != -1) {
+        // Aktor utworzony przez pierwszego aktora (MSG_HELLO pierwszego aktora
+        // jest obsługiwany przez wątek tworzący system).
+        note_thread();
+
+        for (long i = 1; i <= NMESSAGES; ++i) {
+            send_message(actor_id_self(), (message_t) {MSG_ADD, 0, (void *) i});
+        }
+        send_message(actor_id_self(), (message_t) {MSG_FINISH, 0, NULL});
+        return;
+    }
+
+    check(actor_id_self() == 1, "first actor id");
+
+    actor_id_t first = spawn_many(&role, NCHILDREN, NULL);
+    check(first == 2, "spawned actor ids");
+
+    send_message(actor_id_self(), (message_t) {MSG_FINISH, 0, NULL});
+}
+
+static void add(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+
+    note_thread();
+    *(long *) *stateptr += (long) data;
+}
+
+static void finish(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+
+    // Stan nie jest zerowany: zachowana pamięć nie może przenieść go do kolejnego systemu.
+    atomic_fetch_add(&total, *(long *) *stateptr);
+    free(*stateptr);
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+        check(actor_system_retain(flags[i]) == 0, "actor_system_retain");
+
+        atomic_store(&total, 0);
+        nthreads = 0;
+
+        for (int cycle = 0; cycle < NCYCLES; ++cycle) {
+            actor_id_t actor;
+            check(actor_system_create(&actor, &role) == 0, "actor_system_create");
+            check(actor_system_retain(0) == -1, "actor_system_retain while running");
+            actor_system_join(actor);
+        }
+
+        check(atomic_load(&nstale) == 0, "stale actor state");
+        check(atomic_load(&total) == (long) NCYCLES * NCHILDREN * NMESSAGES * (NMESSAGES + 1) / 2, "messages");
+
+        if (flags[i] & RETAIN_THREADS) {
+            // Kolejne systemy są obsługiwane przez te same wątki.
+            check(nthreads <= POOL_SIZE, "retained threads");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "router.h"
+
+/*
+ * Test routera: po dodaniu aktora docelowego zmieniają przypisanie tylko klucze
+ * przeniesione do niego, po jego usunięciu wszystkie klucze wracają na miejsce,
+ * a po usunięciu innego aktora zmieniają przypisanie tylko jego klucze.
+ * Komunikaty wysłane po zatrzymaniu routera trafiają do funkcji undelivered.
+ */
+
+#define MSG_RECORD (message_type_t) 0x01
+
+#define NROUTEES 4
+// Wszystkie komunikaty jednej fazy mieszczą się w skrzynce routera (ACTOR_QUEUE_LIMIT).
+#define NKEYS 1000
+#define WAIT_LIMIT 10000
+
+static _Atomic actor_id_t owners[NKEYS];
+static atomic_long nrecorded = 0, nundelivered = 0;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void record(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+
+    atomic_store(&owners[(long) data], actor_id_self());
+    atomic_fetch_add(&nrecorded, 1);
+}
+
+static act_t prompts[] = {hello, record};
+static role_t role = {.nprompts = 2, .prompts = prompts};
+
+static void undelivered(long key, message_t message) {
+    check(message.message_type == MSG_RECORD && (long) message.data == key, "undelivered message");
+    atomic_fetch_add(&nundelivered, 1);
+}
+
+/*
+ * Funkcja czeka (co najwyżej WAIT_LIMIT ms), aż licznik osiągnie wartość expected.
+ */
+static void wait_for(atomic_long *counter, long expected, const char *what) {
+    for (int i = 0; i < WAIT_LIMIT && atomic_load(counter) < expected; ++i) {
+        usleep(1000);
+    }
+
+    check(atomic_load(counter) == expected, what);
+}
+
+/*
+ * Funkcja wysyła przez router komunikat z każdym kluczem i zapisuje w result
+ * aktorów, którzy je obsłużyli.
+ */
+static void route_all(actor_id_t router, actor_id_t *result) {
+    long expected = atomic_load(&nrecorded) + NKEYS;
+
+    for (long key = 0; key < NKEYS; ++key) {
+        check(router_send(router, key, (message_t) {MSG_RECORD, 0, (void *) key}) == 0, "router_send");
+    }
+    wait_for(&nrecorded, expected, "routed messages");
+
+    for (long key = 0; key < NKEYS; ++key) {
+        result[key] = atomic_load(&owners[key]);
+    }
+}
+
+static actor_id_t before[NKEYS], added[NKEYS], restored[NKEYS], removed[NKEYS];
+
+int main(void) {
+    actor_id_t root;
+    if (actor_system_create(&root, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    actor_id_t first = spawn_many(&role, NROUTEES + 1, NULL);
+    check(first > 0, "spawn_many");
+
+    actor_id_t routees[NROUTEES + 1];
+    for (int i = 0; i <= NROUTEES; ++i) {
+        routees[i] = first + i;
+    }
+
+    // Dzielenie gorących kluczy zmieniałoby przypisanie niezależnie od pierścienia.
+    router_config_t config = {
+            .routees = routees,
+            .nroutees = NROUTEES,
+            .split_limit = 1,
+            .undelivered = undelivered
+    };
+    actor_id_t router = router_spawn(&config);
+    check(router > 0, "router_spawn");
+
+    route_all(router, before);
+
+    check(router_add(router, routees[NROUTEES]) == 0, "router_add");
+    route_all(router, added);
+
+    long nmoved = 0;
+    for (long key = 0; key < NKEYS; ++key) {
+        if (added[key] != before[key]) {
+            check(added[key] == routees[NROUTEES], "key moved between old routees");
+            nmoved++;
+        }
+    }
+    check(nmoved > 0 && nmoved < 2 * NKEYS / (NROUTEES + 1), "keys moved to the new routee");
+
+    check(router_remove(router, routees[NROUTEES]) == 0, "router_remove");
+    route_all(router, restored);
+
+    for (long key = 0; key < NKEYS; ++key) {
+        check(restored[key] == before[key], "key not restored");
+    }
+
+    check(router_remove(router, routees[0]) == 0, "router_remove");
+    route_all(router, removed);
+
+    for (long key = 0; key < NKEYS; ++key) {
+        if (before[key] == routees[0]) {
+            check(removed[key] != routees[0], "key left on the removed routee");
+        }
+        else {
+            check(removed[key] == before[key], "key moved between remaining routees");
+        }
+    }
+
+    // Komunikaty za MSG_ROUTER_STOP w skrzynce routera nie są już przekazywane.
+    check(router_stop(router) == 0, "router_stop");
+    long nrejected = 0;
+    for (long key = 0; key < NKEYS; ++key) {
+        nrejected += router_send(router, key, (message_t) {MSG_RECORD, 0, (void *) key}) != 0;
+    }
+    wait_for(&nundelivered, NKEYS - nrejected, "undelivered messages");
+
+    for (int i = 0; i <= NROUTEES; ++i) {
+        send_message(routees[i], (message_t) {MSG_GODIE, 0, NULL});
+    }
+    send_message(root, (message_t) {MSG_GODIE, 0, NULL});
+    actor_system_join(root);
+
+    check(atomic_load(&nrecorded) == 4 * NKEYS, "messages after stop");
+
+    return 0;
+}
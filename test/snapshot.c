@@ -0,0 +1,253 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "snapshot.h"
+
+/*
+ * Test utrwalania: wątki spoza systemu wysyłają liczniki do aktorów, podczas gdy
+ * wątek główny wykonuje kolejne migawki. Po zakończeniu system jest odtwarzany
+ * z migawki i dziennika, a stany liczników porównywane z osiągniętymi wcześniej.
+ */
+
+#define MSG_ADD (message_type_t) 0x01
+#define MSG_SPAWN_COUNTERS (message_type_t) 0x01
+#define MSG_FINISH (message_type_t) 0x02
+
+#define NCOUNTERS 64
+#define NSENDERS 4
+#define NMESSAGES 20000
+#define NSNAPSHOTS 8
+
+#define PATH "snapshot_test.bin"
+#define LOG_PATH PATH ".log"
+
+typedef struct counter {
+    long total;
+    long count;
+} counter_t;
+
+static atomic_long first_counter = -1;
+
+static counter_t live[NCOUNTERS], restored[NCOUNTERS];
+static counter_t *results = live;
+
+static void root_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void root_spawn(void **stateptr, size_t nbytes, void *data);
+
+static void root_finish(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+static void counter_hello(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+
+    if (*stateptr == NULL) {
+        *stateptr = calloc(1, sizeof(counter_t));
+    }
+}
+
+static void counter_add(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+
+    counter_t *counter = *stateptr;
+    counter->total += (long) data;
+    counter->count++;
+}
+
+static void counter_finish(void **stateptr, size_t nbytes, void *data) {
+    (void) nbytes;
+    (void) data;
+
+    counter_t *counter = *stateptr;
+    results[actor_id_self() - atomic_load(&first_counter)] = *counter;
+    free(counter);
+    *stateptr = NULL;
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+static size_t counter_serialize(message_type_t type, void *object, size_t nbytes, void *buffer, size_t size) {
+    (void) nbytes;
+
+    if (type == MSG_STATE) {
+        if (size >= sizeof(counter_t)) {
+            memcpy(buffer, object, sizeof(counter_t));
+        }
+        return sizeof(counter_t);
+    }
+
+    if (type == MSG_ADD) {
+        if (size >= sizeof(long)) {
+            memcpy(buffer, &object, sizeof(long));
+        }
+        return sizeof(long);
+    }
+
+    return 0;
+}
+
+static void *counter_deserialize(message_type_t type, const void *buffer, size_t size) {
+    if (type == MSG_STATE) {
+        counter_t *counter = malloc(sizeof(counter_t));
+        memcpy(counter, buffer, size);
+        return counter;
+    }
+
+    if (type == MSG_ADD) {
+        long value;
+        memcpy(&value, buffer, sizeof(long));
+        return (void *) value;
+    }
+
+    return NULL;
+}
+
+static act_t root_prompts[] = {root_hello, root_spawn, root_finish};
+static act_t counter_prompts[] = {counter_hello, counter_add, counter_finish};
+
+static role_t root_role = {
+        .nprompts = 3,
+        .prompts = root_prompts,
+        .serialize = counter_serialize,
+        .deserialize = counter_deserialize
+};
+static role_t counter_role = {
+        .nprompts = 3,
+        .prompts = counter_prompts,
+        .serialize = counter_serialize,
+        .deserialize = counter_deserialize
+};
+
+static role_t *const roles[] = {&root_role, &counter_role};
+
+static void root_spawn(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    atomic_store(&first_counter, spawn_many(&counter_role, NCOUNTERS, NULL));
+}
+
+/*
+ * Wartość wysyłana przez nadawcę sender w komunikacie i.
+ */
+static long value(long sender, long i) {
+    return sender * NMESSAGES + i + 1;
+}
+
+static void *sender(void *arg) {
+    long id = (long) arg;
+    actor_id_t first = atomic_load(&first_counter);
+
+    for (long i = 0; i < NMESSAGES; ++i) {
+        message_t message = {MSG_ADD, 0, (void *) value(id, i)};
+
+        int result;
+        while ((result = send_message(first + i % NCOUNTERS, message)) == -3) {
+            // Skrzynka aktora jest pełna.
+            usleep(100);
+        }
+
+        if (result != 0) {
+            fatal("send_message: %d", result);
+        }
+    }
+
+    return NULL;
+}
+
+int main(void) {
+    int err;
+
+    unlink(PATH);
+    unlink(LOG_PATH);
+
+    actor_id_t root;
+    if (actor_system_create(&root, &root_role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    send_message(root, (message_t) {MSG_SPAWN_COUNTERS, 0, NULL});
+    while (atomic_load(&first_counter) < 0) {
+        usleep(1000);
+    }
+
+    if ((err = actor_system_persist(PATH, roles, 2)) != 0) {
+        fatal("actor_system_persist: %d", err);
+    }
+
+    pthread_t senders[NSENDERS];
+    for (long i = 0; i < NSENDERS; ++i) {
+        if ((err = pthread_create(&senders[i], NULL, sender, (void *) i)) != 0) {
+            syserr(err, "pthread_create");
+        }
+    }
+
+    for (int i = 0; i < NSNAPSHOTS; ++i) {
+        usleep(2000);
+        if ((err = actor_system_snapshot()) != 0) {
+            fatal("actor_system_snapshot: %d", err);
+        }
+    }
+
+    for (int i = 0; i < NSENDERS; ++i) {
+        if ((err = pthread_join(senders[i], NULL)) != 0) {
+            syserr(err, "pthread_join");
+        }
+    }
+
+    actor_id_t first = atomic_load(&first_counter);
+    for (actor_id_t i = 0; i < NCOUNTERS; ++i) {
+        send_message(first + i, (message_t) {MSG_FINISH, 0, NULL});
+    }
+    send_message(root, (message_t) {MSG_FINISH, 0, NULL});
+
+    actor_system_join(root);
+
+    // Odtworzony system powtarza komunikaty z dziennika, w tym MSG_FINISH.
+    results = restored;
+    if ((err = actor_system_restore(&root, PATH, roles, 2)) != 0) {
+        fatal("actor_system_restore: %d", err);
+    }
+    actor_system_join(root);
+
+    unlink(PATH);
+    unlink(LOG_PATH);
+
+    for (long i = 0; i < NCOUNTERS; ++i) {
+        long total = 0, count = 0;
+        for (long s = 0; s < NSENDERS; ++s) {
+            for (long j = i; j < NMESSAGES; j += NCOUNTERS) {
+                total += value(s, j);
+                count++;
+            }
+        }
+
+        if (live[i].total != total || live[i].count != count) {
+            fatal("counter %ld: %ld/%ld, expected %ld/%ld", i, live[i].total, live[i].count, total, count);
+        }
+
+        if (restored[i].total != live[i].total || restored[i].count != live[i].count) {
+            fatal("restored counter %ld: %ld/%ld, expected %ld/%ld",
+                  i, restored[i].total, restored[i].count, live[i].total, live[i].count);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "transport.h"
+
+/*
+ * Test przesyłania komunikatów między procesami: aktor węzła 0 wysyła do aktora
+ * węzła 1 (procesu potomnego) dane różnych rozmiarów - przekazywane przez wartość,
+ * w pierścieniu, w bloku i w łańcuchu bloków - a ten odsyła je bez zmian.
+ */
+
+#define MSG_ECHO (message_type_t) 0x01
+#define MSG_REPLY (message_type_t) 0x02
+#define MSG_START (message_type_t) 0x03
+
+#define NNODES 2
+#define NPAYLOADS 8
+
+/*
+ * Kod wyjścia oznaczający pominięcie testu (brak pamięci współdzielonej).
+ */
+#define SKIP 77
+
+static const size_t sizes[NPAYLOADS] = {
+        8, TRANSPORT_INLINE_SIZE, TRANSPORT_INLINE_SIZE + 1, 100,
+        TRANSPORT_BLOCK_SIZE, TRANSPORT_BLOCK_SIZE + 1, 3 * TRANSPORT_BLOCK_SIZE, 50 * TRANSPORT_BLOCK_SIZE + 17
+};
+
+static bool is_received[NPAYLOADS];
+static int nreceived;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+/*
+ * Bajt i danych o rozmiarze size.
+ */
+static unsigned char pattern(size_t size, size_t i) {
+    return (unsigned char) (size * 31 + i * 7);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void echo(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+
+    // Kopia, bo dane z bloku współdzielonego byłyby przekazane bez kopiowania.
+    void *copy = malloc(nbytes);
+    check(copy != NULL, "malloc");
+    memcpy(copy, data, nbytes);
+    transport_free(data);
+
+    check(send_message(actor_id_remote(0, 1), (message_t) {MSG_REPLY, nbytes, copy}) == 0, "send reply");
+    free(copy);
+}
+
+static void reply(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+
+    int index = 0;
+    while (index < NPAYLOADS && sizes[index] != nbytes) {
+        index++;
+    }
+    check(index < NPAYLOADS && !is_received[index], "reply size");
+
+    for (size_t i = 0; i < nbytes; ++i) {
+        check(((unsigned char *) data)[i] == pattern(nbytes, i), "reply data");
+    }
+    transport_free(data);
+
+    is_received[index] = true;
+    if (++nreceived == NPAYLOADS) {
+        send_message(actor_id_remote(1, 1), (message_t) {MSG_GODIE, 0, NULL});
+        send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+    }
+}
+
+static void start(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    for (int i = 0; i < NPAYLOADS; ++i) {
+        // Dane mieszczące się w bloku są przekazywane bez kopiowania.
+        unsigned char *payload = sizes[i] <= TRANSPORT_BLOCK_SIZE ? transport_alloc(sizes[i]) : malloc(sizes[i]);
+        check(payload != NULL, "payload");
+
+        for (size_t j = 0; j < sizes[i]; ++j) {
+            payload[j] = pattern(sizes[i], j);
+        }
+
+        check(send_message(actor_id_remote(1, 1), (message_t) {MSG_ECHO, sizes[i], payload}) == 0, "send echo");
+        if (sizes[i] > TRANSPORT_BLOCK_SIZE) {
+            free(payload);
+        }
+    }
+}
+
+static act_t prompts[] = {hello, echo, reply, start};
+static role_t role = {.nprompts = 4, .prompts = prompts};
+
+/*
+ * Funkcja uruchamia system aktorów węzła node. Zwraca wynik transport_open.
+ */
+static int run(const char *name, unsigned int node) {
+    actor_id_t actor;
+    if (actor_system_create(&actor, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    int result = transport_open(name, node, NNODES);
+    if (result != 0) {
+        send_message(actor, (message_t) {MSG_GODIE, 0, NULL});
+        actor_system_join(actor);
+        return result;
+    }
+
+    if (node == 0) {
+        send_message(actor, (message_t) {MSG_START, 0, NULL});
+    }
+    actor_system_join(actor);
+
+    return 0;
+}
+
+int main(void) {
+    char name[64];
+    snprintf(name, sizeof(name), "/cacti_transport_test_%d", (int) getpid());
+    shm_unlink(name);
+
+    pid_t child = fork();
+    if (child < 0) {
+        syserr(errno, "fork");
+    }
+
+    if (child == 0) {
+        exit(run(name, 1) == 0 ? 0 : SKIP);
+    }
+
+    int result = run(name, 0);
+
+    int status;
+    if (waitpid(child, &status, 0) != child) {
+        syserr(errno, "waitpid");
+    }
+
+    if (result != 0) {
+        shm_unlink(name);
+        return result == -2 || result == -3 ? SKIP : 1;
+    }
+
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "node 1");
+    check(nreceived == NPAYLOADS, "replies");
+
+    return 0;
+}
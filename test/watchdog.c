@@ -0,0 +1,122 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "cacti.h"
+#include "err.h"
+#include "watchdog.h"
+
+/*
+ * Test nadzoru czasu obsługi: obsługa przekraczająca limit jest zgłaszana
+ * jednokrotnie, jeszcze w trakcie jej trwania, z id aktora, typem komunikatu
+ * i czasem, a obsługi mieszczące się w limicie (także własnym limicie typu
+ * komunikatu) nie są zgłaszane.
+ */
+
+#define MSG_WITHIN_OWN_BUDGET (message_type_t) 0x01
+#define MSG_STALL (message_type_t) 0x02
+#define MSG_QUICK (message_type_t) 0x03
+
+#define BUDGET 5000
+#define OWN_BUDGET 200000
+#define WAIT_LIMIT 1000
+
+/*
+ * Kod wyjścia oznaczający pominięcie testu (brak nadzoru w wersji jednowątkowej).
+ */
+#define SKIP 77
+
+static atomic_int nreports = 0;
+static _Atomic actor_id_t reported_actor = -1;
+static _Atomic message_type_t reported_prompt = -1;
+static atomic_ulong reported_duration = 0;
+static atomic_bool is_reported_in_time = false;
+
+static void check(bool condition, const char *what) {
+    if (!condition) {
+        fatal("%s", what);
+    }
+}
+
+static void report(actor_id_t actor, message_type_t prompt, unsigned long duration, void *context) {
+    check(context == &nreports, "context");
+
+    atomic_store(&reported_actor, actor);
+    atomic_store(&reported_prompt, prompt);
+    atomic_store(&reported_duration, duration);
+    atomic_fetch_add(&nreports, 1);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void within_own_budget(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    usleep(4 * BUDGET);
+}
+
+static void stall(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    // Zgłoszenie przychodzi, zanim obsługa się zakończy.
+    for (int i = 0; i < WAIT_LIMIT && atomic_load(&nreports) == 0; ++i) {
+        usleep(1000);
+    }
+    atomic_store(&is_reported_in_time, atomic_load(&nreports) == 1);
+
+    // Dalsze trwanie tej samej obsługi nie jest zgłaszane ponownie.
+    usleep(10 * BUDGET);
+
+    send_message(actor_id_self(), (message_t) {MSG_QUICK, 0, NULL});
+}
+
+static void quick(void **stateptr, size_t nbytes, void *data) {
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    send_message(actor_id_self(), (message_t) {MSG_GODIE, 0, NULL});
+}
+
+static act_t prompts[] = {hello, within_own_budget, stall, quick};
+static role_t role = {.nprompts = 4, .prompts = prompts};
+
+int main(void) {
+    actor_id_t actor;
+    if (actor_system_create(&actor, &role) != 0) {
+        fatal("actor_system_create");
+    }
+
+    const unsigned long budgets[] = {0, OWN_BUDGET};
+    int result = actor_system_watchdog(BUDGET, budgets, 2, report, &nreports);
+    if (result == -3) {
+        send_message(actor, (message_t) {MSG_GODIE, 0, NULL});
+        actor_system_join(actor);
+        return SKIP;
+    }
+
+    check(result == 0, "actor_system_watchdog");
+    check(actor_system_watchdog(BUDGET, NULL, 0, NULL, NULL) == -1, "second watchdog");
+
+    send_message(actor, (message_t) {MSG_WITHIN_OWN_BUDGET, 0, NULL});
+    send_message(actor, (message_t) {MSG_STALL, 0, NULL});
+
+    actor_system_join(actor);
+
+    check(atomic_load(&is_reported_in_time), "stall not reported while running");
+    check(atomic_load(&nreports) == 1, "reports");
+    check(atomic_load(&reported_actor) == actor, "reported actor");
+    check(atomic_load(&reported_prompt) == MSG_STALL, "reported prompt");
+    check(atomic_load(&reported_duration) > BUDGET, "reported duration");
+
+    return 0;
+}
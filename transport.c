@@ -0,0 +1,543 @@
+#include "transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "utils.h"
+
+#define TRANSPORT_MAGIC 0x54524F5053435443 // "CTCSPORT"
+#define CACHE_LINE 64
+
+#define REGION_EMPTY 0
+#define REGION_INITIALIZING 1
+#define REGION_READY 2
+
+#define NO_BLOCK 0
+
+#define TRANSPORT_RETRY_DELAY 50
+
+/*
+ * Sposób przekazania danych komunikatu.
+ */
+typedef enum payload_kind {
+    BY_VALUE,
+    INLINE,
+    BLOCK,
+    CHAIN
+} payload_kind_t;
+
+/*
+ * Pozycja pierścienia (jedna linia pamięci podręcznej).
+ */
+typedef struct transport_slot {
+    _Atomic uint64_t sequence;
+    int64_t actor;
+    int64_t message_type;
+    uint64_t nbytes;
+    uint32_t kind;
+    uint32_t size;
+    union {
+        uint64_t value;
+        unsigned char bytes[TRANSPORT_INLINE_SIZE];
+    } payload;
+} transport_slot_t;
+
+/*
+ * Pierścień komunikatów przychodzących do węzła: wielu nadawców, jeden odbiorca
+ * (kolejka z numerami sekwencyjnymi w pozycjach, bez blokad).
+ */
+typedef struct transport_ring {
+    _Alignas(CACHE_LINE) _Atomic uint64_t tail;
+    _Alignas(CACHE_LINE) uint64_t head;
+    _Atomic uint32_t is_sleeping;
+    _Alignas(CACHE_LINE) transport_slot_t slots[TRANSPORT_RING_SIZE];
+} transport_ring_t;
+
+/*
+ * Nagłówek obszaru współdzielonego. Za pierścieniami znajdują się bloki danych.
+ * Wolne bloki tworzą stos (z licznikiem zmian w starszych bitach wierzchołka
+ * przeciw problemowi ABA), numerowany od 1.
+ */
+typedef struct transport_region {
+    uint64_t magic;
+    _Atomic uint32_t state;
+    _Atomic uint32_t attached;
+    uint32_t nnodes;
+    _Alignas(CACHE_LINE) _Atomic uint64_t free_top;
+    uint32_t next_block[TRANSPORT_BLOCKS];
+    transport_ring_t rings[];
+} transport_region_t;
+
+_Static_assert(sizeof(transport_slot_t) == CACHE_LINE, "transport slot must fill one cache line");
+_Static_assert((TRANSPORT_RING_SIZE & (TRANSPORT_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+static size_t region_size(unsigned int nnodes) {
+    size_t header = sizeof(transport_region_t) + nnodes * sizeof(transport_ring_t);
+    header = (header + TRANSPORT_BLOCK_SIZE - 1) / TRANSPORT_BLOCK_SIZE * TRANSPORT_BLOCK_SIZE;
+
+    return header + (size_t) TRANSPORT_BLOCKS * TRANSPORT_BLOCK_SIZE;
+}
+
+static void futex_wait(_Atomic uint32_t *address, uint32_t value) {
+    syscall(SYS_futex, address, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *address) {
+    syscall(SYS_futex, address, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static transport_t *current_transport(void) {
+    return current_actors_system == NULL ? NULL : current_actors_system->transport;
+}
+
+static uint32_t block_pop(transport_region_t *region) {
+    uint64_t top = atomic_load_explicit(&region->free_top, memory_order_acquire);
+    uint64_t next;
+
+    do {
+        uint32_t block = (uint32_t) top;
+        if (block == NO_BLOCK) {
+            return NO_BLOCK;
+        }
+
+        next = ((top >> 32) + 1) << 32 | region->next_block[block - 1];
+    } while (!atomic_compare_exchange_weak_explicit(&region->free_top, &top, next,
+                                                    memory_order_acq_rel, memory_order_acquire));
+
+    return (uint32_t) top;
+}
+
+static void block_push(transport_region_t *region, uint32_t block) {
+    uint64_t top = atomic_load_explicit(&region->free_top, memory_order_relaxed);
+    uint64_t next;
+
+    do {
+        region->next_block[block - 1] = (uint32_t) top;
+        next = ((top >> 32) + 1) << 32 | block;
+    } while (!atomic_compare_exchange_weak_explicit(&region->free_top, &top, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/*
+ * Funkcja zwraca numer bloku zawierającego adres (NO_BLOCK spoza obszaru bloków).
+ */
+static uint32_t block_of(transport_t *transport, const void *data) {
+    const char *address = data;
+    if (address < transport->blocks || address >= transport->blocks + (size_t) TRANSPORT_BLOCKS * TRANSPORT_BLOCK_SIZE) {
+        return NO_BLOCK;
+    }
+
+    return (uint32_t) ((address - transport->blocks) / TRANSPORT_BLOCK_SIZE) + 1;
+}
+
+/*
+ * Funkcja zwraca adres bloku o numerze block.
+ */
+static char *block_address(transport_t *transport, uint32_t block) {
+    return transport->blocks + (size_t) (block - 1) * TRANSPORT_BLOCK_SIZE;
+}
+
+/*
+ * Funkcja zwalnia łańcuch bloków zaczynający się od bloku block.
+ */
+static void chain_free(transport_region_t *region, uint32_t block) {
+    while (block != NO_BLOCK) {
+        uint32_t next = region->next_block[block - 1];
+        block_push(region, block);
+        block = next;
+    }
+}
+
+/*
+ * Funkcja kopiuje nbytes bajtów do łańcucha bloków. Zajęte bloki są łączone
+ * przez next_block (wolne bloki używają go w stosie). Zwraca numer pierwszego
+ * bloku, NO_BLOCK gdy zabrakło wolnych bloków.
+ */
+static uint32_t chain_put(transport_t *transport, const void *data, size_t nbytes) {
+    transport_region_t *region = transport->region;
+    uint32_t first = NO_BLOCK, last = NO_BLOCK;
+
+    for (size_t offset = 0; offset < nbytes; offset += TRANSPORT_BLOCK_SIZE) {
+        uint32_t block = block_pop(region);
+        if (block == NO_BLOCK) {
+            chain_free(region, first);
+            return NO_BLOCK;
+        }
+
+        size_t size = nbytes - offset < TRANSPORT_BLOCK_SIZE ? nbytes - offset : TRANSPORT_BLOCK_SIZE;
+        memcpy(block_address(transport, block), (const char *) data + offset, size);
+        region->next_block[block - 1] = NO_BLOCK;
+
+        if (last == NO_BLOCK) {
+            first = block;
+        } else {
+            region->next_block[last - 1] = block;
+        }
+        last = block;
+    }
+
+    return first;
+}
+
+/*
+ * Funkcja scala łańcuch bloków z danymi o rozmiarze nbytes w nowym buforze
+ * i zwalnia bloki łańcucha.
+ */
+static void *chain_take(transport_t *transport, uint32_t block, size_t nbytes) {
+    transport_region_t *region = transport->region;
+
+    char *data;
+    malloc_and_check(data, nbytes);
+
+    for (size_t offset = 0; offset < nbytes; offset += TRANSPORT_BLOCK_SIZE) {
+        size_t size = nbytes - offset < TRANSPORT_BLOCK_SIZE ? nbytes - offset : TRANSPORT_BLOCK_SIZE;
+        memcpy(data + offset, block_address(transport, block), size);
+
+        uint32_t next = region->next_block[block - 1];
+        block_push(region, block);
+        block = next;
+    }
+
+    return data;
+}
+
+static void region_init(transport_region_t *region, unsigned int nnodes) {
+    region->magic = TRANSPORT_MAGIC;
+    region->nnodes = nnodes;
+
+    for (uint32_t block = 1; block <= TRANSPORT_BLOCKS; ++block) {
+        region->next_block[block - 1] = block == TRANSPORT_BLOCKS ? NO_BLOCK : block + 1;
+    }
+    atomic_store(&region->free_top, 1);
+
+    for (unsigned int node = 0; node < nnodes; ++node) {
+        transport_ring_t *ring = &region->rings[node];
+        atomic_store(&ring->tail, 0);
+        ring->head = 0;
+        atomic_store(&ring->is_sleeping, 0);
+
+        for (uint64_t i = 0; i < TRANSPORT_RING_SIZE; ++i) {
+            atomic_store(&ring->slots[i].sequence, i);
+        }
+    }
+}
+
+/*
+ * Funkcja zdejmuje komunikat z pierścienia węzła. Zwraca false, gdy pierścień jest pusty.
+ */
+static bool ring_pop(transport_t *transport, transport_ring_t *ring, actor_id_t *actor, message_t *message) {
+    uint64_t position = ring->head;
+    transport_slot_t *slot = &ring->slots[position & (TRANSPORT_RING_SIZE - 1)];
+
+    if (atomic_load_explicit(&slot->sequence, memory_order_seq_cst) != position + 1) {
+        return false;
+    }
+
+    *actor = slot->actor;
+    message->message_type = slot->message_type;
+    message->nbytes = slot->nbytes;
+
+    switch (slot->kind) {
+        case BY_VALUE: {
+            message->data = (void *) (uintptr_t) slot->payload.value;
+            break;
+        }
+        case INLINE: {
+            malloc_and_check(message->data, slot->size);
+            memcpy(message->data, slot->payload.bytes, slot->size);
+            break;
+        }
+        case CHAIN: {
+            message->data = chain_take(transport, (uint32_t) slot->payload.value + 1, slot->nbytes);
+            break;
+        }
+        default: {
+            // Dane pozostają w bloku współdzielonym.
+            message->data = transport->blocks + slot->payload.value * TRANSPORT_BLOCK_SIZE;
+            break;
+        }
+    }
+
+    atomic_store_explicit(&slot->sequence, position + TRANSPORT_RING_SIZE, memory_order_release);
+    ring->head = position + 1;
+
+    return true;
+}
+
+/*
+ * Funkcja wątku odbierającego komunikaty z pierścienia węzła
+ * i przekazującego je lokalnym aktorom.
+ */
+static void *transport_func(void *data) {
+    transport_t *transport = data;
+    transport_ring_t *ring = &transport->region->rings[transport->node];
+
+    while (!atomic_load(&transport->is_stopping)) {
+        actor_id_t actor;
+        message_t message;
+
+        if (!ring_pop(transport, ring, &actor, &message)) {
+            // Zasypianie: nadawca budzi odbiorcę, widząc ustawiony znacznik.
+            atomic_store(&ring->is_sleeping, 1);
+
+            if (!ring_pop(transport, ring, &actor, &message)) {
+                if (!atomic_load(&transport->is_stopping)) {
+                    futex_wait(&ring->is_sleeping, 1);
+                }
+                continue;
+            }
+
+            atomic_store(&ring->is_sleeping, 0);
+        }
+
+        int result;
+        while ((result = send_message(actor, message)) == -3 && !atomic_load(&transport->is_stopping)) {
+            // Pełna kolejka aktora - pierścień przestaje być opróżniany,
+            // więc nadawcy z innych procesów również dostają -3.
+            usleep(TRANSPORT_RETRY_DELAY);
+        }
+
+        if (result != 0 && message.nbytes > 0 && message.message_type != MSG_HELLO) {
+            // Komunikat nie został przyjęty - jego dane należy zwolnić.
+            transport_free(message.data);
+        }
+    }
+
+    return 0;
+}
+
+int transport_open(const char *name, unsigned int node, unsigned int nnodes) {
+    if (current_actors_system == NULL || current_actors_system->transport != NULL || node >= nnodes) {
+        return -1;
+    }
+
+#ifdef SINGLE_THREADED
+    // Wątek odbierający wymaga blokad pomijanych w trybie jednowątkowym.
+    return -3;
+#endif
+
+    int err;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -2;
+    }
+
+    size_t size = region_size(nnodes);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t) st.st_size < size && ftruncate(fd, size) != 0)) {
+        close(fd);
+        return -2;
+    }
+
+    transport_region_t *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return -2;
+    }
+
+    // Obszar inicjuje pierwszy dołączający proces.
+    uint32_t state = REGION_EMPTY;
+    if (atomic_compare_exchange_strong(&region->state, &state, REGION_INITIALIZING)) {
+        region_init(region, nnodes);
+        atomic_store(&region->state, REGION_READY);
+    } else {
+        while (atomic_load(&region->state) != REGION_READY) {
+            sched_yield();
+        }
+    }
+
+    if (region->magic != TRANSPORT_MAGIC || region->nnodes != nnodes) {
+        munmap(region, size);
+        return -2;
+    }
+
+    atomic_fetch_add(&region->attached, 1);
+
+    transport_t *transport;
+    malloc_and_check(transport, sizeof(transport_t));
+
+    size_t length = strlen(name);
+    malloc_and_check(transport->name, length + 1);
+    memcpy(transport->name, name, length + 1);
+
+    transport->node = node;
+    transport->nnodes = nnodes;
+    transport->region = region;
+    transport->region_size = size;
+    transport->blocks = (char *) region + size - (size_t) TRANSPORT_BLOCKS * TRANSPORT_BLOCK_SIZE;
+    atomic_store(&transport->is_stopping, false);
+
+    entity_lock(current_actors_system);
+    current_actors_system->transport = transport;
+    entity_unlock(current_actors_system);
+
+    check_if_error(pthread_create(&transport->thread, NULL, transport_func, transport),
+                   "pthread create failed");
+
+    return 0;
+}
+
+actor_id_t actor_id_global(actor_id_t actor) {
+    transport_t *transport = current_transport();
+    if (transport == NULL || actor <= 0 || actor >= TRANSPORT_NODE_BASE) {
+        return actor;
+    }
+
+    return actor_id_remote(transport->node, actor);
+}
+
+actor_id_t actor_id_remote(unsigned int node, actor_id_t actor) {
+    return ((actor_id_t) node + 1) << TRANSPORT_NODE_SHIFT | actor;
+}
+
+void *transport_alloc(size_t size) {
+    transport_t *transport = current_transport();
+    if (transport == NULL || size > TRANSPORT_BLOCK_SIZE) {
+        return NULL;
+    }
+
+    uint32_t block = block_pop(transport->region);
+    if (block == NO_BLOCK) {
+        return NULL;
+    }
+
+    return block_address(transport, block);
+}
+
+void transport_free(void *data) {
+    transport_t *transport = current_transport();
+    uint32_t block = transport == NULL ? NO_BLOCK : block_of(transport, data);
+
+    if (block == NO_BLOCK) {
+        free(data);
+    } else {
+        block_push(transport->region, block);
+    }
+}
+
+int transport_send(actor_id_t actor, message_t message) {
+    transport_t *transport = current_transport();
+    if (transport == NULL) {
+        return -2;
+    }
+
+    unsigned int node = (unsigned int) (actor >> TRANSPORT_NODE_SHIFT) - 1;
+    actor_id_t local = actor & (TRANSPORT_NODE_BASE - 1);
+
+    if (node == transport->node) {
+        return send_message(local, message);
+    }
+
+    if (node >= transport->nnodes || message.message_type == MSG_SPAWN) {
+        // Rola (wskaźnik na funkcje) nie ma znaczenia w innym procesie.
+        return node >= transport->nnodes ? -2 : -4;
+    }
+
+    transport_slot_t payload = {
+            .actor = local,
+            .message_type = message.message_type,
+            .nbytes = message.nbytes
+    };
+
+    uint32_t block = block_of(transport, message.data);
+    void *copy = NULL;
+    uint32_t chain = NO_BLOCK;
+
+    if (message.nbytes == 0 || message.message_type == MSG_HELLO) {
+        payload.kind = BY_VALUE;
+        payload.payload.value = (uint64_t) (uintptr_t) message.data;
+    } else if (block != NO_BLOCK) {
+        // Dane są już w obszarze współdzielonym - bez kopiowania.
+        payload.kind = BLOCK;
+        payload.payload.value = block - 1;
+    } else if (message.nbytes <= TRANSPORT_INLINE_SIZE) {
+        payload.kind = INLINE;
+        payload.size = message.nbytes;
+        memcpy(payload.payload.bytes, message.data, message.nbytes);
+    } else if (message.nbytes <= TRANSPORT_BLOCK_SIZE) {
+        if ((copy = transport_alloc(message.nbytes)) == NULL) {
+            return -4;
+        }
+        memcpy(copy, message.data, message.nbytes);
+        payload.kind = BLOCK;
+        payload.payload.value = block_of(transport, copy) - 1;
+    } else {
+        // Większe dane są dzielone na łańcuch bloków, scalany przez odbiorcę.
+        if ((chain = chain_put(transport, message.data, message.nbytes)) == NO_BLOCK) {
+            return -4;
+        }
+        payload.kind = CHAIN;
+        payload.payload.value = chain - 1;
+    }
+
+    transport_ring_t *ring = &transport->region->rings[node];
+    uint64_t position = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    transport_slot_t *slot;
+
+    while (true) {
+        slot = &ring->slots[position & (TRANSPORT_RING_SIZE - 1)];
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t difference = (int64_t) (sequence - position);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Pierścień odbiorcy jest pełny.
+            if (copy != NULL) {
+                transport_free(copy);
+            }
+            chain_free(transport->region, chain);
+            return -3;
+        } else {
+            position = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->actor = payload.actor;
+    slot->message_type = payload.message_type;
+    slot->nbytes = payload.nbytes;
+    slot->kind = payload.kind;
+    slot->size = payload.size;
+    slot->payload = payload.payload;
+
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_seq_cst);
+
+    if (atomic_exchange(&ring->is_sleeping, 0) == 1) {
+        futex_wake(&ring->is_sleeping);
+    }
+
+    return 0;
+}
+
+void transport_close(transport_t *transport) {
+    int err;
+    void *retval;
+
+    transport_ring_t *ring = &transport->region->rings[transport->node];
+
+    atomic_store(&transport->is_stopping, true);
+    atomic_store(&ring->is_sleeping, 0);
+    futex_wake(&ring->is_sleeping);
+
+    thread_join(transport->thread);
+
+    if (atomic_fetch_sub(&transport->region->attached, 1) == 1) {
+        shm_unlink(transport->name);
+    }
+
+    munmap(transport->region, transport->region_size);
+    free(transport->name);
+    free(transport);
+}
@@ -0,0 +1,106 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "cacti.h"
+
+/*
+ * Identyfikator aktora z innego procesu ma w starszych bitach numer węzła
+ * (procesu) powiększony o 1, a w młodszych - lokalny identyfikator aktora.
+ */
+#define TRANSPORT_NODE_SHIFT 32
+#define TRANSPORT_NODE_BASE ((actor_id_t) 1 << TRANSPORT_NODE_SHIFT)
+
+/*
+ * Liczba komunikatów w pierścieniu każdego węzła (potęga dwójki).
+ */
+#ifndef TRANSPORT_RING_SIZE
+#define TRANSPORT_RING_SIZE 4096
+#endif
+
+/*
+ * Liczba i rozmiar bloków współdzielonego obszaru na duże dane komunikatów.
+ * Dane większe od bloku są przesyłane w łańcuchu bloków.
+ */
+#ifndef TRANSPORT_BLOCKS
+#define TRANSPORT_BLOCKS 1024
+#endif
+
+#ifndef TRANSPORT_BLOCK_SIZE
+#define TRANSPORT_BLOCK_SIZE 4096
+#endif
+
+/*
+ * Dane komunikatu nie większe niż TRANSPORT_INLINE_SIZE bajtów są kopiowane
+ * bezpośrednio do pierścienia.
+ */
+#define TRANSPORT_INLINE_SIZE 24
+
+/*
+ * Struktura przechowująca informacje o dołączonym obszarze współdzielonym.
+ */
+typedef struct transport {
+    char *name;
+    unsigned int node;
+    unsigned int nnodes;
+    struct transport_region *region;
+    size_t region_size;
+    char *blocks;
+    pthread_t thread;
+    atomic_bool is_stopping;
+} transport_t;
+
+/*
+ * Funkcja dołącza działający system aktorów do obszaru pamięci współdzielonej
+ * name (tworząc go, jeśli nie istnieje) jako węzeł node spośród nnodes
+ * i uruchamia wątek odbierający komunikaty od pozostałych procesów.
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów
+ * lub jest już dołączony, -2 gdy nie udało się odwzorować obszaru, -3 w trybie
+ * jednowątkowym (SINGLE_THREADED).
+ */
+int transport_open(const char *name, unsigned int node, unsigned int nnodes);
+
+/*
+ * Funkcja zwraca identyfikator, pod którym lokalny aktor jest widoczny
+ * z innych procesów.
+ */
+actor_id_t actor_id_global(actor_id_t actor);
+
+/*
+ * Funkcja zwraca identyfikator aktora actor z węzła node.
+ */
+actor_id_t actor_id_remote(unsigned int node, actor_id_t actor);
+
+/*
+ * Funkcja przydziela bufor w obszarze współdzielonym (NULL gdy brak miejsca
+ * lub size > TRANSPORT_BLOCK_SIZE). Komunikat z takim buforem jest
+ * przekazywany bez kopiowania danych.
+ */
+void *transport_alloc(size_t size);
+
+/*
+ * Funkcja zwalnia dane komunikatu otrzymanego od innego procesu.
+ */
+void transport_free(void *data);
+
+/*
+ * Funkcja wysyła komunikat do aktora z innego procesu. Dane komunikatu
+ * z obszaru współdzielonego są przekazywane przez przesunięcie, pozostałe
+ * są kopiowane (nbytes bajtów; dane większe od bloku - do łańcucha bloków,
+ * scalanego przez odbiorcę w buforze zwalnianym przez transport_free).
+ * Gdy nbytes == 0 lub komunikat to MSG_HELLO, wskaźnik data jest przekazywany
+ * jako wartość. Zwraca wyniki jak send_message oraz -4, gdy komunikatu nie da
+ * się przesłać (także gdy zabrakło wolnych bloków).
+ */
+int transport_send(actor_id_t actor, message_t message);
+
+/*
+ * Funkcja zatrzymuje wątek odbierający i odłącza obszar współdzielony.
+ * Ostatni odłączający się proces usuwa obszar.
+ */
+void transport_close(transport_t *transport);
+
+#endif //TRANSPORT_H
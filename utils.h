@@ -59,6 +59,8 @@
 #define cond_destroy(cond) \
     check_if_error(pthread_cond_destroy(cond), "cond destroy failed")
 
+#ifndef SINGLE_THREADED
+
 #define mutex_lock(lock) \
     check_if_error(pthread_mutex_lock(lock), "mutex lock failed")
 
@@ -74,6 +76,24 @@
 #define cond_broadcast(cond) \
     check_if_error(pthread_cond_broadcast(cond), "cond broadcast failed")
 
+#else
+
+/*
+ * W trybie jednowątkowym cały system aktorów działa na wątku wywołującym
+ * actor_system_join, więc blokady i zmienne warunkowe są pomijane.
+ */
+#define mutex_lock(lock) do { (void) (lock); (void) err; } while (false)
+
+#define mutex_unlock(lock) do { (void) (lock); (void) err; } while (false)
+
+#define cond_wait(cond, lock) do { (void) (cond); (void) (lock); (void) err; } while (false)
+
+#define cond_signal(cond) do { (void) (cond); (void) err; } while (false)
+
+#define cond_broadcast(cond) do { (void) (cond); (void) err; } while (false)
+
+#endif
+
 
 /*
  * Wątki
@@ -110,6 +130,8 @@
 #define rwlock_destroy(lock) \
     check_if_error(pthread_rwlock_destroy(lock), "rwlock destroy failed")
 
+#ifndef SINGLE_THREADED
+
 #define rwlock_rdlock(lock) \
     check_if_error(pthread_rwlock_rdlock(lock), "rwlock rdlock failed")
 
@@ -119,16 +141,80 @@
 #define rwlock_unlock(lock) \
     check_if_error(pthread_rwlock_unlock(lock), "rwlock unlock failed")
 
+#else
+
+#define rwlock_rdlock(lock) do { (void) (lock); (void) err; } while (false)
+
+#define rwlock_wrlock(lock) do { (void) (lock); (void) err; } while (false)
+
+#define rwlock_unlock(lock) do { (void) (lock); (void) err; } while (false)
+
+#endif
 
 
 /*
  * Makra na obsługiwanie struktur współbieżnych
  */
 
+#if defined(LOCK_PROFILE) && !defined(SINGLE_THREADED)
+
+#include "lock_profile.h"
+
+/*
+ * W wersji z profilowaniem każde wywołanie makra ma własne statystyki,
+ * wypisywane przez actor_system_join.
+ */
+#define entity_lock(entity) do { \
+    static lock_site_t site_ = LOCK_SITE_INIT(#entity, "lock"); \
+    lock_profile_mutex_lock(&site_, &entity->lock); \
+    (void) err; \
+} while (false)
+
+#define entity_reader_lock(entity) do { \
+    static lock_site_t site_ = LOCK_SITE_INIT(#entity, "read"); \
+    lock_profile_rdlock(&site_, &entity->rwlock); \
+    (void) err; \
+} while (false)
+
+#define entity_writer_lock(entity) do { \
+    static lock_site_t site_ = LOCK_SITE_INIT(#entity, "write"); \
+    lock_profile_wrlock(&site_, &entity->rwlock); \
+    (void) err; \
+} while (false)
+
+#define entity_unlock(entity) do { lock_profile_mutex_unlock(&entity->lock); (void) err; } while (false)
+#define entity_rw_unlock(entity) do { lock_profile_rw_unlock(&entity->rwlock); (void) err; } while (false)
+
+#undef cond_wait
+#define cond_wait(cond, lock) do { lock_profile_cond_wait(cond, lock); (void) err; } while (false)
+
+#else
+
 #define entity_lock(entity) mutex_lock(&entity->lock)
 #define entity_unlock(entity) mutex_unlock(&entity->lock)
 #define entity_reader_lock(entity) rwlock_rdlock(&entity->rwlock)
 #define entity_writer_lock(entity) rwlock_wrlock(&entity->rwlock)
 #define entity_rw_unlock(entity) rwlock_unlock(&entity->rwlock)
 
+#endif
+
+/*
+ * Blokady struktur, z których korzystają także wątki spoza systemu aktorów
+ * (np. skrzynka ACTOR_OUTSIDE), nie są pomijane w trybie jednowątkowym.
+ */
+#ifndef SINGLE_THREADED
+
+#define entity_shared_lock(entity) entity_lock(entity)
+#define entity_shared_unlock(entity) entity_unlock(entity)
+
+#else
+
+#define entity_shared_lock(entity) \
+    check_if_error(pthread_mutex_lock(&entity->lock), "mutex lock failed")
+
+#define entity_shared_unlock(entity) \
+    check_if_error(pthread_mutex_unlock(&entity->lock), "mutex unlock failed")
+
+#endif
+
 #endif //UTILS_H
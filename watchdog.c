@@ -0,0 +1,141 @@
+#include "watchdog.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "system.h"
+#include "utils.h"
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+int actor_system_watchdog(unsigned long budget, const unsigned long *budgets, size_t nbudgets,
+                          watchdog_callback_t callback, void *context) {
+#ifdef SINGLE_THREADED
+    (void) budget;
+    (void) budgets;
+    (void) nbudgets;
+    (void) callback;
+    (void) context;
+
+    // Obsługa komunikatu nie może być obserwowana w jej trakcie.
+    return -3;
+#else
+    if (current_actors_system == NULL) {
+        return -1;
+    }
+
+    int err;
+
+    watchdog_t *watchdog;
+    malloc_and_check(watchdog, sizeof(watchdog_t));
+    watchdog->budget = budget;
+    watchdog->nbudgets = nbudgets;
+    watchdog->callback = callback;
+    watchdog->context = context;
+    watchdog->nslots = current_actors_system->nthreads;
+
+    malloc_and_check(watchdog->budgets, (nbudgets + 1) * sizeof(unsigned long));
+    for (size_t i = 0; i < nbudgets; ++i) {
+        watchdog->budgets[i] = budgets[i];
+    }
+
+    malloc_and_check(watchdog->slots, watchdog->nslots * sizeof(watchdog_slot_t));
+    for (unsigned int i = 0; i < watchdog->nslots; ++i) {
+        atomic_init(&watchdog->slots[i].sequence, 0);
+        atomic_init(&watchdog->slots[i].actor, -1);
+        atomic_init(&watchdog->slots[i].prompt, 0);
+        atomic_init(&watchdog->slots[i].start, 0);
+        watchdog->slots[i].reported = 0;
+    }
+
+    entity_lock(current_actors_system);
+    bool is_set = atomic_load(&current_actors_system->watchdog) != NULL;
+    if (!is_set) {
+        atomic_store_explicit(&current_actors_system->watchdog, watchdog, memory_order_release);
+    }
+    entity_unlock(current_actors_system);
+
+    if (is_set) {
+        watchdog_close(watchdog);
+        return -1;
+    }
+
+    // Wątek kontrolny zaczyna okresowo sprawdzać wątki robocze.
+    actor_system_notify(current_actors_system);
+
+    return 0;
+#endif
+}
+
+void watchdog_begin(watchdog_t *watchdog, actor_id_t actor, message_type_t prompt) {
+    watchdog_slot_t *slot = &watchdog->slots[worker_index];
+
+    // Nowe wartości pól nie mogą być widoczne przed zakończeniem poprzedniej obsługi.
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&slot->actor, actor, memory_order_relaxed);
+    atomic_store_explicit(&slot->prompt, prompt, memory_order_relaxed);
+    atomic_store_explicit(&slot->start, now(), memory_order_relaxed);
+
+    unsigned long sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+}
+
+void watchdog_end(watchdog_t *watchdog) {
+    watchdog_slot_t *slot = &watchdog->slots[worker_index];
+
+    unsigned long sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+}
+
+void watchdog_check(watchdog_t *watchdog) {
+    uint64_t time = now();
+
+    for (unsigned int i = 0; i < watchdog->nslots; ++i) {
+        watchdog_slot_t *slot = &watchdog->slots[i];
+
+        unsigned long sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence % 2 == 0 || sequence == slot->reported) {
+            // Wątek nie obsługuje komunikatu lub ta obsługa została już zgłoszona.
+            continue;
+        }
+
+        actor_id_t actor = atomic_load_explicit(&slot->actor, memory_order_relaxed);
+        message_type_t prompt = atomic_load_explicit(&slot->prompt, memory_order_relaxed);
+        uint64_t start = atomic_load_explicit(&slot->start, memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) {
+            // Obsługa zakończyła się w trakcie odczytu.
+            continue;
+        }
+
+        unsigned long budget = prompt >= 0 && (size_t) prompt < watchdog->nbudgets
+                               && watchdog->budgets[prompt] != 0
+                               ? watchdog->budgets[prompt] : watchdog->budget;
+        unsigned long duration = time > start ? time - start : 0;
+
+        if (duration <= budget) {
+            continue;
+        }
+
+        slot->reported = sequence;
+
+        fprintf(stderr, "watchdog: actor %ld prompt %ld on worker %u running for %lu us (budget %lu us)\n",
+                actor, prompt, i, duration, budget);
+
+        if (watchdog->callback != NULL) {
+            watchdog->callback(actor, prompt, duration, watchdog->context);
+        }
+    }
+}
+
+void watchdog_close(watchdog_t *watchdog) {
+    free(watchdog->budgets);
+    free(watchdog->slots);
+    free(watchdog);
+}
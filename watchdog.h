@@ -0,0 +1,81 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cacti.h"
+
+/*
+ * Odstęp (w milisekundach) między sprawdzeniami wątków roboczych.
+ */
+#ifndef WATCHDOG_INTERVAL
+#define WATCHDOG_INTERVAL 10
+#endif
+
+/*
+ * Funkcja wywoływana przez wątek kontrolny, gdy obsługa komunikatu typu prompt
+ * przez aktora actor trwa duration mikrosekund, dłużej niż jej limit.
+ */
+typedef void (*watchdog_callback_t)(actor_id_t actor, message_type_t prompt,
+                                    unsigned long duration, void *context);
+
+/*
+ * Komunikat obsługiwany przez wątek roboczy. sequence jest nieparzyste w trakcie
+ * obsługi; wątek kontrolny porównuje je przed i po odczycie pozostałych pól.
+ * reported to sequence ostatniej zgłoszonej obsługi (używane tylko przez wątek
+ * kontrolny).
+ */
+typedef struct watchdog_slot {
+    atomic_ulong sequence;
+    _Atomic actor_id_t actor;
+    _Atomic message_type_t prompt;
+    _Atomic uint64_t start;
+    unsigned long reported;
+} watchdog_slot_t;
+
+/*
+ * Struktura przechowująca limity czasu obsługi komunikatów (w mikrosekundach)
+ * i stan wątków roboczych.
+ */
+typedef struct watchdog {
+    unsigned long budget;
+    unsigned long *budgets;
+    size_t nbudgets;
+    watchdog_callback_t callback;
+    void *context;
+    watchdog_slot_t *slots;
+    unsigned int nslots;
+} watchdog_t;
+
+/*
+ * Funkcja włącza nadzór nad czasem obsługi komunikatów w działającym systemie
+ * aktorów. Limitem dla komunikatu typu i jest budgets[i] (dla i < nbudgets
+ * i budgets[i] != 0) lub budget. Obsługa, która przekroczy limit, jest raz
+ * zgłaszana na standardowe wyjście błędów (id aktora, typ komunikatu, czas),
+ * po czym wątek kontrolny wywołuje callback (o ile jest różny od NULL).
+ * Zwraca 0 w przypadku powodzenia, -1 gdy nie działa żaden system aktorów
+ * lub ma on już włączony nadzór, -3 w trybie jednowątkowym (SINGLE_THREADED).
+ */
+int actor_system_watchdog(unsigned long budget, const unsigned long *budgets, size_t nbudgets,
+                          watchdog_callback_t callback, void *context);
+
+/*
+ * Funkcje oznaczają początek i koniec obsługi komunikatu przez wątek roboczy.
+ */
+void watchdog_begin(watchdog_t *watchdog, actor_id_t actor, message_type_t prompt);
+
+void watchdog_end(watchdog_t *watchdog);
+
+/*
+ * Funkcja zgłasza obsługi komunikatów, które przekroczyły limit.
+ */
+void watchdog_check(watchdog_t *watchdog);
+
+/*
+ * Funkcja zwalnia strukturę nadzoru.
+ */
+void watchdog_close(watchdog_t *watchdog);
+
+#endif //WATCHDOG_H